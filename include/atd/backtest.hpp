@@ -0,0 +1,120 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_BACKTEST_H_
+#define ATD_BACKTEST_H_
+
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <at/types.hpp>
+#include <atd/channel.hpp>
+#include <atd/clock.hpp>
+#include <atd/datamonitor.hpp>
+#include <atd/logging.hpp>
+#include <atd/metrics.hpp>
+#include <atd/retry.hpp>
+#include <atd/simulatedmarket.hpp>
+#include <atd/strategy.hpp>
+#include <atd/types.hpp>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace atd {
+
+using namespace at;
+
+typedef struct {
+    // replayed interval, as unix times. 0 means from the first (to the
+    // last) saved snapshot
+    std::time_t from, to;
+    // currency the balances are valued in
+    std::string currency;
+    // balances at the start
+    std::map<std::string, double> balances;
+    // percentages, like the ones of market_info_t
+    double maker_fee, taker_fee;
+    // relative distance between ask and bid, around the saved price
+    double spread;
+} backtest_config_t;
+
+typedef struct {
+    std::time_t from, to;
+    // saved snapshots replayed and jumps of the clock
+    std::uint64_t ticks, steps;
+    // messages sent by the strategies, orders placed and dropped
+    std::uint64_t messages, placed, dropped;
+    std::map<std::string, double> start_balances, end_balances;
+    // fees paid, per currency
+    std::map<std::string, double> fees;
+    // value in currency of the balances at the start and at the end, and of
+    // the start balances at the end: the PnL of holding them
+    double start_value, end_value, hold_value;
+    // real time taken by the replay
+    std::chrono::nanoseconds elapsed;
+} backtest_report_t;
+
+// Backtest replays the history saved by the monitors through the strategies,
+// on a virtual clock: the strategies run unchanged, their sleeps cost
+// nothing and their queries see only the data saved up to the virtual time.
+// The orders are filled by a SimulatedMarket whose prices follow the saved
+// ones, with the configured fees.
+// The clock jumps from a deadline of the strategies to the next one as soon
+// as they are all sleeping: a year of data is replayed in seconds.
+class Backtest {
+private:
+    SQLite::Database* _db;
+    backtest_config_t _config;
+    std::shared_ptr<VirtualClock> _clock;
+    std::shared_ptr<DataMonitor> _monitors;
+    std::shared_ptr<channel<message_t>> _chan;
+    std::shared_ptr<Retrier> _retrier;
+    std::shared_ptr<SimulatedMarket> _market;
+    std::shared_ptr<spdlog::logger> _logger;
+    std::set<currency_pair_t> _pairs;
+    backtest_report_t _report;
+
+    void _quote(const currency_pair_t& pair);
+    double _value(const std::map<std::string, double>& balances);
+    void _execute(const message_t& message);
+    void _settle();
+
+public:
+    // Backtest replays the snapshots of db in the configured interval. The
+    // DataMonitor of the strategies runs with the settings of the live one.
+    // Throws std::runtime_error if there is nothing to replay.
+    Backtest(SQLite::Database* db, const std::chrono::seconds& period,
+             std::size_t correlation_window, const backtest_config_t& config,
+             const retry_policy_t& retry, std::shared_ptr<Metrics> metrics);
+    ~Backtest() {}
+
+    // monitors and chan are the ones to build the strategies with
+    std::shared_ptr<DataMonitor> monitors() { return _monitors; }
+    std::shared_ptr<channel<message_t>> chan() { return _chan; }
+
+    // run replays the history through the buy and sell of the strategies
+    // (built on monitors and chan), traded on the simulated market. Returns
+    // when the history is over.
+    backtest_report_t run(
+        const std::map<currency_pair_t,
+                       std::vector<std::shared_ptr<Strategy>>>& strategies);
+};
+
+}  // end namespace atd
+
+#endif  // ATD_BACKTEST_H_
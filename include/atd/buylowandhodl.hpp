@@ -16,6 +16,8 @@
 #define ATD_BUY_LOW_AND_HODL_STRATEGY_H_
 
 #include <atd/hodl.hpp>
+#include <atd/resample.hpp>
+#include <atd/stats/GaussianSmoothing.hpp>
 #include <atd/stats/namespace.hpp>
 
 namespace atd {
@@ -33,7 +35,7 @@ public:
                   std::shared_ptr<channel<message_t>> chan, float low,
                   float balance_percentage, std::chrono::seconds trade_period,
                   std::chrono::seconds stats_period)
-        : Hodl(monitors, chan),
+        : Hodl(monitors, chan, "buylowandhodl"),
           _low(low),
           _balance_percentage(balance_percentage),
           _trade_period(trade_period),
@@ -0,0 +1,107 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_CACHE_H_
+#define ATD_CACHE_H_
+
+#include <chrono>
+#include <exception>
+#include <future>
+#include <map>
+#include <mutex>
+
+namespace atd {
+
+// expiring_cache is a thread safe map whose items expire after ttl.
+// Missing or expired items are loaded calling the loader passed to get.
+// Loads are coalesced: while an item is being loaded, the other threads
+// asking for it wait for the same load instead of starting a new one.
+template <class key, class value>
+class expiring_cache {
+private:
+    typedef std::chrono::steady_clock clock;
+    typedef struct {
+        value item;
+        clock::time_point expires;
+    } entry_t;
+
+    std::map<key, entry_t> _entries;
+    // in flight loads
+    std::map<key, std::shared_future<value>> _loading;
+    std::mutex _m;
+    clock::duration _ttl;
+
+public:
+    expiring_cache(clock::duration ttl) : _ttl(ttl) {}
+
+    // get returns the cached value of k. If missing or expired, load(k) is
+    // called (without holding the lock) and its result is cached. If load
+    // throws, the exception is propagated to every thread waiting for it.
+    template <class loader>
+    value get(const key &k, loader load)
+    {
+        std::promise<value> promise;
+        std::shared_future<value> in_flight;
+        {
+            std::unique_lock<std::mutex> lock(_m);
+            auto it = _entries.find(k);
+            if (it != _entries.end() && it->second.expires > clock::now()) {
+                return it->second.item;
+            }
+            auto loading = _loading.find(k);
+            if (loading != _loading.end()) {
+                in_flight = loading->second;
+            }
+            else {
+                _loading[k] = promise.get_future().share();
+            }
+        }
+        if (in_flight.valid()) {
+            return in_flight.get();
+        }
+
+        try {
+            value item = load(k);
+            {
+                std::unique_lock<std::mutex> lock(_m);
+                _entries[k] = entry_t{item, clock::now() + _ttl};
+                _loading.erase(k);
+            }
+            promise.set_value(item);
+            return item;
+        }
+        catch (...) {
+            {
+                std::unique_lock<std::mutex> lock(_m);
+                _loading.erase(k);
+            }
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+    void put(const key &k, const value &item)
+    {
+        std::unique_lock<std::mutex> lock(_m);
+        _entries[k] = entry_t{item, clock::now() + _ttl};
+    }
+    // invalidate forces the next get of k to call the loader
+    void invalidate(const key &k)
+    {
+        std::unique_lock<std::mutex> lock(_m);
+        _entries.erase(k);
+    }
+};
+}  // end namespace atd
+
+#endif
@@ -15,7 +15,9 @@
 #ifndef ATD_CHAN_H_
 #define ATD_CHAN_H_
 
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
 #include <list>
 #include <mutex>
 #include <thread>
@@ -43,6 +45,12 @@ public:
         std::unique_lock<std::mutex> lock(_m);
         return _closed;
     }
+    // size returns the number of items waiting in the channel
+    std::size_t size()
+    {
+        std::unique_lock<std::mutex> lock(_m);
+        return _queue.size();
+    }
     void put(const item &i)
     {
         std::unique_lock<std::mutex> lock(_m);
@@ -65,6 +73,22 @@ public:
         _queue.pop_front();
         return true;
     }
+    // get_until waits for an item until deadline. Returns false if the
+    // deadline expired or the channel has been closed
+    template <class clock, class duration>
+    bool get_until(item &out,
+                   const std::chrono::time_point<clock, duration> &deadline)
+    {
+        std::unique_lock<std::mutex> lock(_m);
+        _cv.wait_until(lock, deadline,
+                       [&]() { return _closed || !_queue.empty(); });
+        if (_queue.empty()) {
+            return false;
+        }
+        out = _queue.front();
+        _queue.pop_front();
+        return true;
+    }
 };
 }  // end namespace atd
 
@@ -0,0 +1,182 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_CLOCK_H_
+#define ATD_CLOCK_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <ctime>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace atd {
+
+// Clock is the time seen by the strategies and by the history queries of the
+// DataMonitor: the wall clock when trading, a virtual one when backtesting.
+class Clock {
+public:
+    typedef std::chrono::system_clock::time_point time_point;
+
+    virtual ~Clock() {}
+    virtual time_point now() = 0;
+    // sleep_until blocks the calling thread until the clock reaches deadline
+    virtual void sleep_until(time_point deadline) = 0;
+
+    template <class Rep, class Period>
+    void sleep_for(const std::chrono::duration<Rep, Period>& duration)
+    {
+        sleep_until(now() +
+                    std::chrono::duration_cast<time_point::duration>(duration));
+    }
+    // time returns now() as a unix time
+    std::time_t time()
+    {
+        return std::chrono::system_clock::to_time_t(now());
+    }
+};
+
+// clock_stopped is thrown by the sleeps on a stopped VirtualClock, or on a
+// SystemClock by a thread whose StopSignal has been requested, to unwind
+// the threads sleeping on it
+class clock_stopped : public std::runtime_error {
+public:
+    clock_stopped(const std::string& what) : std::runtime_error(what) {}
+};
+
+// StopSignal stops a group of threads: the threads running in its scope
+// (see StopScope) are woken from their sleeps on a SystemClock, with
+// clock_stopped, as soon as the stop is requested
+class StopSignal {
+private:
+    std::mutex _mux;
+    std::condition_variable _cv;
+    bool _requested;
+
+    friend class StopScope;
+    static void _set_current(StopSignal* stop);
+
+public:
+    StopSignal() : _requested(false) {}
+    void request()
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        _requested = true;
+        _cv.notify_all();
+    }
+    bool requested()
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        return _requested;
+    }
+    // wait blocks until the stop is requested
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(_mux);
+        _cv.wait(lock, [&]() { return _requested; });
+    }
+    // sleep_until sleeps until deadline. Returns false, as soon as the stop
+    // is requested, if interrupted.
+    template <class clock, class duration>
+    bool sleep_until(const std::chrono::time_point<clock, duration>& deadline)
+    {
+        std::unique_lock<std::mutex> lock(_mux);
+        return !_cv.wait_until(lock, deadline, [&]() { return _requested; });
+    }
+    template <class Rep, class Period>
+    bool sleep_for(const std::chrono::duration<Rep, Period>& duration)
+    {
+        return sleep_until(std::chrono::steady_clock::now() + duration);
+    }
+
+    // current returns the stop signal of the calling thread, set by
+    // StopScope. nullptr if the thread can't be stopped.
+    static StopSignal* current();
+};
+
+// StopScope sets the stop signal of the calling thread until its
+// destruction
+class StopScope {
+private:
+    StopSignal* _previous;
+
+public:
+    StopScope(StopSignal* stop) : _previous(StopSignal::current())
+    {
+        StopSignal::_set_current(stop);
+    }
+    ~StopScope() { StopSignal::_set_current(_previous); }
+};
+
+// SystemClock is the wall clock
+class SystemClock : public Clock {
+public:
+    time_point now() override { return std::chrono::system_clock::now(); }
+    // sleep_until throws clock_stopped if the stop signal of the calling
+    // thread is requested
+    void sleep_until(time_point deadline) override;
+};
+
+// VirtualClock is a discrete event clock: time moves only when advance is
+// called, and sleeping costs nothing.
+// The threads driven by the clock attach to it. When every attached thread
+// is sleeping, nothing can happen before the earliest deadline: the driver
+// waits for that (wait_idle), then jumps the clock to it (advance), waking
+// the threads whose deadline is reached.
+class VirtualClock : public Clock {
+private:
+    std::mutex _mux;
+    // _wake wakes the sleepers, _idle the driver
+    std::condition_variable _wake, _idle;
+    time_point _now;
+    // attached threads and how many of them are sleeping
+    std::size_t _participants, _sleeping;
+    std::multiset<time_point> _deadlines;
+    bool _stopped;
+
+public:
+    VirtualClock(time_point start)
+        : _now(start), _participants(0), _sleeping(0), _stopped(false)
+    {
+    }
+    ~VirtualClock() {}
+
+    time_point now() override;
+    // sleep_until returns immediately if deadline is not in the future.
+    // Throws clock_stopped if the clock is stopped.
+    void sleep_until(time_point deadline) override;
+
+    // attach and detach a thread driven by the clock
+    void attach();
+    void detach();
+    // wait_idle waits up to timeout (real time) for every attached thread
+    // to sleep. Returns true if they are all sleeping.
+    bool wait_idle(std::chrono::nanoseconds timeout);
+    // next_deadline sets deadline to the earliest one of the sleepers.
+    // Returns false if nobody is sleeping.
+    bool next_deadline(time_point& deadline);
+    // advance moves the clock to time, waking the sleepers whose deadline is
+    // reached. The clock never goes back.
+    void advance(time_point time);
+    // stop wakes every sleeper, present and future, with clock_stopped
+    void stop();
+};
+
+}  // end namespace atd
+
+#endif  // ATD_CLOCK_H_
@@ -21,13 +21,19 @@
 #include <at/namespace.hpp>
 #include <at/shapeshift.hpp>
 #include <at/types.hpp>
+#include <atd/backtest.hpp>
 #include <atd/buylowandhodl.hpp>
 #include <atd/channel.hpp>
 #include <atd/datamonitor.hpp>
 #include <atd/dollarcostaveraging.hpp>
 #include <atd/hodl.hpp>
+#include <atd/logging.hpp>
+#include <atd/simulatedmarket.hpp>
 #include <atd/smallchanges.hpp>
 #include <atd/strategy.hpp>
+#include <atd/supervisor.hpp>
+#include <atd/tape.hpp>
+#include <atd/trader.hpp>
 #include <chrono>
 #include <condition_variable>
 #include <fstream>
@@ -45,8 +51,10 @@ private:
 public:
     ~Config() {}
     Config(const std::string& path);
-    // markets returns a map of initialized markets from the configuration file
-    std::map<std::string, std::shared_ptr<Market>> markets();
+    // markets returns a map of initialized markets from the configuration file.
+    // Unless the tape is off, the calls to the markets go through it
+    std::map<std::string, std::shared_ptr<Market>> markets(
+        std::shared_ptr<Tape> tape);
     // exchanges returns a map of initialized exchanges from the configuration
     // file
     std::map<std::string, std::shared_ptr<Exchange>> exchanges();
@@ -56,6 +64,29 @@ public:
     std::vector<std::string> monitorCurrencies();
     // returns the number of seconds to wait between snapshots
     std::chrono::seconds monitorPeriod();
+    // returns the number of rounds in the rolling correlations of the
+    // monitored currencies
+    std::size_t correlationWindow();
+    // returns the retry policy of the calls to markets and data providers,
+    // defaults are used for the missing settings
+    retry_policy_t retryPolicy();
+    // returns the trader settings, defaults are used for the missing ones
+    trader_config_t trader();
+    // returns the record/replay settings of the API calls. The tape is off
+    // if not configured
+    tape_config_t tape();
+    // returns the settings of the backtests, defaults are used for the
+    // missing ones
+    backtest_config_t backtest();
+    // returns the settings of the metrics endpoint, disabled if not
+    // configured
+    metrics_config_t metrics();
+    // returns the settings of the logging pipeline, defaults are used for
+    // the missing ones
+    logging_config_t logging();
+    // returns the supervisor settings, defaults are used for the missing
+    // ones
+    supervisor_config_t supervisor();
     // returns the defined strategies per pair
     std::map<currency_pair_t, std::vector<std::shared_ptr<Strategy>>>
         strategies(std::shared_ptr<DataMonitor>,
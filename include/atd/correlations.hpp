@@ -0,0 +1,87 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_CORRELATIONS_H_
+#define ATD_CORRELATIONS_H_
+
+#include <atd/stats/CorrelationMatrix.hpp>
+#include <atd/timeseries.hpp>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace atd {
+
+typedef struct {
+    std::vector<std::string> currencies;
+    // returns in the window and time of the last one
+    std::size_t samples;
+    std::time_t time;
+    // Pearson correlation of the returns of every pair of currencies, row
+    // major: matrix[i * currencies.size() + j]. NaN when one of the two has
+    // no variance.
+    std::vector<double> matrix;
+} correlations_t;
+
+// CorrelationEngine keeps the rolling correlation matrix of the log returns
+// of the monitored currencies, one return per monitor round.
+// Every round updates it incrementally and publishes an immutable snapshot:
+// the strategies read the matrix without locks and without recomputing it.
+class CorrelationEngine {
+private:
+    std::size_t _window;
+    // serializes start and push
+    std::mutex _mux;
+    std::vector<std::string> _currencies;
+    std::unique_ptr<stats::CorrelationMatrix> _matrix;
+    // prices of the previous round
+    std::vector<double> _last;
+    std::vector<double> _returns;
+    // read and replaced with the atomic shared_ptr functions
+    std::shared_ptr<const correlations_t> _snapshot;
+
+    void _publish(std::time_t time);
+
+public:
+    CorrelationEngine(std::size_t window);
+    ~CorrelationEngine() {}
+
+    // start resets the engine on currencies and fills the window with the
+    // returns of their histories (a TimeSeries with a price_usd column per
+    // currency), resampled every step on a common grid. The matrix is built
+    // in parallel.
+    void start(const std::vector<std::string>& currencies,
+               const std::vector<TimeSeries>& histories,
+               std::chrono::seconds step);
+    // push adds a round of prices, in the order of the currencies passed to
+    // start. A price not positive (not fetched) repeats the previous one.
+    void push(std::time_t time, const std::vector<double>& prices);
+
+    // window returns the number of returns in the matrix
+    std::size_t window() const { return _window; }
+    std::shared_ptr<const correlations_t> snapshot() const;
+    // correlation returns the correlation between the returns of a and b in
+    // the latest snapshot.
+    // Throws std::out_of_range if a or b are not monitored.
+    double correlation(std::string a, std::string b) const;
+};
+
+}  // end namespace atd
+
+#endif  // ATD_CORRELATIONS_H_
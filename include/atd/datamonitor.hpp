@@ -19,8 +19,19 @@
 #include <SQLiteCpp/VariadicBind.h>
 #include <at/coinmarketcap.hpp>
 #include <at/namespace.hpp>
+#include <atd/clock.hpp>
+#include <atd/correlations.hpp>
+#include <atd/indicators.hpp>
+#include <atd/metrics.hpp>
+#include <atd/rategraph.hpp>
+#include <atd/retry.hpp>
+#include <atd/statementcache.hpp>
+#include <atd/supervisor.hpp>
+#include <atd/tape.hpp>
+#include <atd/timeseries.hpp>
 #include <chrono>
 #include <ctime>
+#include <memory>
 #include <set>
 #include <thread>
 
@@ -28,19 +39,48 @@ namespace atd {
 
 using namespace at;
 
+// DataMonitor ingests the data of CoinMarketCap and answers the queries of
+// the strategies on it. The history queries see only the data saved up to
+// the time of its clock: a backtest replays the saved history on a virtual
+// clock, without the strategies seeing the future.
 class DataMonitor {
 private:
     SQLite::Database* _db;
     std::chrono::seconds _period;
+    std::shared_ptr<Clock> _clock;
     CoinMarketCap* _cmc;
+    std::shared_ptr<Metrics> _metrics;
+    // duration of the history queries
+    std::shared_ptr<LatencyHistogram> _pair_history_latency,
+        _currency_history_latency;
+    // calls to coinmarketcap go through the retrier, then the tape
+    std::shared_ptr<Retrier> _retrier;
+    std::shared_ptr<Tape> _tape;
+    // cached read statements, shared by the strategies threads
+    StatementCache _statements;
+    // latest best-volume rates, updated on ingest
+    std::shared_ptr<RateGraph> _rates;
+    // indicators subscribed by the strategies, updated on ingest
+    std::shared_ptr<IndicatorEngine> _indicators;
+    // correlations of the monitored currencies, updated every round
+    std::shared_ptr<CorrelationEngine> _correlations;
+
+    void _push(const cm_ticker_t& tick);
 
 public:
     ~DataMonitor() { delete _cmc; };
-    DataMonitor(SQLite::Database* db, const std::chrono::seconds& period);
-    // currencies monitor function
-    void currencies(const std::vector<std::string>& currencies);
-    // pairs monitor function
-    void pairs(const std::vector<currency_pair_t>& pairs);
+    DataMonitor(SQLite::Database* db, const std::chrono::seconds& period,
+                std::size_t correlation_window, const retry_policy_t& retry,
+                std::shared_ptr<Tape> tape, std::shared_ptr<Metrics> metrics,
+                std::shared_ptr<Clock> clock);
+    // currencies monitor function, beating heartbeat at every ingested
+    // currency. The correlations start from the saved history of the
+    // currencies and are updated at the end of every round.
+    void currencies(const std::vector<std::string>& currencies,
+                    std::shared_ptr<Heartbeat> heartbeat);
+    // pairs monitor function, beating heartbeat at every ingested base
+    void pairs(const std::vector<currency_pair_t>& pairs,
+               std::shared_ptr<Heartbeat> heartbeat);
 
     // an ordered vector of cm_market_t from the beginning of monitoring to the
     // last saved
@@ -55,6 +95,45 @@ public:
     // an ordered vector of cm_ticker_t from "after" time to the last saved
     std::vector<cm_ticker_t> currencyHistory(const std::string& currency,
                                              const std::time_t& after);
+    // the number of cm_ticker_t of currency saved from "after" time
+    std::size_t samples(const std::string& currency, const std::time_t& after);
+    // the history of currency from "after" time to the last saved, as a
+    // TimeSeries with the columns price_btc, price_usd, day_volume_usd,
+    // market_cap_usd, percent_change_1h, percent_change_24h and
+    // percent_change_7d: the columns go to the stats functions as they are
+    TimeSeries currencySeries(const std::string& currency,
+                              const std::time_t& after);
+
+    // ingest updates the rates and the indicators with tick, without saving
+    // it: the currencies monitor ingests every fetched ticker, a backtest
+    // every saved one
+    void ingest(const cm_ticker_t& tick);
+
+    // the conversion rates between every monitored currency (and fiat)
+    std::shared_ptr<RateGraph> rates() { return _rates; }
+
+    // the rolling correlations between the monitored currencies
+    std::shared_ptr<CorrelationEngine> correlations() { return _correlations; }
+
+    // indicator returns the indicator spec of field (price_usd, price_btc,
+    // percent_change_1h, percent_change_24h or percent_change_7d) of
+    // currency, updated at every ingested ticker. The strategies asking for
+    // the same indicator share it. A new indicator is warmed up with the
+    // saved history: the rows of its span, if any, or its last rows.
+    // Throws std::invalid_argument if field or spec are not valid.
+    std::shared_ptr<Indicator> indicator(std::string currency,
+                                         const std::string& field,
+                                         const indicator_spec_t& spec);
+
+    // the clock of the monitors and of the strategies
+    std::shared_ptr<Clock> clock() { return _clock; }
+
+    // period of the monitor rounds: the interval between two samples of a
+    // series
+    std::chrono::seconds period() const { return _period; }
+
+    // prepare vs execute counters of the cached read statements
+    statement_stats_t statementStats() const { return _statements.stats(); }
 };
 }  // end namespace atd
 
@@ -42,7 +42,7 @@ public:
     DollarCostAveraging(std::shared_ptr<DataMonitor> monitors,
                         std::shared_ptr<channel<message_t>> chan,
                         std::string date, atd::quantity_t buy_quantity)
-        : Hodl(monitors, chan)
+        : Hodl(monitors, chan, "dollarcostaveraging")
     {
         // support 2 formats: date is always UTC
 
@@ -70,6 +70,8 @@ public:
             }
         }
         _buy_quantity = buy_quantity;
+        // _date starts from now: drop its seconds, the date is to the minute
+        _date.tm_sec = 0;
 
         // get UTC time
         auto time = timegm(&_date);
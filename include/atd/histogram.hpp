@@ -0,0 +1,60 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_HISTOGRAM_H_
+#define ATD_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace atd {
+
+// LatencyHistogram counts durations in buckets that grow exponentially,
+// like an HDR histogram: every power of two is split in 16 buckets, hence a
+// percentile is overestimated by less than 6.25%.
+// Recording is lock free, so it can be done on the hot path by any thread.
+class LatencyHistogram {
+private:
+    static constexpr std::size_t _sub_bits = 4;
+    static constexpr std::size_t _sub_buckets = 1 << _sub_bits;
+    static constexpr std::size_t _buckets = (65 - _sub_bits) * _sub_buckets;
+    std::array<std::atomic<std::uint64_t>, _buckets> _counts;
+    std::atomic<std::uint64_t> _sum;
+
+    static std::size_t _index(std::uint64_t nanoseconds);
+    static std::uint64_t _upper_bound(std::size_t index);
+
+public:
+    LatencyHistogram();
+    ~LatencyHistogram() {}
+
+    void record(std::chrono::nanoseconds duration);
+    // count returns the number of durations recorded
+    std::uint64_t count() const;
+    // count returns the number of durations recorded not greater than upper
+    // (approximated to the bucket boundaries)
+    std::uint64_t count(std::chrono::nanoseconds upper) const;
+    // sum returns the sum of the durations recorded
+    std::chrono::nanoseconds sum() const;
+    // percentile returns the duration below which the fraction p of the
+    // recorded durations falls. eg. 0.99 for the 99th percentile
+    std::chrono::nanoseconds percentile(double p) const;
+};
+
+}  // end namespace atd
+
+#endif  // ATD_HISTOGRAM_H_
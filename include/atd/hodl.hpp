@@ -27,15 +27,16 @@ using namespace std::literals::chrono_literals;
 class Hodl : public Strategy {
 public:
     Hodl(std::shared_ptr<DataMonitor> monitors,
-         std::shared_ptr<channel<message_t>> chan)
-        : Strategy(monitors, chan)
+         std::shared_ptr<channel<message_t>> chan,
+         const std::string& component = "hodl")
+        : Strategy(monitors, chan, component)
     {
     }
     void buy(const currency_pair_t&) override
 
     {
         while (true) {
-            std::this_thread::sleep_for(5h);
+            _clock->sleep_for(5h);
         }
     }
 
@@ -43,7 +44,7 @@ public:
 
     {
         while (true) {
-            std::this_thread::sleep_for(5h);
+            _clock->sleep_for(5h);
         }
     }
 };
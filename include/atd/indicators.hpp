@@ -0,0 +1,150 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_INDICATORS_H_
+#define ATD_INDICATORS_H_
+
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace atd {
+
+enum class indicator_kind_t { sma, ema, rsi, macd, bollinger, min, max };
+
+typedef struct {
+    indicator_kind_t kind;
+    // samples of the window (sma, rsi, bollinger, min, max), of the
+    // smoothing (ema) or of the fast ema (macd)
+    std::size_t period = 0;
+    // macd only: samples of the slow ema and of the signal line
+    std::size_t slow = 0, signal = 0;
+    // bollinger only: distance of the bands from the mean, in standard
+    // deviations
+    double width = 0;
+    // min and max only: when not 0, the window is the samples of the last
+    // span seconds, up to the newest one, instead of the last period ones
+    std::time_t span = 0;
+} indicator_spec_t;
+
+typedef struct {
+    // samples pushed and time of the last one
+    std::size_t samples;
+    std::time_t time;
+    // true once enough samples have been pushed to fill the indicator
+    bool ready;
+    // sma, ema, rsi, min, max: the indicator. macd: the macd line.
+    // bollinger: the mean.
+    double value;
+    // macd only: the signal line (value - signal is the histogram)
+    double signal;
+    // bollinger only: the bands
+    double upper, lower;
+} indicator_value_t;
+
+// indicator_name returns the canonical name of spec, e.g. "macd(12,26,9)":
+// two specs with the same name compute the same values.
+// Throws std::invalid_argument if spec is not valid.
+std::string indicator_name(const indicator_spec_t& spec);
+
+// indicator_warmup returns how many past samples spec needs to reach its
+// steady state: the window, or a few times the period of the exponential
+// smoothings. 0 for the windows of a span: every sample of the span
+std::size_t indicator_warmup(const indicator_spec_t& spec);
+
+// Indicator is a technical indicator of a series, updated in O(1) at every
+// sample. Samples not newer than the last one are ignored, so the same
+// sample can be safely pushed twice.
+class Indicator {
+private:
+    indicator_spec_t _spec;
+    std::string _name;
+    mutable std::mutex _mux;
+    indicator_value_t _value;
+
+protected:
+    // _update adds x to the state and updates value (ready and value
+    // fields). push sets time, the time of x, before it and increments
+    // samples after it
+    virtual void _update(double x, indicator_value_t& value) = 0;
+
+public:
+    Indicator(const indicator_spec_t& spec)
+        : _spec(spec), _name(indicator_name(spec)), _value{}
+    {
+    }
+    virtual ~Indicator() {}
+
+    const indicator_spec_t& spec() const { return _spec; }
+    const std::string& name() const { return _name; }
+    void push(std::time_t time, double x);
+    indicator_value_t value() const;
+};
+
+// make_indicator returns a new, empty, indicator computing spec
+std::shared_ptr<Indicator> make_indicator(const indicator_spec_t& spec);
+
+// IndicatorEngine keeps the indicators subscribed on every series and
+// updates them at every ingested sample.
+// Identical subscriptions on the same series share the same indicator:
+// it's computed once, whatever the number of subscribers.
+class IndicatorEngine {
+public:
+    // loader_t returns up to the last n samples of a series or, when n is
+    // 0, the ones of the last span seconds, as (time, value), in any order
+    typedef std::function<std::vector<std::pair<std::time_t, double>>(
+        std::size_t n, std::time_t span)>
+        loader_t;
+
+private:
+    typedef struct {
+        // serializes the updates and the warm-ups of the series
+        std::mutex mux;
+        std::map<std::string, std::shared_ptr<Indicator>> indicators;
+    } series_t;
+
+    std::mutex _mux;
+    std::unordered_map<std::string, std::shared_ptr<series_t>> _series;
+
+    std::shared_ptr<series_t> _find(const std::string& series);
+
+public:
+    IndicatorEngine() {}
+    ~IndicatorEngine() {}
+
+    // subscribe returns the indicator spec of series. The first subscription
+    // creates it and warms it up with the samples returned by load, before
+    // any newer sample is pushed.
+    // Throws std::invalid_argument if spec is not valid.
+    std::shared_ptr<Indicator> subscribe(const std::string& series,
+                                         const indicator_spec_t& spec,
+                                         loader_t load);
+    // push updates every indicator of series. Series without subscriptions
+    // are ignored.
+    void push(const std::string& series, std::time_t time, double x);
+    // size returns the number of distinct indicators computed
+    std::size_t size();
+};
+
+}  // end namespace atd
+
+#endif  // ATD_INDICATORS_H_
@@ -0,0 +1,95 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_LEDGER_H_
+#define ATD_LEDGER_H_
+
+#include <at/market.hpp>
+#include <at/types.hpp>
+#include <atd/retry.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace atd {
+
+using namespace at;
+
+typedef struct {
+    std::string currency;
+    double amount;
+    std::chrono::steady_clock::time_point time;
+} reservation_t;
+
+// Ledger is the local copy of the balances of a market.
+// Balances are loaded from the market once, then kept up to date locally:
+// the funds needed by an order are reserved before placing it, so that
+// concurrent orders can't spend the same funds twice, and fills are applied
+// without asking the market. reconcile() realigns the ledger with the market.
+class Ledger {
+private:
+    std::shared_ptr<Market> _market;
+    std::shared_ptr<Retrier> _retrier;
+    std::mutex _mux;
+    std::map<std::string, double> _balances;
+    // sum of the reservations, per currency
+    std::map<std::string, double> _reserved;
+    // reservations of the placed orders, by txid
+    std::map<std::string, reservation_t> _reservations;
+    // changes of the balance of a currency made locally (placements and
+    // fills): reconcile doesn't overwrite what changed while fetching
+    std::map<std::string, std::uint64_t> _versions;
+    std::uint64_t _untracked;
+
+    void _load(const std::string& currency);
+    void _unreserve(const std::string& currency, double amount);
+
+public:
+    Ledger(std::shared_ptr<Market> market, std::shared_ptr<Retrier> retrier)
+        : _market(market), _retrier(retrier), _untracked(0)
+    {
+    }
+    ~Ledger() {}
+
+    // balance of currency, including the reserved funds
+    double balance(const std::string& currency);
+    // available returns the balance of currency not reserved
+    double available(const std::string& currency);
+    // reserve locks amount of currency for an order about to be placed.
+    // Returns false, reserving nothing, if the available funds are not enough.
+    bool reserve(const std::string& currency, double amount);
+    // release gives back the funds reserved for an order not placed
+    void release(const std::string& currency, double amount);
+    // placed binds a reservation to the order accepted by the market and
+    // returns its id (the order txid, when available).
+    // The funds stay reserved until the order is filled or reconciled.
+    std::string placed(const order_t& order, const std::string& currency,
+                       double amount);
+    // fill applies the fill of a placed order: the reserved funds leave the
+    // ledger, amount of currency enters
+    void fill(const std::string& id, const std::string& currency,
+              double amount);
+    // reconcile reloads the balances from the market and drops the
+    // reservations of the orders no more open. The currencies placed or
+    // filled locally while fetching keep their local balance and
+    // reservations, until the next reconciliation.
+    void reconcile();
+};
+
+}  // end namespace atd
+
+#endif  // ATD_LEDGER_H_
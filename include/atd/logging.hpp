@@ -0,0 +1,72 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_LOGGING_H_
+#define ATD_LOGGING_H_
+
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/spdlog.h>
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace atd {
+
+typedef struct {
+    // messages waiting for the logging thread: when full, the oldest ones
+    // are dropped instead of blocking the caller
+    std::size_t queue_size;
+    spdlog::level::level_enum level;
+    // level of single components, overriding level
+    std::map<std::string, spdlog::level::level_enum> levels;
+    // path of the binary structured log, empty to disable it
+    std::string structured;
+} logging_config_t;
+
+// StructuredSink writes every message as a msgpack map
+// {t: nanoseconds since epoch, l: level, c: component, th: thread,
+// m: message}, prefixed by its size (4 bytes, little endian)
+class StructuredSink : public spdlog::sinks::base_sink<std::mutex> {
+private:
+    std::ofstream _out;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override;
+    void flush_() override;
+
+public:
+    // throws std::runtime_error if path can't be opened
+    StructuredSink(const std::string& path);
+};
+
+// init_logging starts the logging thread shared by every component.
+// Must be called once, before the first component_logger: otherwise the
+// defaults are used.
+void init_logging(const logging_config_t& config);
+
+// component_logger returns the logger of component, created the first
+// time on the shared asynchronous pipeline with the level configured for
+// component. sinks defaults to the console; the structured sink, when
+// enabled, is always added.
+std::shared_ptr<spdlog::logger> component_logger(
+    const std::string& component, std::vector<spdlog::sink_ptr> sinks = {});
+
+}  // end namespace atd
+
+#endif  // ATD_LOGGING_H_
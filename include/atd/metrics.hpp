@@ -0,0 +1,136 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_METRICS_H_
+#define ATD_METRICS_H_
+
+#include <atd/histogram.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace atd {
+
+typedef std::map<std::string, std::string> labels_t;
+
+typedef struct {
+    // serve the metrics only if enabled
+    bool enabled;
+    std::string address;
+    unsigned short port;
+} metrics_config_t;
+
+// Counter is a monotonic counter split in shards: threads increment
+// different cache lines, so a counter on a hot path doesn't bounce between
+// the cores. Reading it sums the shards.
+class Counter {
+private:
+    static constexpr std::size_t _shards = 16;
+    struct alignas(64) shard_t {
+        std::atomic<std::uint64_t> value;
+    };
+    std::array<shard_t, _shards> _values;
+
+    static std::size_t _shard();
+
+public:
+    Counter();
+    ~Counter() {}
+    void inc(std::uint64_t n = 1)
+    {
+        _values[_shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    std::uint64_t value() const;
+};
+
+// Gauge is a value that can go up and down
+class Gauge {
+private:
+    std::atomic<double> _value;
+
+public:
+    Gauge() : _value(0) {}
+    ~Gauge() {}
+    void set(double value) { _value.store(value, std::memory_order_relaxed); }
+    double value() const { return _value.load(std::memory_order_relaxed); }
+};
+
+// Metrics is the registry of the metrics of the daemon.
+// Every metric is identified by name and labels: asking twice for the same
+// metric returns the same object, so the hot paths can keep it instead of
+// looking it up every time. expose() renders every metric in the
+// Prometheus text format; durations are exposed in seconds.
+class Metrics {
+private:
+    typedef struct {
+        std::string help, type;
+        // series, by rendered labels
+        std::map<std::string, std::shared_ptr<Counter>> counters;
+        std::map<std::string, std::shared_ptr<Gauge>> gauges;
+        std::map<std::string, std::function<double()>> readers;
+        std::map<std::string, std::shared_ptr<LatencyHistogram>> histograms;
+    } family_t;
+
+    std::mutex _mux;
+    std::map<std::string, family_t> _families;
+
+    family_t& _family(const std::string& name, const std::string& help,
+                      const std::string& type);
+
+public:
+    ~Metrics() {}
+
+    std::shared_ptr<Counter> counter(const std::string& name,
+                                     const std::string& help,
+                                     const labels_t& labels = {});
+    std::shared_ptr<Gauge> gauge(const std::string& name,
+                                 const std::string& help,
+                                 const labels_t& labels = {});
+    // gauge registers a gauge whose value is read calling read when the
+    // metrics are exposed. A gauge registered again replaces the old one
+    void gauge(const std::string& name, const std::string& help,
+               const labels_t& labels, std::function<double()> read);
+    std::shared_ptr<LatencyHistogram> histogram(const std::string& name,
+                                                const std::string& help,
+                                                const labels_t& labels = {});
+
+    std::string expose();
+};
+
+// MetricsServer serves the metrics over HTTP, at /metrics
+class MetricsServer {
+private:
+    std::shared_ptr<Metrics> _metrics;
+    metrics_config_t _config;
+
+public:
+    MetricsServer(std::shared_ptr<Metrics> metrics,
+                  const metrics_config_t& config)
+        : _metrics(metrics), _config(config)
+    {
+    }
+    ~MetricsServer() {}
+    // serve accepts and answers the requests, one at a time. It never
+    // returns: use it in a new thread
+    void serve();
+};
+
+}  // end namespace atd
+
+#endif  // ATD_METRICS_H_
@@ -0,0 +1,109 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_RATE_GRAPH_H_
+#define ATD_RATE_GRAPH_H_
+
+#include <at/fiat.hpp>
+#include <at/namespace.hpp>
+#include <at/types.hpp>
+#include <atd/clock.hpp>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atd {
+
+using namespace at;
+
+typedef struct {
+    // how many "to" are worth 1 "from"
+    double rate;
+    // the 24h volume (in USD) of the market the rate comes from
+    long long day_volume_usd;
+    std::time_t last_updated;
+    // where the rate comes from (coinmarketcap, a market name, fiat)
+    std::string source;
+} rate_edge_t;
+
+// RateGraph keeps the latest best-volume price between every pair of
+// currencies seen by the monitors (and the fiat rates requested), as the
+// edges of a graph. Any rate(from, to) is answered from a direct edge, or
+// multiplying the edges of the shortest path between the two currencies.
+// Paths are cached and invalidated only when a new edge appears, so every
+// lookup after the first is O(path length), usually 1 or 2.
+class RateGraph {
+private:
+    mutable std::shared_mutex _mux;
+    // edges, by "from/to"
+    std::unordered_map<std::string, rate_edge_t> _edges;
+    // adjacency list: currency -> directly convertible currencies
+    std::unordered_map<std::string, std::set<std::string>> _adjacency;
+    // cached shortest paths (list of edge keys), by "from/to"
+    std::unordered_map<std::string, std::vector<std::string>> _paths;
+    // currencies connected to the graph through the fiat rates
+    std::set<std::string> _fiats;
+    // currencies that are not fiat currencies: never asked twice
+    std::set<std::string> _not_fiats;
+    // an edge older than _max_age is replaced by any newer one
+    std::chrono::seconds _max_age;
+    std::shared_ptr<Clock> _clock;
+    // at::Fiat is not thread safe: _fiat_mux serializes its calls
+    std::mutex _fiat_mux;
+    at::Fiat _fiat;
+
+    static std::string _key(const std::string& from, const std::string& to)
+    {
+        return from + "/" + to;
+    }
+    bool _needs_fiat(const std::string& currency) const;
+    void _connect_fiat(const std::string& currency);
+    bool _shortest_path(const std::string& from, const std::string& to,
+                        std::vector<std::string>& path) const;
+
+public:
+    RateGraph(std::shared_ptr<Clock> clock,
+              const std::chrono::seconds& max_age = std::chrono::hours(1))
+        : _max_age(max_age), _clock(clock)
+    {
+    }
+    ~RateGraph() {}
+
+    // update sets the price of 1 "from" in "to" (and its inverse), as seen in
+    // source, a market with the specified 24h volume. A newer sample of the
+    // source of the stored edge always replaces it. A sample of another
+    // source replaces it only when it comes from a market at least as
+    // liquid, or when the stored one is stale.
+    void update(std::string from, std::string to, double rate,
+                long long day_volume_usd, std::time_t last_updated,
+                const std::string& source);
+
+    // rate returns how many "to" are worth 1 "from".
+    // Throws std::out_of_range if the currencies are not connected.
+    double rate(std::string from, std::string to);
+    double rate(const currency_pair_t& pair)
+    {
+        return rate(pair.first, pair.second);
+    }
+};
+
+}  // end namespace atd
+
+#endif  // ATD_RATE_GRAPH_H_
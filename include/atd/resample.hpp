@@ -0,0 +1,50 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_RESAMPLE_H_
+#define ATD_RESAMPLE_H_
+
+#include <atd/timeseries.hpp>
+#include <chrono>
+#include <string>
+
+namespace atd {
+
+enum class interpolation_t {
+    // the last sample at or before the grid time
+    last,
+    // the line between the samples around the grid time
+    linear,
+    // the mean of the samples of the step ending at the grid time, weighted
+    // by their volume; the previous value if the step has no samples
+    vwap
+};
+
+// resample returns series on a uniform grid: the multiples of step from the
+// first to the last sample time, so that the grids of different series
+// line up. Every column is interpolated with method; with vwap the samples
+// are weighted by the volume column, which is resampled taking the last
+// value.
+// The position of every grid time among the samples is computed once, then
+// applied to every column in a single tight loop.
+// Throws std::invalid_argument if step is not positive, std::out_of_range if
+// the vwap volume column is missing.
+TimeSeries resample(const TimeSeries& series, std::chrono::seconds step,
+                    interpolation_t method,
+                    const std::string& volume = "day_volume_usd");
+
+}  // end namespace atd
+
+#endif  // ATD_RESAMPLE_H_
@@ -0,0 +1,218 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_RETRY_H_
+#define ATD_RETRY_H_
+
+#include <at/types.hpp>
+#include <atd/clock.hpp>
+#include <atd/metrics.hpp>
+#include <atd/tracing.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace atd {
+
+typedef struct {
+    // delay before the first retry, multiplied by multiplier at every
+    // attempt, up to max_delay
+    std::chrono::milliseconds initial_delay, max_delay;
+    double multiplier;
+    // fraction of the delay randomized: 0.2 means delay +/- 20%
+    double jitter;
+    // attempts before giving up, 0 means retry forever
+    unsigned int max_attempts;
+    // consecutive failures that open the circuit of an endpoint
+    unsigned int failure_threshold;
+    // how long an open circuit rejects the calls before letting one try
+    std::chrono::seconds open_timeout;
+} retry_policy_t;
+
+typedef struct {
+    bool open;
+    // consecutive failures and number of times the circuit opened
+    std::uint64_t failures, opened;
+} circuit_stats_t;
+
+// circuit_open is thrown, without calling the endpoint, when its circuit is
+// open
+class circuit_open : public std::runtime_error {
+public:
+    circuit_open(const std::string& what) : std::runtime_error(what) {}
+};
+
+// Backoff computes the exponentially growing and jittered delays to wait
+// between two attempts
+class Backoff {
+private:
+    retry_policy_t _policy;
+    unsigned int _attempts;
+    std::mt19937 _rng;
+
+public:
+    Backoff(const retry_policy_t& policy)
+        : _policy(policy), _attempts(0), _rng(std::random_device()())
+    {
+    }
+    // next returns the delay to wait before the next attempt
+    std::chrono::milliseconds next();
+    // attempts returns the number of delays returned since the last reset
+    unsigned int attempts() const { return _attempts; }
+    const retry_policy_t& policy() const { return _policy; }
+    void reset() { _attempts = 0; }
+};
+
+// CircuitBreaker stops the calls to an endpoint that keeps failing.
+// After failure_threshold consecutive failures the circuit opens and every
+// call is rejected for open_timeout. Then a single call is let through:
+// if it succeeds the circuit closes, otherwise it opens again.
+class CircuitBreaker {
+private:
+    enum class state_t { closed, open, half_open };
+    std::mutex _mux;
+    retry_policy_t _policy;
+    state_t _state;
+    std::chrono::steady_clock::time_point _opened_at;
+    std::uint64_t _failures, _opened;
+
+public:
+    CircuitBreaker(const retry_policy_t& policy)
+        : _policy(policy), _state(state_t::closed), _failures(0), _opened(0)
+    {
+    }
+    // allow returns true if the endpoint can be called
+    bool allow();
+    void success();
+    // failure returns true if the failure opened the circuit
+    bool failure();
+    circuit_stats_t stats();
+};
+
+// Retrier calls the endpoints of a service, retrying with backoff the calls
+// failed because of a server error and failing fast when the circuit of the
+// endpoint is open. Errors in the request (at::response_error) are never
+// retried. The backoff is interrupted, with clock_stopped, by the stop
+// signal of the calling thread (see StopScope).
+// The latency and the errors of every attempt are recorded in the metrics;
+// the attempts are recorded as spans of the current trace.
+class Retrier {
+private:
+    typedef struct {
+        std::shared_ptr<CircuitBreaker> breaker;
+        std::shared_ptr<LatencyHistogram> latency;
+        std::shared_ptr<Counter> server_errors, response_errors;
+    } endpoint_t;
+
+    std::string _name;
+    retry_policy_t _policy;
+    std::shared_ptr<Metrics> _metrics;
+    std::mutex _mux;
+    std::map<std::string, endpoint_t> _endpoints;
+
+    endpoint_t _endpoint(const std::string& endpoint);
+    void _opened(const std::string& endpoint);
+    // _sleep sleeps for delay. Throws clock_stopped as soon as the stop
+    // signal of the calling thread, if any, is requested
+    static void _sleep(std::chrono::milliseconds delay);
+
+public:
+    Retrier(const std::string& name, const retry_policy_t& policy,
+            std::shared_ptr<Metrics> metrics)
+        : _name(name), _policy(policy), _metrics(metrics)
+    {
+    }
+    ~Retrier() {}
+
+    const std::string& name() const { return _name; }
+    const retry_policy_t& policy() const { return _policy; }
+
+    // call returns f(), retrying it on at::server_error. When the attempts
+    // are exhausted, the last at::server_error is thrown.
+    // An at::response_error counts as a success of the endpoint, any other
+    // exception as a failure: both are thrown without retrying.
+    template <class F>
+    auto call(const std::string& endpoint, F f) -> decltype(f())
+    {
+        auto target = _endpoint(endpoint);
+        auto circuit = target.breaker;
+        Backoff backoff(_policy);
+        while (true) {
+            if (!circuit->allow()) {
+                throw circuit_open(_name + "/" + endpoint + ": circuit open");
+            }
+            auto start = std::chrono::steady_clock::now();
+            auto trace = Tracer::current();
+            Span span(trace, trace != 0 ? _name + "/" + endpoint : "");
+            try {
+                if constexpr (std::is_void_v<decltype(f())>) {
+                    f();
+                    target.latency->record(std::chrono::steady_clock::now() -
+                                           start);
+                    circuit->success();
+                    return;
+                }
+                else {
+                    auto ret = f();
+                    target.latency->record(std::chrono::steady_clock::now() -
+                                           start);
+                    circuit->success();
+                    return ret;
+                }
+            }
+            catch (const at::response_error&) {
+                target.latency->record(std::chrono::steady_clock::now() -
+                                       start);
+                target.response_errors->inc();
+                // the server answered: the endpoint works
+                circuit->success();
+                throw;
+            }
+            catch (const at::server_error&) {
+                target.latency->record(std::chrono::steady_clock::now() -
+                                       start);
+                target.server_errors->inc();
+                if (circuit->failure()) {
+                    _opened(endpoint);
+                }
+                if (_policy.max_attempts > 0 &&
+                    backoff.attempts() + 1 >= _policy.max_attempts) {
+                    throw;
+                }
+                _sleep(backoff.next());
+            }
+            catch (...) {
+                // not retried, but it must end the probe of a half open
+                // circuit: otherwise the circuit would stay half open
+                if (circuit->failure()) {
+                    _opened(endpoint);
+                }
+                throw;
+            }
+        }
+    }
+
+    // circuits returns the state of the circuit of every endpoint called
+    std::map<std::string, circuit_stats_t> circuits();
+};
+
+}  // end namespace atd
+
+#endif  // ATD_RETRY_H_
@@ -0,0 +1,48 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_SEMAPHORE_H_
+#define ATD_SEMAPHORE_H_
+
+#include <condition_variable>
+#include <mutex>
+
+namespace atd {
+
+// semaphore is a counting semaphore: at most count threads can hold it
+class semaphore {
+private:
+    std::mutex _m;
+    std::condition_variable _cv;
+    unsigned int _count;
+
+public:
+    semaphore(unsigned int count) : _count(count) {}
+    // acquire waits until the semaphore can be held
+    void acquire()
+    {
+        std::unique_lock<std::mutex> lock(_m);
+        _cv.wait(lock, [&]() { return _count > 0; });
+        --_count;
+    }
+    void release()
+    {
+        std::unique_lock<std::mutex> lock(_m);
+        ++_count;
+        _cv.notify_one();
+    }
+};
+}  // end namespace atd
+
+#endif
@@ -0,0 +1,112 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_SIMULATED_MARKET_H_
+#define ATD_SIMULATED_MARKET_H_
+
+#include <at/market.hpp>
+#include <at/types.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace atd {
+
+using namespace at;
+
+typedef struct {
+    currency_pair_t pair;
+    // initial mid price, relative distance between ask and bid and standard
+    // deviation of the relative price change at every step
+    double price, spread, volatility;
+    // volume quoted at the best ask and bid
+    double depth;
+    min_max_t limit;
+} simulated_pair_t;
+
+typedef struct {
+    // same seed and same sequence of calls give the same prices and errors
+    std::uint64_t seed;
+    // round trip of every call: latency +/- latency_jitter
+    std::chrono::milliseconds latency, latency_jitter;
+    // probability of a call to fail with at::server_error or
+    // at::response_error
+    double server_error_rate, response_error_rate;
+    // percentages, like the ones of market_info_t
+    double maker_fee, taker_fee;
+    std::map<std::string, double> balances;
+    std::vector<simulated_pair_t> pairs;
+} simulated_market_config_t;
+
+// SimulatedMarket is an in-process market, to test the trader without
+// trading on a real one.
+// Prices follow a seeded random walk: every ticker and place call on a pair
+// moves its price one step. Market orders and limit orders crossing the
+// spread are filled immediately with the taker fee, the other limit orders
+// stay open until the price reaches them and are filled with the maker fee.
+// The prices can also be driven from outside, with quote: a backtest moves
+// them along the saved history.
+class SimulatedMarket : public Market {
+private:
+    simulated_market_config_t _config;
+    std::mutex _mux;
+    std::mt19937_64 _rng;
+    std::map<currency_pair_t, simulated_pair_t> _pairs;
+    std::map<currency_pair_t, double> _prices;
+    std::map<std::string, double> _balances;
+    // funds locked by the open orders
+    std::map<std::string, double> _held;
+    // open orders, by txid
+    std::map<std::string, order_t> _open;
+    std::vector<order_t> _closed;
+    // fees paid, per currency
+    std::map<std::string, double> _fees;
+    std::uint64_t _txid;
+
+    void _call(const std::string& endpoint);
+    const simulated_pair_t& _pair(const currency_pair_t&);
+    ticker_t _ticker(const currency_pair_t&);
+    void _step(const currency_pair_t&);
+    void _reach(const currency_pair_t&);
+    void _fill(order_t&, double price, double fee);
+
+public:
+    SimulatedMarket(const simulated_market_config_t& config);
+    ~SimulatedMarket() {}
+
+    std::vector<currency_pair_t> pairs() override;
+    std::map<currency_pair_t, market_info_t> info() override;
+    market_info_t info(const currency_pair_t&) override;
+    std::map<std::string, double> balance() override;
+    double balance(const std::string&) override;
+    ticker_t ticker(const currency_pair_t&) override;
+    std::vector<order_t> closedOrders() override;
+    std::vector<order_t> openOrders() override;
+    void place(order_t&) override;
+    void cancel(const order_t&) override;
+
+    // quote sets the mid price of pair, filling the open orders it reaches.
+    // Throws at::response_error if pair is not simulated.
+    void quote(const currency_pair_t& pair, double price);
+    // fees returns the fees paid, per currency
+    std::map<std::string, double> fees();
+};
+
+}  // end namespace atd
+
+#endif  // ATD_SIMULATED_MARKET_H_
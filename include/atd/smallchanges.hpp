@@ -15,7 +15,6 @@
 #ifndef ATD_SMALL_CHANGES_STRATEGY_H_
 #define ATD_SMALL_CHANGES_STRATEGY_H_
 
-#include <at/fiat.hpp>
 #include <atd/strategy.hpp>
 
 namespace atd {
@@ -33,13 +32,18 @@ private:
     std::chrono::minutes _stats_period;
     double _margin_profit_percentage = 0;
     double _dip_percentage = 0;
-    at::Fiat _fiat;
+
+    // _tradable returns true if more than 8 samples of currency have been
+    // saved in the stats period and overall, the extreme of the stats
+    // period, is updated to one of them
+    bool _tradable(const std::string &currency,
+                   const indicator_value_t &overall) const;
 
 public:
     SmallChanges(std::shared_ptr<DataMonitor> monitors,
                  std::shared_ptr<channel<message_t>> chan,
                  quantity_t buy_quantity, quantity_t sell_quantity)
-        : Strategy(monitors, chan)
+        : Strategy(monitors, chan, "smallchanges")
     {
         _buy_quantity = buy_quantity;
         _sell_quantity = sell_quantity;
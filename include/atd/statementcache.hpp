@@ -0,0 +1,103 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_STATEMENT_CACHE_H_
+#define ATD_STATEMENT_CACHE_H_
+
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace atd {
+
+typedef struct {
+    // number of statements compiled and number of leases returned
+    std::uint64_t prepared, executed;
+    // time spent compiling the SQL and time spent binding and stepping
+    std::chrono::nanoseconds prepare_time, execute_time;
+} statement_stats_t;
+
+// StatementCache keeps the prepared statements of a single database
+// connection, so that the same SQL is parsed and planned only once.
+// A cached statement is leased to one thread at a time: concurrent callers
+// of the same SQL receive different statements.
+class StatementCache {
+private:
+    SQLite::Database* _db;
+    std::mutex _mux;
+    // idle statements, by SQL text
+    std::map<std::string, std::vector<std::unique_ptr<SQLite::Statement>>>
+        _idle;
+    std::atomic<std::uint64_t> _prepared, _executed;
+    std::atomic<std::int64_t> _prepare_ns, _execute_ns;
+
+    void _release(const std::string& sql,
+                  std::unique_ptr<SQLite::Statement> statement,
+                  std::chrono::steady_clock::time_point leased_at) noexcept;
+
+public:
+    // lease gives exclusive access to a cached statement. When the lease
+    // goes out of scope, the statement is reset, its bindings cleared and
+    // returned to the cache; a statement that fails to reset is discarded.
+    class lease {
+    private:
+        StatementCache* _cache;
+        std::string _sql;
+        std::unique_ptr<SQLite::Statement> _statement;
+        std::chrono::steady_clock::time_point _leased_at;
+
+    public:
+        lease(StatementCache* cache, const std::string& sql,
+              std::unique_ptr<SQLite::Statement> statement)
+            : _cache(cache),
+              _sql(sql),
+              _statement(std::move(statement)),
+              _leased_at(std::chrono::steady_clock::now())
+        {
+        }
+        lease(lease&&) = default;
+        lease(const lease&) = delete;
+        lease& operator=(const lease&) = delete;
+        ~lease()
+        {
+            if (_statement) {
+                _cache->_release(_sql, std::move(_statement), _leased_at);
+            }
+        }
+        SQLite::Statement& operator*() { return *_statement; }
+        SQLite::Statement* operator->() { return _statement.get(); }
+    };
+
+    StatementCache(SQLite::Database* db)
+        : _db(db), _prepared(0), _executed(0), _prepare_ns(0), _execute_ns(0)
+    {
+    }
+    ~StatementCache() {}
+
+    // acquire returns a statement ready to be bound for the given SQL,
+    // preparing it only if every cached one is in use
+    lease acquire(const std::string& sql);
+    // stats returns the prepare vs execute counters
+    statement_stats_t stats() const;
+};
+
+}  // end namespace atd
+
+#endif  // ATD_STATEMENT_CACHE_H_
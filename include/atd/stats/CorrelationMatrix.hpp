@@ -0,0 +1,79 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_STATS_CORRELATION_MATRIX_H_
+#define ATD_STATS_CORRELATION_MATRIX_H_
+
+#include <atd/timeseries.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace atd::stats {
+
+/* CorrelationMatrix is the Pearson correlation between every pair of
+ * assets over the last window rows (one value per asset).
+ * It keeps the sums and the sums of the products of the rows, shifted by a
+ * reference row for precision: every push is a rank-one update, O(assets^2)
+ * whatever the window, and reading a correlation is O(1). The sums are
+ * rebuilt from the stored rows every window pushes, so that the rounding
+ * of the additions and removals doesn't accumulate.
+ * build() computes the sums of a whole window at once: the pairs of assets
+ * are split in tiles, computed in parallel with the comoments kernel. */
+class CorrelationMatrix {
+private:
+    std::size_t _assets, _window;
+    // rows in the window, position of the next row in the ring and pushes
+    // since the last rebuild
+    std::size_t _count, _next, _pushes;
+    // ring of the last window rows, row major
+    column_t<double> _rows;
+    // reference row, sums of (x - shift) and of their products, row major
+    std::vector<double> _shift, _sums;
+    column_t<double> _products;
+    // scratch rows of the push
+    std::vector<double> _added, _removed;
+
+    void _build(const std::vector<const double *> &columns, std::size_t rows,
+                unsigned threads);
+    void _rebuild();
+
+public:
+    CorrelationMatrix(std::size_t assets, std::size_t window);
+
+    /* build replaces the rows with the last window values of columns, one
+     * column per asset, all of the same size. threads = 0 uses a thread per
+     * core. */
+    void build(const std::vector<column_view<double>> &columns,
+               unsigned threads = 0);
+    /* push adds a row of assets values, evicting the oldest one when the
+     * window is full */
+    void push(const double *row);
+    void push(const std::vector<double> &row) { push(row.data()); }
+
+    std::size_t assets() const { return _assets; }
+    std::size_t window() const { return _window; }
+    std::size_t count() const { return _count; }
+    bool full() const { return _count == _window; }
+
+    /* correlation between the assets i and j, NaN if one of them has no
+     * variance (or there are less than 2 rows) */
+    double correlation(std::size_t i, std::size_t j) const;
+    /* matrix returns every correlation, row major */
+    std::vector<double> matrix() const;
+};
+
+}  // namespace atd::stats
+
+#endif  // ATD_STATS_CORRELATION_MATRIX_H_
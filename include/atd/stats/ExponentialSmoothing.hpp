@@ -12,53 +12,104 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.*/
 
-#ifndef ATD_STATS_H_
-#define ATD_STATS_H_
 
-#include <algorithm>
-#include <cmath>
-#include <numeric>
-#include <tuple>
-#include <vector>
+#ifndef ATD_STATS_EXPONENTIAL_SMOOTHING_H_
+#define ATD_STATS_EXPONENTIAL_SMOOTHING_H_
+
+#include <cstddef>
+#include <stdexcept>
 
 namespace atd::stats {
 
-/* First order exponential smoothing on vector ts, using the specified alpha
- * factor*/
+/* ExponentialSmoothing is a double exponential smoother: it tracks the level
+ * and the trend of a stream of samples and forecasts the next ones.
+ * Every push updates the state in O(1), no history is kept.
+ *
+ * Built with a single factor it's Brown's linear exponential smoothing:
+ *   s'_t = alpha x_t + (1 - alpha) s'_{t-1}
+ *   s''_t = alpha s'_t + (1 - alpha) s''_{t-1}
+ *   level a_t = 2 s'_t - s''_t
+ *   trend b_t = alpha / (1 - alpha) (s'_t - s''_t)
+ * Built with two factors it's Holt's linear trend method:
+ *   level a_t = alpha x_t + (1 - alpha) (a_{t-1} + b_{t-1})
+ *   trend b_t = beta (a_t - a_{t-1}) + (1 - beta) b_{t-1}
+ * where the first trend is the difference of the first two samples.
+ * In both cases the forecast m steps ahead is F_{t+m} = a_t + m b_t */
 template <typename T>
 class ExponentialSmoothing {
 private:
-    // smoothing factor
-    T _alpha1, _alpha2;
-    std::vector<T> _ts, _first, _second;
+    bool _holt;
+    T _alpha, _beta;
+    std::size_t _n;
+    // Brown: first and second order smoothed values.
+    // Holt: level and trend.
+    T _s1, _s2;
 
 public:
-    ExponentialSmoothing(std::vector<T> const &ts) { _ts = ts; }
-
-    /* Compute first order exponential smoothing. The result is stored
-     * internally and a copy of the smoothed time series is returned. */
-    const std::vector<T> first_order(T alpha1);
+    /* Brown's smoother, alpha in (0, 1) */
+    ExponentialSmoothing(T alpha)
+        : _holt(false), _alpha(alpha), _beta(0), _n(0), _s1(0), _s2(0)
+    {
+        if (!(alpha > 0 && alpha < 1)) {
+            throw std::invalid_argument(
+                "ExponentialSmoothing: alpha must be in (0, 1)");
+        }
+    }
+    /* Holt's smoother, alpha and beta in (0, 1] */
+    ExponentialSmoothing(T alpha, T beta)
+        : _holt(true), _alpha(alpha), _beta(beta), _n(0), _s1(0), _s2(0)
+    {
+        if (!(alpha > 0 && alpha <= 1 && beta > 0 && beta <= 1)) {
+            throw std::invalid_argument(
+                "ExponentialSmoothing: alpha and beta must be in (0, 1]");
+        }
+    }
 
-    /* Second order exponential smoothing on vector ts, using the specified
-     * alpha factor. Brown's linear exponential smoothing (LES) aka Brown's
-     * double exp smoothing. Returns the second order smoothed series.*/
-    const inline std::pair<std::vector<T>, std::vector<T>> second_order(
-        T alpha2);
+    void push(T x)
+    {
+        ++_n;
+        if (_n == 1) {
+            _s1 = x;
+            _s2 = _holt ? 0 : x;
+            return;
+        }
+        if (!_holt) {
+            _s1 = _alpha * x + (1 - _alpha) * _s1;
+            _s2 = _alpha * _s1 + (1 - _alpha) * _s2;
+            return;
+        }
+        if (_n == 2) {
+            _s2 = x - _s1;
+            _s1 = x;
+            return;
+        }
+        T previous = _s1;
+        _s1 = _alpha * x + (1 - _alpha) * (_s1 + _s2);
+        _s2 = _beta * (_s1 - previous) + (1 - _beta) * _s2;
+    }
+    void reset()
+    {
+        _n = 0;
+        _s1 = _s2 = 0;
+    }
 
-    /* Given the resulting series of second_exp_smoothing, returns the series of
-     * the estimate values from 0 to the given time step. If the input time
-     * series have a size of N, then the result with t <= N will be the second
-     * order exponential smoothing value at t. If t > N it will be the second
-     * order forecast. In both cases the formula is: a_t = 2s'_t - s''t; =
-     * estimated level at time t b_t = \frac{alpha}{1-alpha}(s't - s''t); =
-     * estimated trend at time t F_{t+m} = a_t + m b_t, where m is != 0 only if
-     * t > N (m = N - t) The return value is the pari a_t, b_t
-     * TODO: sistemare questa funzione per farla andare. Muovere classe in
-     * header+cc separati
-     */
-    const inline std::pair<T, T> second_order_forecast(size_t t);
+    std::size_t count() const { return _n; }
+    /* first order smoothed value (Brown), the level (Holt) */
+    T smoothed() const { return _s1; }
+    /* estimated level a_t, 0 if there are no samples */
+    T level() const { return _holt ? _s1 : 2 * _s1 - _s2; }
+    /* estimated trend b_t, per step */
+    T trend() const
+    {
+        return _holt ? _s2 : _alpha / (1 - _alpha) * (_s1 - _s2);
+    }
+    /* forecast returns the value expected m steps after the last sample */
+    T forecast(std::size_t m = 1) const
+    {
+        return level() + static_cast<T>(m) * trend();
+    }
 };
 
 }  // namespace atd::stats
 
-#endif  // ATD_STATS_H_
+#endif  // ATD_STATS_EXPONENTIAL_SMOOTHING_H_
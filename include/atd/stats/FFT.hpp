@@ -0,0 +1,50 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_STATS_FFT_H_
+#define ATD_STATS_FFT_H_
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace atd::stats {
+
+/* FFT is an iterative radix-2 fast Fourier transform of a fixed size, with
+ * its twiddle factors and bit reversal permutation computed once. */
+class FFT {
+private:
+    std::size_t _size;
+    std::vector<std::complex<double>> _twiddles;
+    std::vector<std::size_t> _reversed;
+
+    void _transform(std::vector<std::complex<double>> &data,
+                    bool inverse) const;
+
+public:
+    /* size must be a power of 2, otherwise std::invalid_argument is
+     * thrown */
+    FFT(std::size_t size);
+
+    std::size_t size() const { return _size; }
+    /* In place transforms of data, that must have size() items. inverse
+     * is scaled by 1/size(): inverse(forward(x)) == x */
+    void forward(std::vector<std::complex<double>> &data) const;
+    void inverse(std::vector<std::complex<double>> &data) const;
+};
+
+}  // namespace atd::stats
+
+#endif  // ATD_STATS_FFT_H_
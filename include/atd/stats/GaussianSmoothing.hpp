@@ -0,0 +1,90 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_STATS_GAUSSIAN_SMOOTHING_H_
+#define ATD_STATS_GAUSSIAN_SMOOTHING_H_
+
+#include <atd/stats/FFT.hpp>
+#include <atd/timeseries.hpp>
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace atd::stats {
+
+/* GaussianSmoothing smooths a series with the gaussian1d kernel of the given
+ * length and sigma, returning the valid part of the convolution, like
+ * conv(series, gaussian1d(length, sigma)).
+ * Kernels are cached by (length, sigma), sigma rounded to 8 significant
+ * bits (0.2%): building a GaussianSmoothing already used is a lookup.
+ * Short series are convolved directly, by the vectorized kernels; long ones
+ * by FFT overlap-add, in O(n log m) instead of O(n m).
+ * push() smooths a stream instead, one value per new sample. */
+class GaussianSmoothing {
+public:
+    typedef struct {
+        FFT fft;
+        // the taps padded to fft.size(), transformed
+        std::vector<std::complex<double>> spectrum;
+    } spectrum_t;
+
+    typedef struct {
+        std::vector<double> taps;
+        // built by the first overlap-add, never by the direct convolution
+        mutable std::once_flag transformed;
+        mutable std::optional<spectrum_t> spectrum;
+    } kernel_t;
+
+private:
+    std::shared_ptr<const kernel_t> _kernel;
+    // last samples pushed, written twice (at i and i + length), so that
+    // the last length ones are always contiguous
+    std::vector<double> _window;
+    std::size_t _next, _pushed;
+
+    std::vector<double> _direct(column_view<double> series) const;
+    std::vector<double> _overlap_add(column_view<double> series) const;
+
+public:
+    /* length must be odd, like in gaussian1d */
+    GaussianSmoothing(std::size_t length, double sigma);
+
+    /* kernel returns the cached kernel of (length, sigma), building it the
+     * first time. The cache keeps the last kernels used, sigma is rounded
+     * to 8 significant bits */
+    static std::shared_ptr<const kernel_t> kernel(std::size_t length,
+                                                  double sigma);
+
+    std::size_t length() const { return _kernel->taps.size(); }
+    const std::vector<double> &taps() const { return _kernel->taps; }
+
+    /* Returns the series smoothed, series.size() - length() + 1 values; an
+     * empty vector if the series is shorter than the kernel */
+    std::vector<double> smooth(column_view<double> series) const;
+
+    /* push adds a sample to the stream. When at least length() samples
+     * have been pushed, it sets smoothed to the smoothed value centered
+     * length() / 2 samples ago and returns true */
+    bool push(double sample, double &smoothed);
+    /* reset forgets the samples pushed */
+    void reset();
+};
+
+}  // namespace atd::stats
+
+#endif  // ATD_STATS_GAUSSIAN_SMOOTHING_H_
@@ -0,0 +1,137 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_STATS_ROLLING_COVARIANCE_H_
+#define ATD_STATS_ROLLING_COVARIANCE_H_
+
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <stdexcept>
+#include <utility>
+
+namespace atd::stats {
+
+/* RollingCovariance is the covariance, and the Pearson correlation, of the
+ * last window pairs (x, y). Every push updates it in O(1), like
+ * RollingMoments: the means and the co-moments are updated with the new
+ * pair and, when the window is full, downdated with the oldest one. They're
+ * recomputed from the pairs every window pushes. */
+template <typename T>
+class RollingCovariance {
+private:
+    std::size_t _window;
+    std::deque<std::pair<T, T>> _samples;
+    T _x_mean, _y_mean;
+    // sums of (x - x_mean)^2, (y - y_mean)^2 and (x - x_mean)(y - y_mean)
+    T _x_m2, _y_m2, _c;
+    // pushes since the last rebuild
+    std::size_t _pushes;
+
+    void _add(T x, T y, std::size_t n)
+    {
+        T dx = x - _x_mean, dy = y - _y_mean;
+        _x_mean += dx / n;
+        _y_mean += dy / n;
+        _x_m2 += dx * (x - _x_mean);
+        _y_m2 += dy * (y - _y_mean);
+        _c += dx * (y - _y_mean);
+    }
+    void _rebuild()
+    {
+        _x_mean = _y_mean = _x_m2 = _y_m2 = _c = 0;
+        std::size_t n = 0;
+        for (auto [x, y] : _samples) {
+            _add(x, y, ++n);
+        }
+        _pushes = 0;
+    }
+
+public:
+    RollingCovariance(std::size_t window)
+        : _window(window),
+          _x_mean(0),
+          _y_mean(0),
+          _x_m2(0),
+          _y_m2(0),
+          _c(0),
+          _pushes(0)
+    {
+        if (window == 0) {
+            throw std::invalid_argument("RollingCovariance: empty window");
+        }
+    }
+
+    void push(T x, T y)
+    {
+        if (_samples.size() == _window) {
+            pop();
+        }
+        _samples.push_back(std::pair(x, y));
+        _add(x, y, _samples.size());
+        if (++_pushes == _window) {
+            _rebuild();
+        }
+    }
+    /* pop removes the oldest pair, if any */
+    void pop()
+    {
+        if (_samples.empty()) {
+            return;
+        }
+        auto [x, y] = _samples.front();
+        _samples.pop_front();
+        auto n = _samples.size();
+        if (n == 0) {
+            _x_mean = _y_mean = _x_m2 = _y_m2 = _c = 0;
+            return;
+        }
+        T dx = x - _x_mean, dy = y - _y_mean;
+        _x_mean -= dx / n;
+        _y_mean -= dy / n;
+        _x_m2 -= dx * (x - _x_mean);
+        _y_m2 -= dy * (y - _y_mean);
+        _c -= dx * (y - _y_mean);
+        // rounding can push them slightly below zero
+        _x_m2 = _x_m2 < 0 ? 0 : _x_m2;
+        _y_m2 = _y_m2 < 0 ? 0 : _y_m2;
+    }
+
+    std::size_t window() const { return _window; }
+    std::size_t count() const { return _samples.size(); }
+    bool full() const { return _samples.size() == _window; }
+    T x_mean() const { return _x_mean; }
+    T y_mean() const { return _y_mean; }
+    /* population variances and covariance, 0 if there are no samples */
+    T x_variance() const
+    {
+        return _samples.empty() ? 0 : _x_m2 / _samples.size();
+    }
+    T y_variance() const
+    {
+        return _samples.empty() ? 0 : _y_m2 / _samples.size();
+    }
+    T covariance() const
+    {
+        return _samples.empty() ? 0 : _c / _samples.size();
+    }
+    /* pearson returns the correlation coefficient, NaN if x or y is
+     * constant in the window */
+    T pearson() const { return _c / std::sqrt(_x_m2 * _y_m2); }
+};
+
+}  // namespace atd::stats
+
+#endif  // ATD_STATS_ROLLING_COVARIANCE_H_
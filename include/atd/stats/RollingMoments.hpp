@@ -0,0 +1,115 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_STATS_ROLLING_MOMENTS_H_
+#define ATD_STATS_ROLLING_MOMENTS_H_
+
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <stdexcept>
+
+namespace atd::stats {
+
+/* RollingMoments is the mean and the variance of the last window samples.
+ * Every push updates them in O(1): the new sample is added and, when the
+ * window is full, the oldest one is removed, applying Welford's update
+ * backwards. Every window pushes they're recomputed from the samples, so
+ * that the rounding of the removals doesn't accumulate (amortized O(1)). */
+template <typename T>
+class RollingMoments {
+private:
+    std::size_t _window;
+    std::deque<T> _samples;
+    T _mean, _m2;
+    // pushes since the last rebuild
+    std::size_t _pushes;
+
+    void _rebuild()
+    {
+        _mean = _m2 = 0;
+        std::size_t n = 0;
+        for (auto x : _samples) {
+            T delta = x - _mean;
+            _mean += delta / ++n;
+            _m2 += delta * (x - _mean);
+        }
+        _pushes = 0;
+    }
+
+    void _remove(T x)
+    {
+        auto n = _samples.size();
+        if (n == 0) {
+            _mean = _m2 = 0;
+            return;
+        }
+        T delta = x - _mean;
+        _mean -= delta / n;
+        _m2 -= delta * (x - _mean);
+        // rounding can push it slightly below zero
+        if (_m2 < 0) {
+            _m2 = 0;
+        }
+    }
+
+public:
+    RollingMoments(std::size_t window)
+        : _window(window), _mean(0), _m2(0), _pushes(0)
+    {
+        if (window == 0) {
+            throw std::invalid_argument("RollingMoments: empty window");
+        }
+    }
+
+    void push(T x)
+    {
+        if (_samples.size() == _window) {
+            pop();
+        }
+        _samples.push_back(x);
+        T delta = x - _mean;
+        _mean += delta / _samples.size();
+        _m2 += delta * (x - _mean);
+        if (++_pushes == _window) {
+            _rebuild();
+        }
+    }
+    /* pop removes the oldest sample, if any */
+    void pop()
+    {
+        if (_samples.empty()) {
+            return;
+        }
+        auto x = _samples.front();
+        _samples.pop_front();
+        _remove(x);
+    }
+
+    std::size_t window() const { return _window; }
+    std::size_t count() const { return _samples.size(); }
+    bool full() const { return _samples.size() == _window; }
+    T mean() const { return _mean; }
+    /* variance of the population, 0 if there are no samples */
+    T variance() const
+    {
+        return _samples.empty() ? 0 : _m2 / _samples.size();
+    }
+    T stdev() const { return std::sqrt(variance()); }
+};
+
+}  // namespace atd::stats
+
+#endif  // ATD_STATS_ROLLING_MOMENTS_H_
@@ -0,0 +1,56 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_STATS_ROLLING_REGRESSION_H_
+#define ATD_STATS_ROLLING_REGRESSION_H_
+
+#include <atd/stats/RollingCovariance.hpp>
+#include <cstddef>
+#include <utility>
+
+namespace atd::stats {
+
+/* RollingRegression is the least squares line Y = a + bX fitted on the last
+ * window pairs (x, y), updated in O(1) per pair. */
+template <typename T>
+class RollingRegression {
+private:
+    RollingCovariance<T> _moments;
+
+public:
+    RollingRegression(std::size_t window) : _moments(window) {}
+
+    void push(T x, T y) { _moments.push(x, y); }
+    void pop() { _moments.pop(); }
+
+    std::size_t window() const { return _moments.window(); }
+    std::size_t count() const { return _moments.count(); }
+    bool full() const { return _moments.full(); }
+    /* slope b, NaN if x is constant in the window */
+    T slope() const { return _moments.covariance() / _moments.x_variance(); }
+    /* intercept a */
+    T intercept() const
+    {
+        return _moments.y_mean() - slope() * _moments.x_mean();
+    }
+    /* line returns (b, a), like least_squares */
+    std::pair<T, T> line() const { return std::pair(slope(), intercept()); }
+    /* r returns the correlation coefficient of the fitted pairs */
+    T r() const { return _moments.pearson(); }
+};
+
+}  // namespace atd::stats
+
+#endif  // ATD_STATS_ROLLING_REGRESSION_H_
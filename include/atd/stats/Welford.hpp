@@ -0,0 +1,71 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_STATS_WELFORD_H_
+#define ATD_STATS_WELFORD_H_
+
+#include <cmath>
+#include <cstddef>
+
+namespace atd::stats {
+
+/* Welford accumulates the mean and the variance of a stream of samples in a
+ * single pass, in O(1) per sample and without storing them.
+ * The running sum of the squared differences is updated with the
+ * difference from the current mean, so it doesn't lose precision like the
+ * sum of the squares does. */
+template <typename T>
+class Welford {
+private:
+    std::size_t _n;
+    T _mean, _m2;
+
+public:
+    Welford() : _n(0), _mean(0), _m2(0) {}
+
+    void push(T x)
+    {
+        ++_n;
+        T delta = x - _mean;
+        _mean += delta / _n;
+        _m2 += delta * (x - _mean);
+    }
+    /* merge adds the samples accumulated by other (Chan et al.) */
+    void merge(const Welford<T> &other)
+    {
+        if (other._n == 0) {
+            return;
+        }
+        auto n = _n + other._n;
+        T delta = other._mean - _mean;
+        _mean += delta * other._n / n;
+        _m2 += other._m2 + delta * delta * _n * other._n / n;
+        _n = n;
+    }
+    void reset() { *this = Welford<T>(); }
+
+    std::size_t count() const { return _n; }
+    T mean() const { return _mean; }
+    /* variance of the population, 0 if there are no samples */
+    T variance() const { return _n > 0 ? _m2 / _n : 0; }
+    /* variance of the sample (Bessel's correction), 0 if there are less
+     * than 2 samples */
+    T sample_variance() const { return _n > 1 ? _m2 / (_n - 1) : 0; }
+    T stdev() const { return std::sqrt(variance()); }
+};
+
+}  // namespace atd::stats
+
+#endif  // ATD_STATS_WELFORD_H_
@@ -0,0 +1,72 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_STATS_KERNELS_H_
+#define ATD_STATS_KERNELS_H_
+
+#include <cstddef>
+
+namespace atd::stats {
+
+/* Instruction sets of the kernels */
+enum class isa_t { scalar, sse2, avx2, avx512 };
+
+/* Fused single pass kernels of the statistics over float and double series.
+ * Every instruction set has its own build of the same kernels: kernels()
+ * selects, once, the best one supported by the CPU.
+ * The sums are computed on the values shifted by a sample of the series, so
+ * that the variances don't lose precision when the mean is large. */
+template <typename T>
+struct kernels_t {
+    isa_t isa;
+    /* out = {sum(x - shift), sum((x - shift)^2)} */
+    void (*moments)(const T *x, std::size_t n, T shift, T *out);
+    /* out = {sum(dx), sum(dy), sum(dx^2), sum(dy^2), sum(dx * dy)} with
+     * dx = x - x_shift, dy = y - y_shift */
+    void (*comoments)(const T *x, const T *y, std::size_t n, T x_shift,
+                      T y_shift, T *out);
+    /* out[i] = sum(taps[t] * signal[i + t]) for i in [0, n - taps_size], the
+     * valid part of the correlation */
+    void (*correlate)(const T *signal, std::size_t n, const T *taps,
+                      std::size_t taps_size, T *out);
+};
+
+/* Returns the best instruction set supported by the CPU */
+isa_t best_isa();
+
+/* Returns true if the CPU supports isa */
+bool supported(isa_t isa);
+
+const char *isa_name(isa_t isa);
+
+/* Returns the kernels built for isa. Throws std::invalid_argument if the CPU
+ * doesn't support it */
+template <typename T>
+const kernels_t<T> &kernels(isa_t isa);
+
+/* Returns the kernels of the best instruction set supported by the CPU */
+template <typename T>
+const kernels_t<T> &kernels()
+{
+    static const kernels_t<T> &best = kernels<T>(best_isa());
+    return best;
+}
+
+extern template const kernels_t<float> &kernels<float>(isa_t);
+extern template const kernels_t<double> &kernels<double>(isa_t);
+
+}  // namespace atd::stats
+
+#endif  // ATD_STATS_KERNELS_H_
@@ -15,78 +15,150 @@
 #ifndef ATD_STATS_H_
 #define ATD_STATS_H_
 
+#include <atd/stats/ExponentialSmoothing.hpp>
+#include <atd/stats/RollingCovariance.hpp>
+#include <atd/stats/RollingMoments.hpp>
+#include <atd/stats/RollingRegression.hpp>
+#include <atd/stats/Welford.hpp>
+#include <atd/stats/kernels.hpp>
+#include <atd/timeseries.hpp>
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <iterator>
 #include <numeric>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 namespace atd::stats {
 
-/* Returns the mean and stddev of the values in vector */
+/* True if the kernels are built for T */
+template <typename T>
+inline constexpr bool vectorized =
+    std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+/* The functions below read the values through column_views: a column of a
+ * TimeSeries, a window of it or a vector (the overloads taking vectors
+ * forward to them) */
+
+/* Returns the mean and stddev of the values in vector, in a single pass */
+template <typename T>
+const inline std::pair<T, T> mean_stdev(column_view<T> vector)
+{
+    if constexpr (vectorized<T>) {
+        T n = vector.size();
+        T shift = vector.empty() ? 0 : vector[0];
+        T sums[2];
+        kernels<T>().moments(vector.data(), vector.size(), shift, sums);
+        T variance = std::max(T(0), (sums[1] - sums[0] * sums[0] / n) / n);
+        return std::pair(shift + sums[0] / n, std::sqrt(variance));
+    }
+    else {
+        Welford<T> moments;
+        for (const auto &x : vector) {
+            moments.push(x);
+        }
+        return std::pair(moments.mean(), moments.stdev());
+    }
+}
 template <typename T>
 const inline std::pair<T, T> mean_stdev(const std::vector<T> &vector)
 {
-    T sum = std::accumulate(vector.begin(), vector.end(), 0.0);
-    T mean = sum / vector.size();
-    std::vector<T> diff(vector.size());
-    std::transform(vector.begin(), vector.end(), diff.begin(),
-                   [mean](T x) { return x - mean; });
-    T squared_sum =
-        std::inner_product(diff.begin(), diff.end(), diff.begin(), 0.0);
-    T stdev = std::sqrt(squared_sum / vector.size());
-    return std::pair(mean, stdev);
+    return mean_stdev(column_view<T>(vector));
 }
 
-/* Returns the pearson correlation coefficient between the values of X and Y */
+/* Returns the sums of the differences of X and Y from their first value:
+ * {sum(dx), sum(dy), sum(dx^2), sum(dy^2), sum(dx * dy)} */
 template <typename T>
-inline double pearson(const std::vector<T> &X, const std::vector<T> &Y)
+inline std::array<T, 5> comoments(column_view<T> X, column_view<T> Y)
 {
-    auto n = X.size();
-    T prod_sum = 0, X_sum = 0, Y_sum = 0;
-
-    for (size_t i = 0; i < n; ++i) {
-        prod_sum += X[i] * X[i];
-        X_sum += X[i];
-        Y_sum += Y[i];
+    auto n = std::min(X.size(), Y.size());
+    T x_shift = n > 0 ? X[0] : 0, y_shift = n > 0 ? Y[0] : 0;
+    std::array<T, 5> sums = {};
+    if constexpr (vectorized<T>) {
+        kernels<T>().comoments(X.data(), Y.data(), n, x_shift, y_shift,
+                               sums.data());
     }
-    double numerator = prod_sum - X_sum * Y_sum / n;
+    else {
+        for (size_t i = 0; i < n; ++i) {
+            T dx = X[i] - x_shift, dy = Y[i] - y_shift;
+            sums[0] += dx;
+            sums[1] += dy;
+            sums[2] += dx * dx;
+            sums[3] += dy * dy;
+            sums[4] += dx * dy;
+        }
+    }
+    return sums;
+}
+template <typename T>
+inline std::array<T, 5> comoments(const std::vector<T> &X,
+                                  const std::vector<T> &Y)
+{
+    return comoments(column_view<T>(X), column_view<T>(Y));
+}
 
-    T X_sum_of_squares = std::inner_product(X.begin(), X.end(), X.begin(), 0.0);
-    T Y_sum_of_squares = std::inner_product(Y.begin(), Y.end(), Y.begin(), 0.0);
-    double denominator = std::sqrt((X_sum_of_squares - std::pow(X_sum, 2) / n) *
-                                   (Y_sum_of_squares - std::pow(Y_sum, 2) / n));
+/* Returns the pearson correlation coefficient between the values of X and Y */
+template <typename T>
+inline double pearson(column_view<T> X, column_view<T> Y)
+{
+    double n = std::min(X.size(), Y.size());
+    auto [X_sum, Y_sum, X_sum_of_squares, Y_sum_of_squares, prod_sum] =
+        comoments(X, Y);
+    double numerator = prod_sum - X_sum * Y_sum / n;
+    double denominator = std::sqrt((X_sum_of_squares - X_sum * X_sum / n) *
+                                   (Y_sum_of_squares - Y_sum * Y_sum / n));
     return numerator / denominator;
 }
+template <typename T>
+inline double pearson(const std::vector<T> &X, const std::vector<T> &Y)
+{
+    return pearson(column_view<T>(X), column_view<T>(Y));
+}
 
 /* Returns the slope and the slope and the intercept of the equation
  * predicted Y = intercept + X * slope */
 template <typename T>
-const inline std::pair<double, double> least_squares(const std::vector<T> &X,
-                                                     const std::vector<T> &Y)
+const inline std::pair<double, double> least_squares(column_view<T> X,
+                                                     column_view<T> Y)
 {
-    double Y_mean, Y_stdev;
-    std::tie(Y_mean, Y_stdev) = mean_stdev(Y);
-    double r = pearson(X, Y);
-    double X_mean, X_stdev;
-    std::tie(X_mean, X_stdev) = mean_stdev(X);
-    double b = r * Y_stdev / X_stdev;
+    double n = std::min(X.size(), Y.size());
+    auto [X_sum, Y_sum, X_sum_of_squares, Y_sum_of_squares, prod_sum] =
+        comoments(X, Y);
+    double b = (prod_sum - X_sum * Y_sum / n) /
+               (X_sum_of_squares - X_sum * X_sum / n);
+    double X_mean = (n > 0 ? X[0] : 0) + X_sum / n;
+    double Y_mean = (n > 0 ? Y[0] : 0) + Y_sum / n;
     double a = Y_mean - b * X_mean;
     return std::pair(b, a);
 }
+template <typename T>
+const inline std::pair<double, double> least_squares(const std::vector<T> &X,
+                                                     const std::vector<T> &Y)
+{
+    return least_squares(column_view<T>(X), column_view<T>(Y));
+}
 
 /* Returns the the result fo the discrete convolution, without padding, between
  * f and g. */
 template <typename T>
-const inline std::vector<T> conv(std::vector<T> const &f,
-                                 std::vector<T> const &g)
+const inline std::vector<T> conv(column_view<T> f, column_view<T> g)
 {
     size_t nf = f.size();
     size_t ng = g.size();
-    std::vector<T> const &min_v = (nf < ng) ? f : g;
-    std::vector<T> const &max_v = (nf < ng) ? g : f;
+    auto min_v = (nf < ng) ? f : g;
+    auto max_v = (nf < ng) ? g : f;
     size_t n = std::max(nf, ng) - std::min(nf, ng) + 1;
     std::vector<T> out(n, T());
+    if constexpr (vectorized<T>) {
+        // the convolution is the correlation with the reversed kernel
+        std::vector<T> taps(std::reverse_iterator<const T *>(min_v.end()),
+                            std::reverse_iterator<const T *>(min_v.begin()));
+        kernels<T>().correlate(max_v.data(), max_v.size(), taps.data(),
+                               taps.size(), out.data());
+        return out;
+    }
     for (size_t i = 0; i < n; ++i) {
         for (int j(min_v.size() - 1), k(i); j >= 0; --j) {
             out[i] += min_v[j] * max_v[k];
@@ -95,6 +167,12 @@ const inline std::vector<T> conv(std::vector<T> const &f,
     }
     return out;
 }
+template <typename T>
+const inline std::vector<T> conv(std::vector<T> const &f,
+                                 std::vector<T> const &g)
+{
+    return conv(column_view<T>(f), column_view<T>(g));
+}
 
 /* Returns a discrete 1d gaussian filter with the specified "lenght" sampling
  * data from a gaussian distribution wiht zero mean and given sigma */
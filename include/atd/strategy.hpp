@@ -18,10 +18,15 @@
 #include <at/market.hpp>
 #include <at/namespace.hpp>
 #include <atd/channel.hpp>
+#include <atd/clock.hpp>
 #include <atd/datamonitor.hpp>
+#include <atd/logging.hpp>
+#include <atd/tracing.hpp>
 #include <atd/types.hpp>
+#include <chrono>
 #include <future>
 #include <memory>
+#include <string>
 #include <thread>
 
 namespace atd {
@@ -33,15 +38,34 @@ using namespace at;
 // and inherit the Strategy constructor, setting the monitors variable
 // DataMonitor can be used to monitor the general markets + read the saved data
 // in the db.
+// Every strategy logs through the logger of its component, on the shared
+// logging pipeline.
+// Strategies read the time and sleep only through the clock of the monitors:
+// the wall clock when trading, a virtual one when backtesting.
 class Strategy {
 protected:
     std::shared_ptr<DataMonitor> _monitors;
     std::shared_ptr<channel<message_t>> _chan;
+    std::shared_ptr<spdlog::logger> _logger;
+    std::shared_ptr<Clock> _clock;
+
+    // _send timestamps the message, opens its trace and sends it to the
+    // trader
+    void _send(message_t message)
+    {
+        message.sent = std::chrono::steady_clock::now();
+        message.trace = Tracer::newTrace();
+        _chan->put(message);
+    }
 
 public:
     Strategy(std::shared_ptr<DataMonitor> monitors,
-             std::shared_ptr<channel<message_t>> chan)
-        : _monitors(monitors), _chan(chan)
+             std::shared_ptr<channel<message_t>> chan,
+             const std::string& component)
+        : _monitors(monitors),
+          _chan(chan),
+          _logger(component_logger(component)),
+          _clock(monitors->clock())
     {
     }
     virtual ~Strategy() {}
@@ -0,0 +1,128 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_SUPERVISOR_H_
+#define ATD_SUPERVISOR_H_
+
+#include <spdlog/spdlog.h>
+#include <atd/channel.hpp>
+#include <atd/metrics.hpp>
+#include <atd/retry.hpp>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace atd {
+
+typedef struct {
+    // a worker that doesn't beat for stall_timeout, beyond the time it
+    // declared to be idle, is stalled
+    std::chrono::seconds stall_timeout;
+    // how often the heartbeats are checked
+    std::chrono::seconds check_period;
+} supervisor_config_t;
+
+// Heartbeat is beaten by a worker to tell it's alive. A worker that is
+// going to wait on purpose (eg. sleeping between two rounds) declares it
+// with idle, so that the wait is not taken for a stall.
+class Heartbeat {
+private:
+    typedef std::chrono::steady_clock clock;
+    clock::duration _timeout;
+    // the worker is stalled after the deadline, in ticks of clock
+    std::atomic<clock::rep> _deadline;
+
+    void _expect(clock::duration within)
+    {
+        _deadline.store((clock::now() + within).time_since_epoch().count(),
+                        std::memory_order_relaxed);
+    }
+
+public:
+    Heartbeat(clock::duration timeout) : _timeout(timeout) { beat(); }
+    void beat() { _expect(_timeout); }
+    // idle tells that the worker is going to wait for duration
+    void idle(clock::duration duration) { _expect(duration + _timeout); }
+    clock::duration timeout() const { return _timeout; }
+    // overdue returns how long ago the deadline expired: a positive value
+    // means the worker is stalled
+    clock::duration overdue() const
+    {
+        return clock::now().time_since_epoch() -
+               clock::duration(_deadline.load(std::memory_order_relaxed));
+    }
+};
+
+// Supervisor runs the never ending functions of the daemon (the workers),
+// each in its own thread. When a worker throws, its exception is queued
+// and the worker is restarted after a backoff that grows with the
+// consecutive failures, so that a persistent failure doesn't become a hot
+// loop. run() logs the queued exceptions and reports the workers whose
+// heartbeat stopped.
+class Supervisor {
+private:
+    typedef struct {
+        std::string name;
+        std::shared_ptr<Heartbeat> heartbeat;
+        // exceptions thrown by the worker, not yet logged
+        std::shared_ptr<channel<std::exception_ptr>> failures;
+        std::shared_ptr<Counter> restarts;
+        std::shared_ptr<Gauge> stalled;
+    } worker_t;
+
+    retry_policy_t _restart_policy;
+    supervisor_config_t _config;
+    std::shared_ptr<spdlog::logger> _error_logger, _console_logger;
+    std::shared_ptr<Metrics> _metrics;
+    std::mutex _mux;
+    std::vector<worker_t> _workers;
+    std::vector<std::thread> _threads;
+
+    void _log(const worker_t& worker, std::exception_ptr failure);
+    void _check(const worker_t& worker);
+
+public:
+    Supervisor(const retry_policy_t& restart_policy,
+               const supervisor_config_t& config,
+               std::shared_ptr<spdlog::logger> error_logger,
+               std::shared_ptr<spdlog::logger> console_logger,
+               std::shared_ptr<Metrics> metrics)
+        : _restart_policy(restart_policy),
+          _config(config),
+          _error_logger(error_logger),
+          _console_logger(console_logger),
+          _metrics(metrics)
+    {
+    }
+    ~Supervisor() {}
+
+    // supervise starts f in a new thread, passing it the heartbeat of the
+    // worker. f is restarted every time it throws or returns.
+    void supervise(const std::string& name,
+                   std::function<void(std::shared_ptr<Heartbeat>)> f);
+    // run logs the failures and checks the heartbeats of the workers.
+    // Never returns.
+    void run();
+};
+
+}  // end namespace atd
+
+#endif  // ATD_SUPERVISOR_H_
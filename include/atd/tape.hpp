@@ -0,0 +1,162 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_TAPE_H_
+#define ATD_TAPE_H_
+
+#include <at/market.hpp>
+#include <at/types.hpp>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace atd {
+
+using namespace at;
+
+enum class tape_mode_t { off, record, replay };
+
+typedef struct {
+    tape_mode_t mode;
+    std::string path;
+    // replay the responses when they were received, or as fast as possible
+    bool original_pacing;
+} tape_config_t;
+
+// encode and decode convert the responses of the API calls to and from json
+json encode(bool);
+json encode(double);
+json encode(const std::map<std::string, double>&);
+json encode(const currency_pair_t&);
+json encode(const cm_ticker_t&);
+json encode(const cm_market_t&);
+json encode(const market_info_t&);
+json encode(const ticker_t&);
+json encode(const order_t&);
+void decode(const json&, bool&);
+void decode(const json&, double&);
+void decode(const json&, std::map<std::string, double>&);
+void decode(const json&, currency_pair_t&);
+void decode(const json&, cm_ticker_t&);
+void decode(const json&, cm_market_t&);
+void decode(const json&, market_info_t&);
+void decode(const json&, ticker_t&);
+void decode(const json&, order_t&);
+
+template <class T>
+json encode(const std::vector<T>& items)
+{
+    json ret = json::array();
+    for (const auto& item : items) {
+        ret.push_back(encode(item));
+    }
+    return ret;
+}
+
+template <class T>
+void decode(const json& obj, std::vector<T>& items)
+{
+    for (const auto& value : obj) {
+        T item = {};
+        decode(value, item);
+        items.push_back(item);
+    }
+}
+
+// Tape records the responses of the calls to the APIs (CoinMarketCap and
+// the markets) and replays them in place of the real calls, to reproduce a
+// run offline.
+// The file is a sequence of records: the size of the record (4 bytes,
+// little endian) followed by the record serialized as MessagePack:
+// {"t": nanoseconds from the start, "c": call, "r": response}, or "e" and
+// "w" (type and message of the error) instead of "r" for failed calls.
+// Responses are replayed per call, in the recorded order. A tape holds a
+// single run: recording overwrites the file.
+class Tape {
+private:
+    tape_config_t _config;
+    std::chrono::steady_clock::time_point _start;
+    std::mutex _mux;
+    std::ofstream _out;
+    std::map<std::string, std::deque<json>> _records;
+
+    void _load();
+    void _write(json& record);
+    json _replay(const std::string& call);
+    json _call(const std::string& call, const std::function<json()>& live);
+
+public:
+    Tape(const tape_config_t& config);
+    ~Tape() {}
+
+    tape_mode_t mode() const { return _config.mode; }
+
+    // call returns f(). In record mode the response, or the
+    // at::server_error and at::response_error thrown, is written to the
+    // tape. In replay mode f is not called: the next recorded response of
+    // call is returned, or its error thrown.
+    template <class F>
+    auto call(const std::string& call, F f) -> decltype(f())
+    {
+        if (_config.mode == tape_mode_t::off) {
+            return f();
+        }
+        auto response = _call(call, [&]() { return encode(f()); });
+        decltype(f()) ret = {};
+        decode(response, ret);
+        return ret;
+    }
+
+    // sleep_for sleeps unless replaying: the pace of a replay is given by
+    // the recorded responses
+    void sleep_for(std::chrono::nanoseconds duration);
+};
+
+// TapedMarket passes every call to market through the tape
+class TapedMarket : public Market {
+private:
+    std::string _name;
+    std::shared_ptr<Market> _market;
+    std::shared_ptr<Tape> _tape;
+
+public:
+    TapedMarket(const std::string& name, std::shared_ptr<Market> market,
+                std::shared_ptr<Tape> tape)
+        : _name(name), _market(market), _tape(tape)
+    {
+    }
+    ~TapedMarket() {}
+
+    std::vector<currency_pair_t> pairs() override;
+    std::map<currency_pair_t, market_info_t> info() override;
+    market_info_t info(const currency_pair_t&) override;
+    std::map<std::string, double> balance() override;
+    double balance(const std::string&) override;
+    ticker_t ticker(const currency_pair_t&) override;
+    std::vector<order_t> closedOrders() override;
+    std::vector<order_t> openOrders() override;
+    void place(order_t&) override;
+    void cancel(const order_t&) override;
+};
+
+}  // end namespace atd
+
+#endif  // ATD_TAPE_H_
@@ -0,0 +1,173 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#ifndef ATD_TIMESERIES_H_
+#define ATD_TIMESERIES_H_
+
+#include <cstddef>
+#include <ctime>
+#include <initializer_list>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace atd {
+
+// aligned_allocator allocates the elements of a container at an address
+// multiple of alignment: the first element of a column starts a cache line
+// and the vector loads of the stats kernels never split the first line
+template <class T, std::size_t alignment>
+struct aligned_allocator {
+    typedef T value_type;
+    template <class U>
+    struct rebind {
+        typedef aligned_allocator<U, alignment> other;
+    };
+
+    aligned_allocator() = default;
+    template <class U>
+    aligned_allocator(const aligned_allocator<U, alignment>&)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(
+            ::operator new(n * sizeof(T), std::align_val_t(alignment)));
+    }
+    void deallocate(T* p, std::size_t)
+    {
+        ::operator delete(p, std::align_val_t(alignment));
+    }
+};
+
+template <class T, class U, std::size_t alignment>
+bool operator==(const aligned_allocator<T, alignment>&,
+                const aligned_allocator<U, alignment>&)
+{
+    return true;
+}
+template <class T, class U, std::size_t alignment>
+bool operator!=(const aligned_allocator<T, alignment>&,
+                const aligned_allocator<U, alignment>&)
+{
+    return false;
+}
+
+// storage of a column of a TimeSeries, aligned to a cache line
+template <class T>
+using column_t = std::vector<T, aligned_allocator<T, 64>>;
+
+// column_view is a non-owning view of contiguous values: a column of a
+// TimeSeries, a window of it or a plain vector. Copying it copies two
+// words. It's valid as long as the storage it views is not reallocated.
+template <class T>
+class column_view {
+private:
+    const T* _data;
+    std::size_t _size;
+
+public:
+    column_view() : _data(nullptr), _size(0) {}
+    column_view(const T* data, std::size_t size) : _data(data), _size(size)
+    {
+    }
+    template <class allocator>
+    column_view(const std::vector<T, allocator>& values)
+        : _data(values.data()), _size(values.size())
+    {
+    }
+
+    const T* data() const { return _data; }
+    std::size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    const T& operator[](std::size_t i) const { return _data[i]; }
+    const T& front() const { return _data[0]; }
+    const T& back() const { return _data[_size - 1]; }
+    const T* begin() const { return _data; }
+    const T* end() const { return _data + _size; }
+
+    // window returns the view of up to count values starting from first
+    column_view<T> window(std::size_t first, std::size_t count) const
+    {
+        if (first > _size) {
+            first = _size;
+        }
+        if (count > _size - first) {
+            count = _size - first;
+        }
+        return column_view<T>(_data + first, count);
+    }
+    // last returns the view of the last count values (or all of them)
+    column_view<T> last(std::size_t count) const
+    {
+        return count >= _size ? *this : window(_size - count, count);
+    }
+    std::vector<T> copy() const { return std::vector<T>(begin(), end()); }
+};
+
+// TimeSeries stores samples as a structure of arrays: a column of times and
+// a column per named value, each contiguous and aligned, so that a column
+// is passed to the stats kernels as it is, without repacking.
+// Rows are only appended, in time order.
+// Views of the columns are invalidated when an append grows the series
+// beyond its capacity: reserve() the rows before taking long-lived views.
+class TimeSeries {
+private:
+    std::vector<std::string> _names;
+    column_t<std::time_t> _time;
+    std::vector<column_t<double>> _columns;
+
+    void _check(std::time_t time, std::size_t values) const;
+
+public:
+    TimeSeries(const std::vector<std::string>& columns);
+    // TimeSeries builds the series from its columns, moved in: the values
+    // columns are in names order and have the size of time, sorted.
+    // Throws std::invalid_argument otherwise.
+    TimeSeries(const std::vector<std::string>& names,
+               column_t<std::time_t> time,
+               std::vector<column_t<double>> columns);
+    ~TimeSeries() {}
+
+    const std::vector<std::string>& columns() const { return _names; }
+    std::size_t size() const { return _time.size(); }
+    bool empty() const { return _time.empty(); }
+    void reserve(std::size_t rows);
+
+    // append adds a row: values are in column order.
+    // Throws std::invalid_argument if the number of values doesn't match
+    // the columns or time precedes the last row.
+    void append(std::time_t time, std::initializer_list<double> values);
+    void append(std::time_t time, const std::vector<double>& values);
+
+    column_view<std::time_t> time() const { return _time; }
+    column_view<double> column(std::size_t index) const
+    {
+        return _columns[index];
+    }
+    // column returns the view of the column name.
+    // Throws std::out_of_range if there's no such column.
+    column_view<double> column(const std::string& name) const;
+
+    // since returns the index of the first row at or after time, size() if
+    // none: column(i).window(since(t), size()) are the values from t on
+    std::size_t since(std::time_t time) const;
+};
+
+}  // end namespace atd
+
+#endif  // ATD_TIMESERIES_H_
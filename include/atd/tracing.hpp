@@ -0,0 +1,96 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#ifndef ATD_TRACING_H_
+#define ATD_TRACING_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace atd {
+
+typedef struct {
+    // the order the span belongs to
+    std::uint64_t trace;
+    std::string name;
+    std::chrono::steady_clock::time_point begin, end;
+} span_t;
+
+// Tracer records the spans of the orders, from the strategy that creates
+// them to the fill, into a ring buffer per thread: recording never
+// contends with other threads, and only the latest spans of every thread
+// are kept. The rings of the exited threads are kept too, up to the last 64.
+// Spans of trace 0 are not recorded: 0 means untraced.
+class Tracer {
+public:
+    // newTrace returns a new trace id
+    static std::uint64_t newTrace();
+    // current returns the trace of the work done by the calling thread, set
+    // by TraceScope
+    static std::uint64_t current();
+    static void record(std::uint64_t trace, const std::string& name,
+                       std::chrono::steady_clock::time_point begin,
+                       std::chrono::steady_clock::time_point end);
+    // dump writes the recorded spans as Chrome trace_event JSON, loadable
+    // by chrome://tracing. The spans of the same trace are linked by flow
+    // arrows
+    static void dump(std::ostream& out);
+
+private:
+    friend class TraceScope;
+    static void _set_current(std::uint64_t trace);
+};
+
+// Span records the span from its construction to its destruction
+class Span {
+private:
+    std::uint64_t _trace;
+    std::string _name;
+    std::chrono::steady_clock::time_point _begin;
+
+public:
+    Span(std::uint64_t trace, const std::string& name)
+        : _trace(trace), _begin(std::chrono::steady_clock::now())
+    {
+        if (_trace != 0) {
+            _name = name;
+        }
+    }
+    ~Span()
+    {
+        Tracer::record(_trace, _name, _begin,
+                       std::chrono::steady_clock::now());
+    }
+};
+
+// TraceScope sets the current trace of the calling thread until its
+// destruction: the calls made meanwhile (eg. the API calls of the Retrier)
+// are recorded in that trace
+class TraceScope {
+private:
+    std::uint64_t _previous;
+
+public:
+    TraceScope(std::uint64_t trace) : _previous(Tracer::current())
+    {
+        Tracer::_set_current(trace);
+    }
+    ~TraceScope() { Tracer::_set_current(_previous); }
+};
+
+}  // end namespace atd
+
+#endif  // ATD_TRACING_H_
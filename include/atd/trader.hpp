@@ -19,47 +19,221 @@
 #include <spdlog/spdlog.h>
 #include <at/market.hpp>
 #include <at/types.hpp>
+#include <atd/cache.hpp>
 #include <atd/channel.hpp>
 #include <atd/datamonitor.hpp>
+#include <atd/histogram.hpp>
+#include <atd/ledger.hpp>
+#include <atd/metrics.hpp>
+#include <atd/retry.hpp>
+#include <atd/semaphore.hpp>
 #include <atd/strategy.hpp>
+#include <atd/supervisor.hpp>
+#include <atd/tracing.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 
 namespace atd {
 
 using namespace at;
 
+typedef struct {
+    // how long the market info (fees and volume limits) are cached
+    std::chrono::seconds info_ttl;
+    // how often the balances ledger is reconciled with the market
+    std::chrono::seconds ledger_reconcile_period;
+    // max age of a ticker used to price an order
+    std::chrono::milliseconds ticker_freshness;
+    // retry policy of the calls to the markets
+    retry_policy_t retry;
+    // how long the market orders of a pair are collected before being
+    // netted and placed together. 0 disables netting
+    std::chrono::milliseconds netting_window;
+    // orders of a market waiting for the answer of the market at the same
+    // time
+    unsigned int max_in_flight;
+    // how often the latencies of the order path are logged
+    std::chrono::seconds latency_report_period;
+} trader_config_t;
+
+typedef struct {
+    // number of orders executed
+    std::uint64_t orders;
+    // time spent in the pair queue and time spent executing
+    std::chrono::nanoseconds wait, max_wait, execution, max_execution;
+} execution_stats_t;
+
+typedef struct {
+    message_t message;
+    // when the message entered the pair queue
+    std::chrono::steady_clock::time_point time;
+} queued_message_t;
+
+typedef struct {
+    message_t message;
+    // the order, with its funds reserved, and its estimated fee
+    order_t order;
+    double fee;
+    // when the order has been sent to the placers
+    std::chrono::steady_clock::time_point dispatched;
+} placement_t;
+
+// latencies of the stages of the order path, from the strategy to the
+// feedback
+typedef struct {
+    // from the strategy to the decisor
+    LatencyHistogram channel;
+    // waiting in the pair queue
+    LatencyHistogram queue;
+    // balance, info and ticker fetches (or cache hits)
+    LatencyHistogram balance, info, ticker;
+    // waiting for the previous order of the pair, a free in-flight slot and
+    // a placer
+    LatencyHistogram slot;
+    // placement, retries included
+    LatencyHistogram place;
+    // from the strategy to the delivery of the feedback
+    LatencyHistogram total;
+} stage_latencies_t;
+
+typedef struct {
+    // number of orders placed
+    std::uint64_t orders;
+    // latency of the placement, retries included
+    std::chrono::nanoseconds p50, p99;
+} placement_stats_t;
+
+// per market state, shared by the threads trading on the same market
+typedef struct {
+    // every call to the market goes through the retrier
+    std::shared_ptr<Retrier> retrier;
+    // info about the traded pairs
+    std::shared_ptr<expiring_cache<currency_pair_t, market_info_t>> infos;
+    // latest tickers of the traded pairs
+    std::shared_ptr<expiring_cache<currency_pair_t, ticker_t>> tickers;
+    // local copy of the balances
+    std::shared_ptr<Ledger> ledger;
+    // limits the orders in flight
+    std::shared_ptr<semaphore> in_flight;
+    // one order in flight per pair: the orders of a pair reach the market
+    // in the order they have been sent
+    std::mutex placing_mux;
+    std::map<currency_pair_t, std::shared_ptr<semaphore>> placing;
+    // messages received by the decisor and waiting for their feedback, by
+    // trace
+    std::mutex pending_mux;
+    std::map<std::uint64_t, message_t> pending;
+    // latencies of the order path of the market and of every pair
+    stage_latencies_t latencies;
+    std::mutex latencies_mux;
+    std::map<currency_pair_t, std::shared_ptr<stage_latencies_t>>
+        pair_latencies;
+    // latency of the orders, per pair
+    std::mutex stats_mux;
+    std::map<currency_pair_t, execution_stats_t> stats;
+} market_state_t;
+
+// buy_trade_balance returns how much of quote_balance (pair.second) the buy
+// order of message spends, following its budget. price returns the market
+// price of the pair, asked only if the order has no price and the budget is
+// in the base currency.
+double buy_trade_balance(const message_t& message, double quote_balance,
+                         const std::function<double()>& price);
+// sell_trade_balance returns how much of base_balance (pair.first) the sell
+// order of message sells, following its budget. price is asked only if the
+// order has no price and the budget is in the quote currency.
+double sell_trade_balance(const message_t& message, double base_balance,
+                          const std::function<double()>& price);
+
 class Trader {
 private:
     std::shared_ptr<DataMonitor> _monitors;
     std::shared_ptr<channel<message_t>> _chan;
     std::shared_ptr<spdlog::logger> _error_logger;
     std::shared_ptr<spdlog::logger> _console_logger;
+    trader_config_t _config;
+    std::shared_ptr<Metrics> _metrics;
+    // ids of the orders netted without reaching the market
+    std::atomic<std::uint64_t> _netted;
+    // decisors reading _chan, of every market: a stopping intramarket
+    // drains _chan only when none is left to execute the messages
+    std::atomic<std::size_t> _decisors;
+
+    std::mutex _states_mux;
+    std::map<Market*, std::shared_ptr<market_state_t>> _states;
+    void _init_state(const std::string& name, std::shared_ptr<Market>);
+    std::shared_ptr<market_state_t> _state(std::shared_ptr<Market>);
+    std::shared_ptr<semaphore> _placing(std::shared_ptr<Market>,
+                                        const currency_pair_t&);
+    ticker_t _ticker(std::shared_ptr<Market>, const at::currency_pair_t&);
+    market_info_t _market_info(std::shared_ptr<Market>,
+                               const at::currency_pair_t&);
+    double _available(std::shared_ptr<Market>, const at::currency_pair_t&,
+                      const std::string& currency);
+    void _latency(std::shared_ptr<Market>, const currency_pair_t&,
+                  LatencyHistogram stage_latencies_t::*stage,
+                  std::chrono::nanoseconds);
+    void _report(const std::string& name, std::shared_ptr<Market>);
+    void _place(std::shared_ptr<Market>, order_t&, double fee);
+    bool _send(std::shared_ptr<Market>, order_t&, double fee);
+    bool _prepare(std::shared_ptr<Market>, const message_t&, order_t&,
+                  double& fee);
+    void _feedback(std::shared_ptr<Market>, const message_t&,
+                   const order_t&);
+    bool _execute(std::shared_ptr<Market>, const message_t&, order_t&);
+    void _dispatch(std::shared_ptr<Market>, const message_t&,
+                   std::shared_ptr<channel<placement_t>>);
+    void _net(std::shared_ptr<Market>, const std::vector<message_t>&,
+              std::shared_ptr<channel<placement_t>>);
+    void _record(std::shared_ptr<Market>, const currency_pair_t&,
+                 std::chrono::nanoseconds wait,
+                 std::chrono::nanoseconds execution);
 
     double _market_buy_price(std::shared_ptr<Market>,
                              const at::currency_pair_t&);
     double _market_sell_price(std::shared_ptr<Market>,
                               const at::currency_pair_t&);
-    double _buy_trade_balance(std::shared_ptr<Market>, const message_t&);
-    double _sell_trade_balance(std::shared_ptr<Market>, const message_t&);
 
 public:
     Trader(std::shared_ptr<DataMonitor> monitors,
            std::shared_ptr<channel<message_t>> chan,
            std::shared_ptr<spdlog::logger> error_logger,
-           std::shared_ptr<spdlog::logger> console_logger)
+           std::shared_ptr<spdlog::logger> console_logger,
+           const trader_config_t& config, std::shared_ptr<Metrics> metrics)
         : _monitors(monitors),
           _chan(chan),
           _error_logger(error_logger),
-          _console_logger(console_logger)
+          _console_logger(console_logger),
+          _config(config),
+          _metrics(metrics),
+          _netted(0),
+          _decisors(0)
     {
     }
     ~Trader() {}
-    // intramarket trading function, use it in a new thread
+    // intramarket trading function, use it in a new thread.
+    // The decisor beats heartbeat, even when no message arrives.
+    // Returns only by throwing the first failure of its threads, after
+    // having stopped and joined all of them, strategies included: it can be
+    // restarted.
+    // Every market executes the messages of the shared channel, whatever
+    // the market of the strategy that sent them: while stopping, the
+    // messages are left to the other markets, and failed only if no other
+    // market is trading.
     void intramarket(
-        std::shared_ptr<Market> market,
+        const std::string& name, std::shared_ptr<Market> market,
         const std::map<currency_pair_t, std::vector<std::shared_ptr<Strategy>>>&
-            strategies);
+            strategies,
+        std::shared_ptr<Heartbeat> heartbeat);
+    // per pair queue and execution latency of the orders of market
+    std::map<currency_pair_t, execution_stats_t> stats(std::shared_ptr<Market>);
+    // latency of the placement of the orders of market
+    placement_stats_t placementStats(std::shared_ptr<Market>);
 };
 }  // end namespace atd
 
@@ -18,6 +18,9 @@
 #include <at/market.hpp>
 #include <at/types.hpp>
 #include <atd/channel.hpp>
+#include <atd/retry.hpp>
+#include <chrono>
+#include <cstdint>
 
 namespace atd {
 
@@ -33,12 +36,20 @@ typedef struct {
 typedef struct {
     std::shared_ptr<at::Market> market;
     at::order_t order;
+    // calls to market should go through retrier, sharing its circuits
+    std::shared_ptr<Retrier> retrier;
+    // trace of the message that placed the order
+    std::uint64_t trace;
 } feedback_t;
 
 typedef struct {
     at::order_t order;
     budget_t budget;
     std::shared_ptr<channel<feedback_t>> feedback;
+    // when the strategy sent the message
+    std::chrono::steady_clock::time_point sent;
+    // trace of the order, from the strategy to the fill (see Tracer)
+    std::uint64_t trace;
 } message_t;
 
 }  // end namespace atd
@@ -0,0 +1,313 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <atd/backtest.hpp>
+#include <atd/trader.hpp>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace atd {
+
+static const std::string _range_sql =
+    "SELECT strftime('%s', min(time)) as first, "
+    "strftime('%s', max(time)) as last FROM monitored_currencies";
+
+static const std::string _snapshots_sql =
+    "SELECT currency, strftime('%s', time) as timestamp, price_btc, "
+    "price_usd, day_volume_usd, market_cap_usd, percent_change_1h, "
+    "percent_change_24h, percent_change_7d "
+    "FROM monitored_currencies "
+    "WHERE time > datetime(?, 'unixepoch') "
+    "AND time <= datetime(?, 'unixepoch') "
+    "ORDER BY time ASC";
+
+Backtest::Backtest(SQLite::Database* db, const std::chrono::seconds& period,
+                   std::size_t correlation_window,
+                   const backtest_config_t& config,
+                   const retry_policy_t& retry,
+                   std::shared_ptr<Metrics> metrics)
+    : _db(db),
+      _config(config),
+      _chan(std::make_shared<channel<message_t>>()),
+      _retrier(std::make_shared<Retrier>("backtest", retry, metrics)),
+      _logger(component_logger("backtest")),
+      _report()
+{
+    SQLite::Statement range(*_db, _range_sql);
+    range.executeStep();
+    if (range.getColumn("first").isNull()) {
+        throw std::runtime_error("Backtest: no saved snapshot to replay");
+    }
+    _report.from = _config.from > 0
+                       ? _config.from
+                       : static_cast<std::time_t>(
+                             range.getColumn("first").getInt64());
+    _report.to =
+        _config.to > 0
+            ? _config.to
+            : static_cast<std::time_t>(range.getColumn("last").getInt64());
+    if (_report.from >= _report.to) {
+        throw std::runtime_error("Backtest: empty interval to replay");
+    }
+
+    // the monitors start at the beginning of the interval: the rates are
+    // warmed up with the snapshots saved before it
+    _clock = std::make_shared<VirtualClock>(
+        std::chrono::system_clock::from_time_t(_report.from));
+    tape_config_t tape = {};
+    tape.mode = tape_mode_t::off;
+    _monitors = std::make_shared<DataMonitor>(
+        db, period, correlation_window, retry, std::make_shared<Tape>(tape),
+        metrics, _clock);
+}
+
+// _quote moves the price of pair on the market to the latest rate
+void Backtest::_quote(const currency_pair_t& pair)
+{
+    try {
+        _market->quote(pair, _monitors->rates()->rate(pair));
+    }
+    catch (const std::out_of_range&) {
+        // not priced yet: no snapshot of its currencies replayed
+    }
+}
+
+// _value returns the value of balances in the configured currency, at the
+// latest rates
+double Backtest::_value(const std::map<std::string, double>& balances)
+{
+    double value = 0;
+    for (const auto& [currency, amount] : balances) {
+        if (amount == 0) {
+            continue;
+        }
+        try {
+            value += amount * _monitors->rates()->rate(currency,
+                                                       _config.currency);
+        }
+        catch (const std::out_of_range&) {
+            _logger->warn("Backtest: {} can't be valued in {}", currency,
+                          _config.currency);
+        }
+    }
+    return value;
+}
+
+// _execute sizes the order of message like the trader does and places it
+// on the simulated market, then gives feedback to the strategy
+void Backtest::_execute(const message_t& message)
+{
+    auto order = message.order;
+    ++_report.messages;
+    try {
+        if (order.action == at::order_action_t::buy) {
+            auto balance = _market->balance(order.pair.second);
+            auto ask = [&]() { return _market->ticker(order.pair).ask.price; };
+            auto trade_balance = buy_trade_balance(message, balance, ask);
+            if (order.type == at::order_type_t::market) {
+                order.price = ask();
+            }
+            order.volume = order.price > 0 ? trade_balance / order.price : 0;
+        }
+        else {
+            auto balance = _market->balance(order.pair.first);
+            order.volume = sell_trade_balance(message, balance, [&]() {
+                return _market->ticker(order.pair).bid.price;
+            });
+        }
+        if (order.volume > 0 && std::isfinite(order.volume)) {
+            _market->place(order);
+            ++_report.placed;
+        }
+        else {
+            order.txid = "";
+            ++_report.dropped;
+        }
+    }
+    catch (const at::response_error& e) {
+        // not enough funds or out of the volume limits
+        _logger->info("Backtest: {}: order dropped: {}", order.pair,
+                      e.what());
+        order.txid = "";
+        ++_report.dropped;
+    }
+
+    if (message.feedback != nullptr) {
+        feedback_t feedback;
+        feedback.market = _market;
+        feedback.order = order;
+        feedback.retrier = _retrier;
+        feedback.trace = message.trace;
+        message.feedback->put(feedback);
+    }
+}
+
+// _settle executes the orders of the strategies until they are all
+// sleeping: the clock can't move while a strategy is deciding, or is
+// waiting for the feedback of an order
+void Backtest::_settle()
+{
+    while (true) {
+        // a strategy waiting for a feedback is not sleeping: check the
+        // channel while waiting
+        auto idle = _clock->wait_idle(std::chrono::milliseconds(1));
+        auto executed = false;
+        message_t message;
+        while (_chan->get(message, false)) {
+            _execute(message);
+            executed = true;
+        }
+        if (idle && !executed) {
+            return;
+        }
+    }
+}
+
+backtest_report_t Backtest::run(
+    const std::map<currency_pair_t, std::vector<std::shared_ptr<Strategy>>>&
+        strategies)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // the prices follow the saved ones: no random walk, no latency, no
+    // errors
+    simulated_market_config_t market = {};
+    market.maker_fee = _config.maker_fee;
+    market.taker_fee = _config.taker_fee;
+    market.balances = _config.balances;
+    for (const auto& entry : strategies) {
+        simulated_pair_t simulated = {};
+        simulated.pair = entry.first;
+        simulated.spread = _config.spread;
+        simulated.depth = std::numeric_limits<double>::max();
+        simulated.limit.max = std::numeric_limits<double>::max();
+        market.pairs.push_back(simulated);
+        _pairs.insert(entry.first);
+    }
+    _market = std::make_shared<SimulatedMarket>(market);
+    for (const auto& pair : _pairs) {
+        _quote(pair);
+    }
+    _report.start_balances = _config.balances;
+    _report.start_value = _value(_config.balances);
+
+    // every buy and sell runs in its own thread, like in the trader, driven
+    // by the clock until it's stopped
+    std::vector<std::thread> threads;
+    auto drive = [&](std::function<void()> trade) {
+        _clock->attach();
+        threads.push_back(std::thread([this, trade]() {
+            try {
+                trade();
+            }
+            catch (const clock_stopped&) {
+                // the history is over
+            }
+            catch (const std::exception& e) {
+                _logger->error("Backtest: strategy stopped: {}", e.what());
+            }
+            _clock->detach();
+        }));
+    };
+    for (const auto& entry : strategies) {
+        auto pair = entry.first;
+        for (const auto& strategy : entry.second) {
+            drive([strategy, pair]() { strategy->buy(pair); });
+            drive([strategy, pair]() { strategy->sell(pair); });
+        }
+    }
+
+    // the snapshots are read once, in order, while the clock moves
+    SQLite::Statement snapshots(*_db, _snapshots_sql);
+    SQLite::bind(snapshots, static_cast<long long int>(_report.from),
+                 static_cast<long long int>(_report.to));
+    auto pending = snapshots.executeStep();
+    auto replay = [&](std::time_t until) {
+        while (pending &&
+               snapshots.getColumn("timestamp").getInt64() <= until) {
+            cm_ticker_t tick = {};
+            tick.symbol = snapshots.getColumn("currency").getString();
+            tick.price_usd = snapshots.getColumn("price_usd");
+            tick.price_btc = snapshots.getColumn("price_btc");
+            tick.day_volume_usd = snapshots.getColumn("day_volume_usd");
+            tick.market_cap_usd = snapshots.getColumn("market_cap_usd");
+            tick.percent_change_1h = static_cast<float>(
+                snapshots.getColumn("percent_change_1h").getDouble());
+            tick.percent_change_24h = static_cast<float>(
+                snapshots.getColumn("percent_change_24h").getDouble());
+            tick.percent_change_7d = static_cast<float>(
+                snapshots.getColumn("percent_change_7d").getDouble());
+            tick.last_updated = static_cast<std::time_t>(
+                snapshots.getColumn("timestamp").getInt64());
+            _monitors->ingest(tick);
+
+            auto symbol = tick.symbol;
+            at::tolower(symbol);
+            for (const auto& pair : _pairs) {
+                if (pair.first == symbol || pair.second == symbol) {
+                    _quote(pair);
+                }
+            }
+            ++_report.ticks;
+            pending = snapshots.executeStep();
+        }
+    };
+
+    // nothing happens between two deadlines of the strategies: jump from
+    // one to the next, replaying the snapshots saved in between
+    auto end = std::chrono::system_clock::from_time_t(_report.to);
+    while (true) {
+        _settle();
+        Clock::time_point next;
+        if (!_clock->next_deadline(next) || next > end) {
+            break;
+        }
+        replay(std::chrono::system_clock::to_time_t(next));
+        _clock->advance(next);
+        ++_report.steps;
+    }
+    replay(_report.to);
+    _clock->stop();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    _report.end_balances = _market->balance();
+    _report.fees = _market->fees();
+    _report.end_value = _value(_report.end_balances);
+    _report.hold_value = _value(_report.start_balances);
+    _report.elapsed = std::chrono::steady_clock::now() - start;
+
+    _logger->info(
+        "Backtest: replayed {} snapshots from {} to {} in {} steps, {}ms",
+        _report.ticks, _report.from, _report.to, _report.steps,
+        std::chrono::duration_cast<std::chrono::milliseconds>(_report.elapsed)
+            .count());
+    _logger->info(
+        "Backtest: {} messages, {} orders placed, {} dropped. Value: {} {} "
+        "-> {} {}, PnL: {} {}. Holding: {} {}",
+        _report.messages, _report.placed, _report.dropped, _report.start_value,
+        _config.currency, _report.end_value, _config.currency,
+        _report.end_value - _report.start_value, _config.currency,
+        _report.hold_value - _report.start_value, _config.currency);
+    for (const auto& [currency, fee] : _report.fees) {
+        _logger->info("Backtest: fees paid: {} {}", fee, currency);
+    }
+    return _report;
+}
+
+}  // end namespace atd
@@ -28,37 +28,31 @@ void BuyLowAndHodl::buy(const currency_pair_t& pair)
     while (true) {
         bool buy_opportunity = false;
         auto stats_period_ago = std::chrono::system_clock::to_time_t(
-            std::chrono::system_clock::now() - _stats_period);
+            _clock->now() - _stats_period);
         auto pair_history = _monitors->pairHistory(pair, stats_period_ago);
-        auto currency_history =
-            _monitors->currencyHistory(pair.first, stats_period_ago);
-
-        if (currency_history.size() <= 2) {
-            std::this_thread::sleep_for(_trade_period);
+        auto currency_series =
+            _monitors->currencySeries(pair.first, stats_period_ago);
+
+        // The snapshots are irregular (rate limits, monitor period): the
+        // prices are resampled every 20 minutes, hence there are 3
+        // measurements per hour and 72 measurements per day.
+        auto grid = resample(currency_series, 20min, interpolation_t::linear);
+        if (grid.size() <= 2) {
+            _clock->sleep_for(_trade_period);
             continue;
         }
-
-        std::vector<double> prices;
-        std::vector<double> changes_1h, changes_24h;
-        for (const auto& point : currency_history) {
-            prices.push_back(point.price_usd);
-            changes_1h.push_back(point.percent_change_1h);
-            changes_24h.push_back(point.percent_change_24h);
-        }
+        auto prices = grid.column("price_usd");
 
         double mean, stddev;
         std::tie(mean, stddev) = stats::mean_stdev(prices);
 
-        // I save the price every 20 minutes
-        // Hence I have 3 measurements per hour and 72 measurements
-        // per day.
-        auto kernel = stats::gaussian1d(71, std::sqrt(stddev));
-
-        auto conv = stats::conv(prices, kernel);
-        for (size_t i = 0; i < conv.size(); ++i) {
-            std::cout << "" << prices[i] << "," << conv[i] << "\n";
-        }
-        std::cout << "in: " << prices.size() << " o: " << conv.size() << "\n";
+        // A kernel of 71 samples spans a day. sigma follows the prices:
+        // the kernels are cached with sigma rounded, so that close values
+        // share a kernel
+        auto conv =
+            stats::GaussianSmoothing(71, std::sqrt(stddev)).smooth(prices);
+        _logger->debug("{} smoothed {} prices, {} points", pair,
+                       prices.size(), conv.size());
 
         /*
 
@@ -127,11 +121,9 @@ void BuyLowAndHodl::buy(const currency_pair_t& pair)
             order.volume = _balance_percentage;
 
             message.order = order;
-            _chan->put(message);
+            _send(message);
         }
-        std::cout << "before sleep" << std::endl;
-        std::this_thread::sleep_for(_trade_period);
-        std::cout << "\nafter sleep" << std::endl;
+        _clock->sleep_for(_trade_period);
     }
 }  // namespace atd
 
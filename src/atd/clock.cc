@@ -0,0 +1,118 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <atd/clock.hpp>
+#include <iterator>
+
+namespace atd {
+
+static thread_local StopSignal* _current_stop = nullptr;
+
+StopSignal* StopSignal::current() { return _current_stop; }
+
+void StopSignal::_set_current(StopSignal* stop) { _current_stop = stop; }
+
+void SystemClock::sleep_until(time_point deadline)
+{
+    auto stop = StopSignal::current();
+    if (stop == nullptr) {
+        std::this_thread::sleep_until(deadline);
+        return;
+    }
+    if (!stop->sleep_until(deadline)) {
+        throw clock_stopped("SystemClock: stopped");
+    }
+}
+
+Clock::time_point VirtualClock::now()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    return _now;
+}
+
+void VirtualClock::sleep_until(time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(_mux);
+    if (_stopped) {
+        throw clock_stopped("VirtualClock: stopped");
+    }
+    if (deadline <= _now) {
+        return;
+    }
+    _deadlines.insert(deadline);
+    ++_sleeping;
+    _idle.notify_all();
+    // advance removes the deadline and counts the sleeper as awake: the
+    // driver can't see the clock idle before this thread runs again
+    _wake.wait(lock, [&]() { return _stopped || _now >= deadline; });
+    if (_stopped) {
+        throw clock_stopped("VirtualClock: stopped");
+    }
+}
+
+void VirtualClock::attach()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    ++_participants;
+}
+
+void VirtualClock::detach()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    --_participants;
+    _idle.notify_all();
+}
+
+bool VirtualClock::wait_idle(std::chrono::nanoseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(_mux);
+    return _idle.wait_for(lock, timeout, [&]() {
+        return _stopped || _sleeping >= _participants;
+    });
+}
+
+bool VirtualClock::next_deadline(time_point& deadline)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    if (_deadlines.empty()) {
+        return false;
+    }
+    deadline = *_deadlines.begin();
+    return true;
+}
+
+void VirtualClock::advance(time_point time)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    if (time <= _now) {
+        return;
+    }
+    _now = time;
+    auto reached = _deadlines.upper_bound(time);
+    _sleeping -= std::distance(_deadlines.begin(), reached);
+    _deadlines.erase(_deadlines.begin(), reached);
+    _wake.notify_all();
+}
+
+void VirtualClock::stop()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    _stopped = true;
+    _sleeping = 0;
+    _deadlines.clear();
+    _wake.notify_all();
+    _idle.notify_all();
+}
+
+}  // end namespace atd
@@ -13,6 +13,8 @@
  * limitations under the License.*/
 
 #include <atd/config.hpp>
+#include <iomanip>
+#include <sstream>
 
 namespace atd {
 
@@ -61,10 +63,40 @@ quantity_t quantity_from_json(json obj)
     return ret;
 }
 
+simulated_market_config_t simulated_market_from_json(json obj)
+{
+    simulated_market_config_t ret = {};
+    ret.seed = obj.value("seed", std::uint64_t(0));
+    ret.latency = std::chrono::milliseconds(obj.value("latency_ms", 0));
+    ret.latency_jitter =
+        std::chrono::milliseconds(obj.value("latency_jitter_ms", 0));
+    ret.server_error_rate = obj.value("server_error_rate", 0.);
+    ret.response_error_rate = obj.value("response_error_rate", 0.);
+    ret.maker_fee = obj.value("maker_fee", 0.16);
+    ret.taker_fee = obj.value("taker_fee", 0.26);
+    ret.balances = obj.value("balances", std::map<std::string, double>());
+
+    for (const auto& pair : obj.at("pairs")) {
+        simulated_pair_t simulated = {};
+        simulated.pair =
+            currency_pair_t(pair.at("pair").at(0), pair.at("pair").at(1));
+        simulated.price = pair.at("price");
+        simulated.spread = pair.value("spread", 0.001);
+        simulated.volatility = pair.value("volatility", 0.001);
+        simulated.depth = pair.value("depth", 10.);
+        simulated.limit.min = pair.value("min_volume", 0.);
+        simulated.limit.max = pair.value("max_volume", 1e9);
+        ret.pairs.push_back(simulated);
+    }
+    return ret;
+}
+
 // markets returns a map of initialized markets from the configuration file
-std::map<std::string, std::shared_ptr<Market>> Config::markets()
+std::map<std::string, std::shared_ptr<Market>> Config::markets(
+    std::shared_ptr<Tape> tape)
 {
     std::map<std::string, std::shared_ptr<Market>> ret;
+    auto logger = component_logger("config");
     json markets = _config["markets"];
 
     for (json::iterator it = markets.begin(); it != markets.end(); ++it) {
@@ -74,7 +106,13 @@ std::map<std::string, std::shared_ptr<Market>> Config::markets()
                 ret.insert(std::pair(
                     "kraken", std::make_shared<Kraken>(value["apiKey"],
                                                        value["apiSecret"])));
-                std::cout << "Market [Kraken]: initialized\n";
+                logger->info("Market [Kraken]: initialized");
+            } break;
+            case _hash("simulated"): {
+                ret.insert(std::pair("simulated",
+                                     std::make_shared<SimulatedMarket>(
+                                         simulated_market_from_json(*it))));
+                logger->info("Market [Simulated]: initialized");
             } break;
             default:
                 std::stringstream ss;
@@ -83,6 +121,12 @@ std::map<std::string, std::shared_ptr<Market>> Config::markets()
         }
     }
 
+    if (tape->mode() != tape_mode_t::off) {
+        for (auto& [name, market] : ret) {
+            market = std::make_shared<TapedMarket>(name, market, tape);
+        }
+    }
+
     return ret;
 }
 
@@ -116,7 +160,7 @@ std::map<std::string, std::shared_ptr<Exchange>> Config::exchanges()
     if (ret.find("shapeshift") == ret.end()) {
         ret.insert(std::pair("shapeshift", std::make_shared<Shapeshift>()));
     }
-    std::cout << "Exchange [ShapeShift]: initialized\n";
+    component_logger("config")->info("Exchange [ShapeShift]: initialized");
     return ret;
 }
 
@@ -125,6 +169,209 @@ std::chrono::seconds Config::monitorPeriod()
     return std::chrono::seconds(_config["monitor"]["period"]);
 }
 
+std::size_t Config::correlationWindow()
+{
+    return _config["monitor"].value("correlation_window", std::size_t(72));
+}
+
+retry_policy_t Config::retryPolicy()
+{
+    retry_policy_t ret = {};
+    ret.initial_delay = std::chrono::milliseconds(500);
+    ret.max_delay = std::chrono::minutes(1);
+    ret.multiplier = 2;
+    ret.jitter = 0.2;
+    ret.max_attempts = 5;
+    ret.failure_threshold = 5;
+    ret.open_timeout = std::chrono::minutes(1);
+
+    auto retry = _config.find("retry");
+    if (retry == _config.end()) {
+        return ret;
+    }
+    ret.initial_delay = std::chrono::milliseconds(
+        retry->value("initial_delay_ms", ret.initial_delay.count()));
+    ret.max_delay = std::chrono::milliseconds(
+        retry->value("max_delay_ms", ret.max_delay.count()));
+    ret.multiplier = retry->value("multiplier", ret.multiplier);
+    ret.jitter = retry->value("jitter", ret.jitter);
+    ret.max_attempts = retry->value("max_attempts", ret.max_attempts);
+    ret.failure_threshold =
+        retry->value("failure_threshold", ret.failure_threshold);
+    ret.open_timeout = std::chrono::seconds(
+        retry->value("open_timeout", ret.open_timeout.count()));
+    return ret;
+}
+
+trader_config_t Config::trader()
+{
+    trader_config_t ret = {};
+    ret.retry = retryPolicy();
+    ret.info_ttl = std::chrono::hours(1);
+    ret.ledger_reconcile_period = std::chrono::minutes(5);
+    ret.ticker_freshness = std::chrono::milliseconds(500);
+    ret.netting_window = std::chrono::milliseconds(0);
+    ret.max_in_flight = 8;
+    ret.latency_report_period = std::chrono::minutes(1);
+
+    auto trader = _config.find("trader");
+    if (trader == _config.end()) {
+        return ret;
+    }
+    ret.info_ttl =
+        std::chrono::seconds(trader->value("info_ttl", ret.info_ttl.count()));
+    ret.ledger_reconcile_period = std::chrono::seconds(trader->value(
+        "ledger_reconcile_period", ret.ledger_reconcile_period.count()));
+    ret.ticker_freshness = std::chrono::milliseconds(trader->value(
+        "ticker_freshness_ms", ret.ticker_freshness.count()));
+    ret.netting_window = std::chrono::milliseconds(
+        trader->value("netting_window_ms", ret.netting_window.count()));
+    ret.max_in_flight = trader->value("max_in_flight", ret.max_in_flight);
+    if (ret.max_in_flight == 0) {
+        ret.max_in_flight = 1;
+    }
+    ret.latency_report_period = std::chrono::seconds(trader->value(
+        "latency_report_period", ret.latency_report_period.count()));
+    return ret;
+}
+
+tape_config_t Config::tape()
+{
+    tape_config_t ret = {};
+    ret.mode = tape_mode_t::off;
+    ret.original_pacing = true;
+
+    auto tape = _config.find("tape");
+    if (tape == _config.end()) {
+        return ret;
+    }
+    std::string mode = tape->value("mode", "off");
+    if (mode == "record") {
+        ret.mode = tape_mode_t::record;
+    }
+    else if (mode == "replay") {
+        ret.mode = tape_mode_t::replay;
+    }
+    else if (mode != "off") {
+        throw std::runtime_error("tape: " + mode + " is not a valid mode");
+    }
+    ret.path = tape->value("path", "tape.bin");
+    ret.original_pacing = tape->value("pacing", "original") == "original";
+    return ret;
+}
+
+// _unix_time parses a UTC date, "YYYY-MM-DD HH:MM" or "YYYY-MM-DD"
+static std::time_t _unix_time(const std::string& date)
+{
+    for (auto format : {"%Y-%m-%d %H:%M", "%Y-%m-%d"}) {
+        std::tm tm = {};
+        std::istringstream ss(date);
+        ss >> std::get_time(&tm, format);
+        if (!ss.fail()) {
+            return timegm(&tm);
+        }
+    }
+    throw std::runtime_error(date + " is not a valid date");
+}
+
+backtest_config_t Config::backtest()
+{
+    backtest_config_t ret = {};
+    ret.currency = "usd";
+    ret.balances = {{"usd", 1000}};
+    ret.maker_fee = 0.16;
+    ret.taker_fee = 0.26;
+    ret.spread = 0.001;
+
+    auto backtest = _config.find("backtest");
+    if (backtest == _config.end()) {
+        return ret;
+    }
+    if (backtest->find("from") != backtest->end()) {
+        ret.from = _unix_time(backtest->at("from"));
+    }
+    if (backtest->find("to") != backtest->end()) {
+        ret.to = _unix_time(backtest->at("to"));
+    }
+    ret.currency = backtest->value("currency", ret.currency);
+    auto balances = backtest->find("balances");
+    if (balances != backtest->end()) {
+        ret.balances = balances->get<std::map<std::string, double>>();
+    }
+    ret.maker_fee = backtest->value("maker_fee", ret.maker_fee);
+    ret.taker_fee = backtest->value("taker_fee", ret.taker_fee);
+    ret.spread = backtest->value("spread", ret.spread);
+    return ret;
+}
+
+// _level parses the name of a spdlog level, throwing on unknown names
+static spdlog::level::level_enum _level(const std::string& name)
+{
+    auto level = spdlog::level::from_str(name);
+    if (level == spdlog::level::off && name != "off") {
+        throw std::runtime_error(name + " is not a valid log level");
+    }
+    return level;
+}
+
+logging_config_t Config::logging()
+{
+    logging_config_t ret = {};
+    ret.queue_size = 8192;
+    ret.level = spdlog::level::info;
+
+    auto logging = _config.find("logging");
+    if (logging == _config.end()) {
+        return ret;
+    }
+    ret.queue_size = logging->value("queue_size", ret.queue_size);
+    if (logging->find("level") != logging->end()) {
+        ret.level = _level(logging->at("level"));
+    }
+    auto levels = logging->find("levels");
+    if (levels != logging->end()) {
+        for (const auto& [component, level] : levels->items()) {
+            ret.levels[component] = _level(level);
+        }
+    }
+    ret.structured = logging->value("structured", ret.structured);
+    return ret;
+}
+
+supervisor_config_t Config::supervisor()
+{
+    supervisor_config_t ret = {};
+    ret.stall_timeout = std::chrono::seconds(120);
+    ret.check_period = std::chrono::seconds(5);
+
+    auto supervisor = _config.find("supervisor");
+    if (supervisor == _config.end()) {
+        return ret;
+    }
+    ret.stall_timeout = std::chrono::seconds(
+        supervisor->value("stall_timeout", ret.stall_timeout.count()));
+    ret.check_period = std::chrono::seconds(
+        supervisor->value("check_period", ret.check_period.count()));
+    return ret;
+}
+
+metrics_config_t Config::metrics()
+{
+    metrics_config_t ret = {};
+    ret.enabled = false;
+    ret.address = "127.0.0.1";
+    ret.port = 9100;
+
+    auto metrics = _config.find("metrics");
+    if (metrics == _config.end()) {
+        return ret;
+    }
+    ret.enabled = true;
+    ret.address = metrics->value("address", ret.address);
+    ret.port = metrics->value("port", ret.port);
+    return ret;
+}
+
 std::vector<currency_pair_t> Config::monitorPairs()
 {
     std::vector<currency_pair_t> pairs;
@@ -144,6 +391,7 @@ Config::strategies(std::shared_ptr<DataMonitor> monitors,
                    std::shared_ptr<channel<atd::message_t>> chan)
 {
     std::map<currency_pair_t, std::vector<std::shared_ptr<Strategy>>> ret;
+    auto logger = component_logger("config");
 
     json strategies = _config["strategies"];
     for (json::iterator it = strategies.begin(); it != strategies.end(); ++it) {
@@ -162,7 +410,7 @@ Config::strategies(std::shared_ptr<DataMonitor> monitors,
                     case _hash("HODL"): {
                         ret[pair].push_back(
                             std::make_shared<Hodl>(monitors, chan));
-                        std::cout << pair << ": strategy HODL\n";
+                        logger->info("{}: strategy HODL", pair);
                         break;
                     }
                     case _hash("BUYLOWANDHODL"): {
@@ -177,7 +425,7 @@ Config::strategies(std::shared_ptr<DataMonitor> monitors,
                         ret[pair].push_back(std::make_shared<BuyLowAndHodl>(
                             monitors, chan, low, balance_percentage,
                             trade_period, stats_period));
-                        std::cout << pair << ": strategy BuyLowAndHodl\n";
+                        logger->info("{}: strategy BuyLowAndHodl", pair);
                         break;
                     }
                     case _hash("DOLLARCOSTAVERAGING"): {
@@ -189,7 +437,7 @@ Config::strategies(std::shared_ptr<DataMonitor> monitors,
                         ret[pair].push_back(
                             std::make_shared<DollarCostAveraging>(
                                 monitors, chan, date, buy_quantity));
-                        std::cout << pair << ": strategy DollarCostAveraging\n";
+                        logger->info("{}: strategy DollarCostAveraging", pair);
                         break;
                     }
                     case _hash("SMALLCHANGES"): {
@@ -201,7 +449,7 @@ Config::strategies(std::shared_ptr<DataMonitor> monitors,
 
                         ret[pair].push_back(std::make_shared<SmallChanges>(
                             monitors, chan, buy_quantity, sell_quantity));
-                        std::cout << pair << ": strategy SmallChanges\n";
+                        logger->info("{}: strategy SmallChanges", pair);
                         break;
                     }
                         /*
@@ -0,0 +1,160 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <at/namespace.hpp>
+#include <atd/correlations.hpp>
+#include <atd/resample.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace atd {
+
+// _return is the log return from price "from" to price "to", 0 when one of
+// the two is unknown
+static double _return(double from, double to)
+{
+    return from > 0 && to > 0 ? std::log(to / from) : 0;
+}
+
+CorrelationEngine::CorrelationEngine(std::size_t window)
+    : _window(window),
+      _snapshot(std::make_shared<const correlations_t>(correlations_t{}))
+{
+}
+
+void CorrelationEngine::_publish(std::time_t time)
+{
+    auto snapshot = std::make_shared<correlations_t>();
+    snapshot->currencies = _currencies;
+    snapshot->samples = _matrix->count();
+    snapshot->time = time;
+    snapshot->matrix = _matrix->matrix();
+    std::atomic_store(&_snapshot,
+                      std::shared_ptr<const correlations_t>(snapshot));
+}
+
+void CorrelationEngine::start(const std::vector<std::string>& currencies,
+                              const std::vector<TimeSeries>& histories,
+                              std::chrono::seconds step)
+{
+    if (histories.size() != currencies.size()) {
+        throw std::invalid_argument(
+            "CorrelationEngine: a history per currency is required");
+    }
+    std::lock_guard<std::mutex> lock(_mux);
+    auto n = currencies.size();
+    _currencies = currencies;
+    for (auto& currency : _currencies) {
+        at::tolower(currency);
+    }
+    _matrix = std::make_unique<stats::CorrelationMatrix>(n, _window);
+    _last.assign(n, 0);
+    _returns.assign(n, 0);
+
+    // the prices on the grid common to every currency. The currencies of a
+    // round are fetched one after the other: linear interpolation keeps
+    // them aligned when a grid time falls between two of them
+    std::vector<TimeSeries> grids;
+    auto first = std::numeric_limits<std::time_t>::min();
+    auto last = std::numeric_limits<std::time_t>::max();
+    for (const auto& history : histories) {
+        grids.push_back(resample(history, step, interpolation_t::linear));
+        const auto& grid = grids.back();
+        if (grid.empty()) {
+            first = 1;
+            last = 0;
+            continue;
+        }
+        first = std::max(first, grid.time().front());
+        last = std::min(last, grid.time().back());
+    }
+    if (n == 0 || first >= last) {
+        _publish(0);
+        return;
+    }
+
+    std::vector<std::vector<double>> returns(n);
+    std::vector<column_view<double>> columns;
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto& grid = grids[i];
+        auto from = grid.since(first);
+        auto prices =
+            grid.column("price_usd").window(from, grid.since(last) - from + 1);
+        for (std::size_t r = 1; r < prices.size(); ++r) {
+            returns[i].push_back(_return(prices[r - 1], prices[r]));
+        }
+        _last[i] = prices.back();
+        columns.push_back(returns[i]);
+    }
+    _matrix->build(columns);
+    _publish(last);
+}
+
+void CorrelationEngine::push(std::time_t time,
+                             const std::vector<double>& prices)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    if (_matrix == nullptr) {
+        return;
+    }
+    if (prices.size() != _currencies.size()) {
+        throw std::invalid_argument("CorrelationEngine: " +
+                                    std::to_string(prices.size()) +
+                                    " prices for " +
+                                    std::to_string(_currencies.size()) +
+                                    " currencies");
+    }
+    // the returns are known once every currency has a previous price
+    bool primed = std::all_of(_last.begin(), _last.end(),
+                              [](double price) { return price > 0; });
+    for (std::size_t i = 0; i < prices.size(); ++i) {
+        auto price = prices[i] > 0 ? prices[i] : _last[i];
+        _returns[i] = _return(_last[i], price);
+        _last[i] = price;
+    }
+    if (!primed) {
+        return;
+    }
+    _matrix->push(_returns);
+    _publish(time);
+}
+
+std::shared_ptr<const correlations_t> CorrelationEngine::snapshot() const
+{
+    return std::atomic_load(&_snapshot);
+}
+
+double CorrelationEngine::correlation(std::string a, std::string b) const
+{
+    auto current = snapshot();
+    at::tolower(a);
+    at::tolower(b);
+    const auto& currencies = current->currencies;
+    auto i = std::find(currencies.begin(), currencies.end(), a);
+    if (i == currencies.end()) {
+        throw std::out_of_range("CorrelationEngine: " + a + " not monitored");
+    }
+    auto j = std::find(currencies.begin(), currencies.end(), b);
+    if (j == currencies.end()) {
+        throw std::out_of_range("CorrelationEngine: " + b + " not monitored");
+    }
+    return current->matrix[(i - currencies.begin()) * currencies.size() +
+                           (j - currencies.begin())];
+}
+
+}  // end namespace atd
@@ -16,9 +16,54 @@
 
 namespace atd {
 
+// fields of monitored_currencies that can be followed by the indicators
+static const std::set<std::string> _indicator_fields = {
+    "price_usd", "price_btc", "percent_change_1h", "percent_change_24h",
+    "percent_change_7d"};
+
+static std::string _series(std::string currency, const std::string& field)
+{
+    at::tolower(currency);
+    return currency + "/" + field;
+}
+
+static const std::string _pair_history_sql =
+    "SELECT market,day_volume_usd,"
+    "price_usd,percent_volume, strftime('%s', time) as timestamp "
+    "FROM monitored_pairs "
+    "WHERE base = ? AND quote = ? AND time >= datetime(?, 'unixepoch') "
+    "AND time <= datetime(?, 'unixepoch') "
+    "ORDER BY timestamp ASC";
+
+static const std::string _currency_history_sql =
+    "SELECT strftime('%s', time) as timestamp,price_btc,price_usd,"
+    "day_volume_usd,market_cap_usd,percent_change_1h,"
+    "percent_change_24h,percent_change_7d "
+    "FROM monitored_currencies "
+    "WHERE lower(currency) = lower(?) AND time >= datetime(?, 'unixepoch') "
+    "AND time <= datetime(?, 'unixepoch') "
+    "ORDER BY timestamp ASC";
+
+static const std::string _currency_samples_sql =
+    "SELECT count(*) FROM monitored_currencies "
+    "WHERE lower(currency) = lower(?) AND time >= datetime(?, 'unixepoch') "
+    "AND time <= datetime(?, 'unixepoch')";
+
 DataMonitor::DataMonitor(SQLite::Database* db,
-                         const std::chrono::seconds& period)
-    : _db(db), _period(period)
+                         const std::chrono::seconds& period,
+                         std::size_t correlation_window,
+                         const retry_policy_t& retry,
+                         std::shared_ptr<Tape> tape,
+                         std::shared_ptr<Metrics> metrics,
+                         std::shared_ptr<Clock> clock)
+    : _db(db),
+      _period(period),
+      _clock(clock),
+      _metrics(metrics),
+      _retrier(std::make_shared<Retrier>("coinmarketcap", retry, metrics)),
+      _tape(tape),
+      _statements(db),
+      _correlations(std::make_shared<CorrelationEngine>(correlation_window))
 {
     _db->exec(
         "CREATE TABLE IF NOT EXISTS monitored_pairs("
@@ -40,12 +85,120 @@ DataMonitor::DataMonitor(SQLite::Database* db,
         "percent_change_1h real,"
         "percent_change_24h real,"
         "percent_change_7d real)");
+    // the history queries and the backtests select the rows by time
+    _db->exec(
+        "CREATE INDEX IF NOT EXISTS monitored_currencies_time "
+        "ON monitored_currencies(time)");
 
     _cmc = new CoinMarketCap();
+
+    _metrics->gauge("atd_monitor_period_seconds",
+                    "Configured period of the monitor rounds")
+        ->set(_period.count());
+    _pair_history_latency = _metrics->histogram(
+        "atd_sqlite_query_duration_seconds", "Duration of the history queries",
+        {{"query", "pair_history"}});
+    _currency_history_latency = _metrics->histogram(
+        "atd_sqlite_query_duration_seconds", "Duration of the history queries",
+        {{"query", "currency_history"}});
+
+    // Warm up the rates with the last snapshot of every currency, so that
+    // strategies can convert prices before the first ingest round completes
+    _rates = std::make_shared<RateGraph>(_clock);
+    SQLite::Statement last(
+        *_db,
+        "SELECT currency, price_usd, price_btc, day_volume_usd, "
+        "strftime('%s', max(time)) as timestamp "
+        "FROM monitored_currencies WHERE time <= datetime(?, 'unixepoch') "
+        "GROUP BY lower(currency)");
+    SQLite::bind(last, static_cast<long long int>(_clock->time()));
+    while (last.executeStep()) {
+        std::string currency = last.getColumn("currency");
+        long long volume = last.getColumn("day_volume_usd");
+        auto time =
+            static_cast<std::time_t>(last.getColumn("timestamp").getInt64());
+        _rates->update(currency, "usd", last.getColumn("price_usd"), volume,
+                       time, "coinmarketcap");
+        _rates->update(currency, "btc", last.getColumn("price_btc"), volume,
+                       time, "coinmarketcap");
+    }
+
+    _indicators = std::make_shared<IndicatorEngine>();
+    auto indicators = _indicators;
+    _metrics->gauge("atd_indicators",
+                    "Distinct indicators computed for the strategies", {},
+                    [indicators]() { return indicators->size(); });
+}
+
+void DataMonitor::ingest(const cm_ticker_t& tick)
+{
+    _rates->update(tick.symbol, "usd", tick.price_usd, tick.day_volume_usd,
+                   tick.last_updated, "coinmarketcap");
+    _rates->update(tick.symbol, "btc", tick.price_btc, tick.day_volume_usd,
+                   tick.last_updated, "coinmarketcap");
+    _push(tick);
+}
+
+void DataMonitor::_push(const cm_ticker_t& tick)
+{
+    auto time = tick.last_updated;
+    _indicators->push(_series(tick.symbol, "price_usd"), time, tick.price_usd);
+    _indicators->push(_series(tick.symbol, "price_btc"), time, tick.price_btc);
+    _indicators->push(_series(tick.symbol, "percent_change_1h"), time,
+                      tick.percent_change_1h);
+    _indicators->push(_series(tick.symbol, "percent_change_24h"), time,
+                      tick.percent_change_24h);
+    _indicators->push(_series(tick.symbol, "percent_change_7d"), time,
+                      tick.percent_change_7d);
+}
+
+std::shared_ptr<Indicator> DataMonitor::indicator(std::string currency,
+                                                  const std::string& field,
+                                                  const indicator_spec_t& spec)
+{
+    if (_indicator_fields.find(field) == _indicator_fields.end()) {
+        throw std::invalid_argument("indicator: unknown field " + field);
+    }
+    at::tolower(currency);
+    // the last n rows of the currency, newest first, or the rows of the
+    // span: the rows older than the span would be dropped by the first push
+    auto sql = "SELECT strftime('%s', time) as timestamp, " + field +
+               " as value FROM monitored_currencies "
+               "WHERE lower(currency) = ? AND time >= datetime(?, 'unixepoch') "
+               "AND time <= datetime(?, 'unixepoch') "
+               "ORDER BY time DESC LIMIT ?";
+    return _indicators->subscribe(
+        _series(currency, field), spec, [&](std::size_t n, std::time_t span) {
+            auto now = _clock->time();
+            auto query = _statements.acquire(sql);
+            // a negative limit is no limit
+            SQLite::bind(*query, currency,
+                         static_cast<long long int>(span != 0 ? now - span : 0),
+                         static_cast<long long int>(now),
+                         n != 0 ? static_cast<long long int>(n) : -1LL);
+            std::vector<std::pair<std::time_t, double>> ret;
+            while (query->executeStep()) {
+                ret.emplace_back(static_cast<std::time_t>(
+                                     query->getColumn("timestamp").getInt64()),
+                                 query->getColumn("value").getDouble());
+            }
+            return ret;
+        });
+}
+
+std::size_t DataMonitor::samples(const std::string& currency,
+                                 const std::time_t& after)
+{
+    auto query = _statements.acquire(_currency_samples_sql);
+    SQLite::bind(*query, currency, static_cast<long long int>(after),
+                 static_cast<long long int>(_clock->time()));
+    query->executeStep();
+    return static_cast<std::size_t>(query->getColumn(0).getInt64());
 }
 
 // begin currencies monitor function
-void DataMonitor::currencies(const std::vector<std::string>& currencies)
+void DataMonitor::currencies(const std::vector<std::string>& currencies,
+                             std::shared_ptr<Heartbeat> heartbeat)
 {
     SQLite::Statement query(
         *_db,
@@ -55,10 +208,43 @@ void DataMonitor::currencies(const std::vector<std::string>& currencies)
         "percent_change_24h,percent_change_7d) VALUES ("
         "?, datetime(?, 'unixepoch'), ?, ?, ?, ?, ?, ?, ?)");
 
+    labels_t labels = {{"monitor", "currencies"}};
+    auto rows = _metrics->counter("atd_monitor_rows_total",
+                                  "Rows ingested by the monitors", labels);
+    auto write_latency = _metrics->histogram(
+        "atd_sqlite_write_duration_seconds",
+        "Duration of the inserts (and their commit) of the monitors", labels);
+    auto round_duration = _metrics->gauge(
+        "atd_monitor_round_duration_seconds",
+        "Duration of the last monitor round, to compare with the period",
+        labels);
+    auto lag = _metrics->gauge(
+        "atd_monitor_ingest_lag_seconds",
+        "Age of the last ingested data, when ingested", labels);
+
+    // twice the rounds of the window: a round lasts more than the period
+    auto after =
+        _clock->time() -
+        2 * static_cast<std::time_t>(_correlations->window() + 1) *
+            _period.count();
+    std::vector<TimeSeries> histories;
+    for (const auto& currency : currencies) {
+        histories.push_back(currencySeries(currency, after));
+    }
+    _correlations->start(currencies, histories, _period);
+    std::vector<double> round_prices(currencies.size());
+
     while (true) {
+        auto round_start = std::chrono::steady_clock::now();
         auto i = 0;
+        std::size_t index = 0;
+        std::fill(round_prices.begin(), round_prices.end(), 0);
         for (const auto& currency : currencies) {
-            auto tick = _cmc->ticker(currency);
+            heartbeat->beat();
+            auto tick = _retrier->call("ticker", [&]() {
+                return _tape->call("coinmarketcap/ticker/" + currency,
+                                   [&]() { return _cmc->ticker(currency); });
+            });
             SQLite::bind(query,
                          tick.symbol,  // currency
                          static_cast<long long int>(
@@ -68,25 +254,40 @@ void DataMonitor::currencies(const std::vector<std::string>& currencies)
                          tick.price_btc, tick.price_usd, tick.day_volume_usd,
                          tick.market_cap_usd, tick.percent_change_1h,
                          tick.percent_change_24h, tick.percent_change_7d);
+            auto write_start = std::chrono::steady_clock::now();
             query.exec();
+            write_latency->record(std::chrono::steady_clock::now() -
+                                  write_start);
+            rows->inc();
+            lag->set(_clock->time() - tick.last_updated);
             // Reset prepared statement, so it's ready to be
             // re-executed
             query.reset();
 
+            ingest(tick);
+            round_prices[index++] = tick.price_usd;
+
             i++;
             // required because of cmc api limits
             if ((i % 10) == 0) {
                 i = 0;
-                std::this_thread::sleep_for(std::chrono::minutes(1));
+                heartbeat->idle(std::chrono::minutes(1));
+                _tape->sleep_for(std::chrono::minutes(1));
             }
         }
-        std::this_thread::sleep_for(_period);
+        _correlations->push(_clock->time(), round_prices);
+        round_duration->set(std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - round_start)
+                                .count());
+        heartbeat->idle(_period);
+        _tape->sleep_for(_period);
     }
 }
 // end currencies monitor function
 
 // begin pairs monitor function
-void DataMonitor::pairs(const std::vector<currency_pair_t>& pairs)
+void DataMonitor::pairs(const std::vector<currency_pair_t>& pairs,
+                        std::shared_ptr<Heartbeat> heartbeat)
 {
     std::map<std::string, std::set<std::string>> aggregator;
     for (const auto& pair : pairs) {
@@ -99,24 +300,64 @@ void DataMonitor::pairs(const std::vector<currency_pair_t>& pairs)
                             "price_usd,percent_volume)"
                             "VALUES (?, ?, ?, ?, ?, ?)");
 
+    labels_t labels = {{"monitor", "pairs"}};
+    auto rows = _metrics->counter("atd_monitor_rows_total",
+                                  "Rows ingested by the monitors", labels);
+    auto write_latency = _metrics->histogram(
+        "atd_sqlite_write_duration_seconds",
+        "Duration of the inserts (and their commit) of the monitors", labels);
+    auto round_duration = _metrics->gauge(
+        "atd_monitor_round_duration_seconds",
+        "Duration of the last monitor round, to compare with the period",
+        labels);
+    auto lag = _metrics->gauge(
+        "atd_monitor_ingest_lag_seconds",
+        "Age of the last ingested data, when ingested", labels);
+
     while (true) {
+        auto round_start = std::chrono::steady_clock::now();
         for (const auto& [base, quotes] : aggregator) {
-            auto markets = _cmc->markets(base);
+            heartbeat->beat();
+            auto markets = _retrier->call("markets", [&]() {
+                return _tape->call("coinmarketcap/markets/" + base,
+                                   [&]() { return _cmc->markets(base); });
+            });
+            // the usd price of base, from the market with the highest volume
+            const cm_market_t* best = nullptr;
             for (const auto& market : markets) {
+                if (best == nullptr ||
+                    market.day_volume_usd > best->day_volume_usd) {
+                    best = &market;
+                }
                 if (quotes.find(market.pair.second) != quotes.end()) {
                     SQLite::bind(query, market.name, market.pair.first,
                                  market.pair.second, market.day_volume_usd,
                                  market.price_usd, market.percent_volume);
+                    auto write_start = std::chrono::steady_clock::now();
                     query.exec();
+                    write_latency->record(std::chrono::steady_clock::now() -
+                                          write_start);
+                    rows->inc();
                     // Reset prepared statement, so it's ready to be
                     // re-executed
                     query.reset();
                 }
             }
+            if (best != nullptr) {
+                _rates->update(base, "usd", best->price_usd,
+                               best->day_volume_usd, best->last_updated,
+                               best->name);
+                lag->set(_clock->time() - best->last_updated);
+            }
             // required because of cmc "api" limits
-            std::this_thread::sleep_for(std::chrono::seconds(10));
+            heartbeat->idle(std::chrono::seconds(10));
+            _tape->sleep_for(std::chrono::seconds(10));
         }
-        std::this_thread::sleep_for(_period);
+        round_duration->set(std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - round_start)
+                                .count());
+        heartbeat->idle(_period);
+        _tape->sleep_for(_period);
     }
 }
 // end pairs monitor function
@@ -125,28 +366,25 @@ void DataMonitor::pairs(const std::vector<currency_pair_t>& pairs)
 std::vector<cm_market_t> DataMonitor::pairHistory(const currency_pair_t& pair,
                                                   const std::time_t& after)
 {
-    SQLite::Statement query(
-        *_db,
-        "SELECT market,day_volume_usd,"
-        "price_usd,percent_volume, strftime('%s', time) as timestamp "
-        "FROM monitored_pairs "
-        "WHERE base = ? AND quote = ? AND time >= datetime(?, 'unixepoch') "
-        "ORDER BY timestamp ASC");
-    SQLite::bind(query, pair.first, pair.second,
-                 static_cast<long long int>(after));
+    auto start = std::chrono::steady_clock::now();
+    auto query = _statements.acquire(_pair_history_sql);
+    SQLite::bind(*query, pair.first, pair.second,
+                 static_cast<long long int>(after),
+                 static_cast<long long int>(_clock->time()));
     std::vector<cm_market_t> ret;
-    while (query.executeStep()) {
+    while (query->executeStep()) {
         ret.push_back(cm_market_t{
-            .name = query.getColumn("market"),
+            .name = query->getColumn("market"),
             .pair = pair,
-            .day_volume_usd = query.getColumn("day_volume_usd"),
-            .price_usd = query.getColumn("price_usd"),
+            .day_volume_usd = query->getColumn("day_volume_usd"),
+            .price_usd = query->getColumn("price_usd"),
             .percent_volume = static_cast<float>(
-                query.getColumn("percent_volume").getDouble()),
+                query->getColumn("percent_volume").getDouble()),
             .last_updated = static_cast<std::time_t>(
-                query.getColumn("timestamp").getInt64()),
+                query->getColumn("timestamp").getInt64()),
         });
     }
+    _pair_history_latency->record(std::chrono::steady_clock::now() - start);
     return ret;
 }
 
@@ -163,38 +401,35 @@ std::vector<cm_market_t> DataMonitor::pairHistory(const currency_pair_t& pair)
 std::vector<cm_ticker_t> DataMonitor::currencyHistory(
     const std::string& currency, const std::time_t& after)
 {
-    SQLite::Statement query(
-        *_db,
-        "SELECT strftime('%s', time) as timestamp,price_btc,price_usd,"
-        "day_volume_usd,market_cap_usd,percent_change_1h,"
-        "percent_change_24h,percent_change_7d "
-        "FROM monitored_currencies "
-        "WHERE lower(currency) = lower(?) AND time >= datetime(?, 'unixepoch') "
-        "ORDER BY timestamp ASC");
-    SQLite::bind(query, currency, static_cast<long long int>(after));
+    auto start = std::chrono::steady_clock::now();
+    auto query = _statements.acquire(_currency_history_sql);
+    SQLite::bind(*query, currency, static_cast<long long int>(after),
+                 static_cast<long long int>(_clock->time()));
     std::vector<cm_ticker_t> ret;
-    while (query.executeStep()) {
+    while (query->executeStep()) {
         ret.push_back(cm_ticker_t{
             .id = "",
             .name = "",
             .symbol = currency,
             .rank = 0,
-            .price_usd = query.getColumn("price_usd"),
-            .price_btc = query.getColumn("price_btc"),
-            .day_volume_usd = query.getColumn("day_volume_usd"),
-            .market_cap_usd = query.getColumn("market_cap_usd"),
+            .price_usd = query->getColumn("price_usd"),
+            .price_btc = query->getColumn("price_btc"),
+            .day_volume_usd = query->getColumn("day_volume_usd"),
+            .market_cap_usd = query->getColumn("market_cap_usd"),
             .available_supply = 0,
             .total_supply = 0,
             .percent_change_1h = static_cast<float>(
-                query.getColumn("percent_change_1h").getDouble()),
+                query->getColumn("percent_change_1h").getDouble()),
             .percent_change_24h = static_cast<float>(
-                query.getColumn("percent_change_24h").getDouble()),
+                query->getColumn("percent_change_24h").getDouble()),
             .percent_change_7d = static_cast<float>(
-                query.getColumn("percent_change_7d").getDouble()),
+                query->getColumn("percent_change_7d").getDouble()),
             .last_updated = static_cast<std::time_t>(
-                query.getColumn("timestamp").getInt64()),
+                query->getColumn("timestamp").getInt64()),
         });
     }
+    _currency_history_latency->record(std::chrono::steady_clock::now() -
+                                      start);
     return ret;
 }
 
@@ -206,4 +441,30 @@ std::vector<cm_ticker_t> DataMonitor::currencyHistory(
     return currencyHistory(currency, 0);
 }
 
+TimeSeries DataMonitor::currencySeries(const std::string& currency,
+                                       const std::time_t& after)
+{
+    static const std::vector<std::string> columns = {
+        "price_btc",         "price_usd",          "day_volume_usd",
+        "market_cap_usd",    "percent_change_1h",  "percent_change_24h",
+        "percent_change_7d"};
+    auto start = std::chrono::steady_clock::now();
+    auto query = _statements.acquire(_currency_history_sql);
+    SQLite::bind(*query, currency, static_cast<long long int>(after),
+                 static_cast<long long int>(_clock->time()));
+    TimeSeries ret(columns);
+    std::vector<double> row(columns.size());
+    while (query->executeStep()) {
+        for (std::size_t i = 0; i < columns.size(); ++i) {
+            row[i] = query->getColumn(columns[i].c_str()).getDouble();
+        }
+        ret.append(static_cast<std::time_t>(
+                       query->getColumn("timestamp").getInt64()),
+                   row);
+    }
+    _currency_history_latency->record(std::chrono::steady_clock::now() -
+                                      start);
+    return ret;
+}
+
 }  // namespace atd
@@ -18,45 +18,33 @@ namespace atd {
 
 std::time_t DollarCostAveraging::_next_date()
 {
-    auto now = std::time(nullptr);
+    auto now = _clock->time();
     auto now_tm = std::gmtime(&now);
     std::tm ret = _date;
+    // _date holds only the (day,) hour and minutes: the year and the month
+    // are the current ones
     ret.tm_year = now_tm->tm_year;
+    ret.tm_mon = now_tm->tm_mon;
 
     if (_monthly) {
         // if i've not reached the day of the month (and hour and minutes)
-        // current month is the mont of the next date
-        if (now_tm->tm_mday < _date.tm_mday) {
-            ret.tm_mon = now_tm->tm_mon;
-        }
-        else if (now_tm->tm_mday == _date.tm_mday) {
-            if (now_tm->tm_hour < _date.tm_hour) {
-                ret.tm_mon = now_tm->tm_mon;
-            }
-            else if (now_tm->tm_hour == _date.tm_hour) {
-                if (now_tm->tm_min < _date.tm_min) {
-                    ret.tm_mon = now_tm->tm_mon;
-                }
-                else {
-                    ret.tm_mon += 1;
-                }
-            }
-            else {
-                ret.tm_mon += 1;
-            }
-        }
-        else {
-            // else, the next month is the actual +1
+        // current month is the mont of the next date, else the next month
+        // is the actual +1
+        if (now_tm->tm_mday > _date.tm_mday ||
+            (now_tm->tm_mday == _date.tm_mday &&
+             (now_tm->tm_hour > _date.tm_hour ||
+              (now_tm->tm_hour == _date.tm_hour &&
+               now_tm->tm_min >= _date.tm_min)))) {
             ret.tm_mon += 1;
         }
     }
     else {
-        // the month of starting is the actual month
-        ret.tm_mon = now_tm->tm_mon;
         // daily
-        // if now <= specified hour
+        // if now is before the specified hour and minutes
         // then today is the day and the hour is the specified one
-        if (now_tm->tm_hour <= _date.tm_hour && now_tm->tm_min < _date.tm_min) {
+        if (now_tm->tm_hour < _date.tm_hour ||
+            (now_tm->tm_hour == _date.tm_hour &&
+             now_tm->tm_min < _date.tm_min)) {
             ret.tm_mday = now_tm->tm_mday;
         }
         else {
@@ -76,28 +64,26 @@ void DollarCostAveraging::buy(const currency_pair_t &pair)
     // is found and it lasted at least 2 hours, then the buy commad it sent.
     while (true) {
         auto date = _next_date();
-        std::this_thread::sleep_until(
-            std::chrono::system_clock::from_time_t(date));
+        _clock->sleep_until(std::chrono::system_clock::from_time_t(date));
 
-        std::cout << "[DCA] " << pair << " unlocked. Waiting for the dip\n";
+        _logger->info("{} unlocked. Waiting for the dip", pair);
         while (true) {
-            auto stats_period_ago = std::chrono::system_clock::to_time_t(
-                std::chrono::system_clock::now() - 2h);
+            auto stats_period_ago =
+                std::chrono::system_clock::to_time_t(_clock->now() - 2h);
 
-            auto currency_history =
-                _monitors->currencyHistory(pair.first, stats_period_ago);
+            auto currency_series =
+                _monitors->currencySeries(pair.first, stats_period_ago);
 
             // check if there's a downtrend in the overall window
             bool dip = true;
-            for (std::size_t i = 0;
-                 i < static_cast<std::size_t>(currency_history.size()); ++i) {
-                dip = dip && currency_history[i].percent_change_24h < 0;
+            for (auto change : currency_series.column("percent_change_24h")) {
+                dip = dip && change < 0;
             }
             if (!dip) {
-                std::this_thread::sleep_for(30min);
+                _clock->sleep_for(30min);
             }
             else {
-                std::cout << "[DCA] " << pair << " dip!\n";
+                _logger->info("{} dip!", pair);
                 break;
             }
         }
@@ -109,11 +95,11 @@ void DollarCostAveraging::buy(const currency_pair_t &pair)
         order.pair = pair;
         message.budget.quote = _buy_quantity;
         message.order = order;
-        _chan->put(message);
+        _send(message);
         // Sleep for 1 second otherwise _next_date()
         // that has a second precision will trigger the
         // same date until a second is passed
-        std::this_thread::sleep_for(1s);
+        _clock->sleep_for(1s);
     }
 }
 
@@ -0,0 +1,114 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <atd/histogram.hpp>
+#include <cmath>
+
+namespace atd {
+
+LatencyHistogram::LatencyHistogram() : _sum(0)
+{
+    for (auto& count : _counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+// _index returns the bucket of a duration: values below _sub_buckets ns
+// have their own bucket, then every [2^e, 2^(e+1)) range is split in
+// _sub_buckets buckets
+std::size_t LatencyHistogram::_index(std::uint64_t nanoseconds)
+{
+    if (nanoseconds < _sub_buckets) {
+        return nanoseconds;
+    }
+    std::size_t exponent = 63 - __builtin_clzll(nanoseconds);
+    std::size_t sub =
+        (nanoseconds >> (exponent - _sub_bits)) & (_sub_buckets - 1);
+    return (exponent - _sub_bits + 1) * _sub_buckets + sub;
+}
+
+std::uint64_t LatencyHistogram::_upper_bound(std::size_t index)
+{
+    if (index < _sub_buckets) {
+        return index;
+    }
+    std::size_t exponent = index / _sub_buckets + _sub_bits - 1;
+    std::uint64_t sub = index % _sub_buckets;
+    std::uint64_t width = std::uint64_t(1) << (exponent - _sub_bits);
+    return (_sub_buckets + sub) * width + width - 1;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration)
+{
+    auto nanoseconds = duration.count() > 0 ? duration.count() : 0;
+    _counts[_index(static_cast<std::uint64_t>(nanoseconds))].fetch_add(
+        1, std::memory_order_relaxed);
+    _sum.fetch_add(static_cast<std::uint64_t>(nanoseconds),
+                   std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::count() const
+{
+    std::uint64_t total = 0;
+    for (const auto& count : _counts) {
+        total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::uint64_t LatencyHistogram::count(std::chrono::nanoseconds upper) const
+{
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < _buckets; ++i) {
+        if (static_cast<long long>(_upper_bound(i)) > upper.count()) {
+            break;
+        }
+        total += _counts[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::chrono::nanoseconds LatencyHistogram::sum() const
+{
+    return std::chrono::nanoseconds(_sum.load(std::memory_order_relaxed));
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double p) const
+{
+    // counts keep changing while reading them: work on a snapshot
+    std::array<std::uint64_t, _buckets> counts;
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < _buckets; ++i) {
+        counts[i] = _counts[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+
+    auto rank = static_cast<std::uint64_t>(std::ceil(p * total));
+    if (rank == 0) {
+        rank = 1;
+    }
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < _buckets; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::chrono::nanoseconds(_upper_bound(i));
+        }
+    }
+    return std::chrono::nanoseconds(_upper_bound(_buckets - 1));
+}
+
+}  // end namespace atd
@@ -0,0 +1,405 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <atd/indicators.hpp>
+#include <atd/stats/RollingMoments.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <sstream>
+#include <stdexcept>
+
+namespace atd {
+
+std::string indicator_name(const indicator_spec_t& spec)
+{
+    auto extreme = spec.kind == indicator_kind_t::min ||
+                   spec.kind == indicator_kind_t::max;
+    if (spec.span != 0) {
+        std::ostringstream name_span;
+        if (!extreme || spec.span < 0) {
+            throw std::invalid_argument(
+                "indicator: only min and max have a positive span");
+        }
+        // the window is the span, whatever the period
+        name_span << (spec.kind == indicator_kind_t::min ? "min(" : "max(")
+                  << spec.span << "s)";
+        return name_span.str();
+    }
+    if (spec.period == 0) {
+        throw std::invalid_argument("indicator: empty period");
+    }
+    std::ostringstream name;
+    switch (spec.kind) {
+        case indicator_kind_t::sma:
+            name << "sma(" << spec.period << ")";
+            break;
+        case indicator_kind_t::ema:
+            name << "ema(" << spec.period << ")";
+            break;
+        case indicator_kind_t::rsi:
+            name << "rsi(" << spec.period << ")";
+            break;
+        case indicator_kind_t::macd:
+            if (spec.slow <= spec.period || spec.signal == 0) {
+                throw std::invalid_argument(
+                    "indicator: macd requires period < slow and a signal");
+            }
+            name << "macd(" << spec.period << "," << spec.slow << ","
+                 << spec.signal << ")";
+            break;
+        case indicator_kind_t::bollinger:
+            if (!(spec.width > 0)) {
+                throw std::invalid_argument(
+                    "indicator: bollinger requires a positive width");
+            }
+            name << "bollinger(" << spec.period << "," << spec.width << ")";
+            break;
+        case indicator_kind_t::min:
+            name << "min(" << spec.period << ")";
+            break;
+        case indicator_kind_t::max:
+            name << "max(" << spec.period << ")";
+            break;
+        default:
+            throw std::invalid_argument("indicator: unknown kind");
+    }
+    return name.str();
+}
+
+std::size_t indicator_warmup(const indicator_spec_t& spec)
+{
+    // the weight of the samples older than 4 periods is below 1%
+    switch (spec.kind) {
+        case indicator_kind_t::ema:
+            return 4 * spec.period;
+        case indicator_kind_t::rsi:
+            // the first sample is only the reference of the first change
+            return 4 * spec.period + 1;
+        case indicator_kind_t::macd:
+            return 4 * spec.slow + spec.signal;
+        case indicator_kind_t::min:
+        case indicator_kind_t::max:
+            return spec.span != 0 ? 0 : spec.period;
+        default:
+            return spec.period;
+    }
+}
+
+void Indicator::push(std::time_t time, double x)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    if (_value.samples > 0 && time <= _value.time) {
+        return;
+    }
+    _value.time = time;
+    _update(x, _value);
+    ++_value.samples;
+}
+
+indicator_value_t Indicator::value() const
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    return _value;
+}
+
+// _ema_t is an exponential moving average, seeded with the mean of its first
+// period samples
+class _ema_t {
+private:
+    std::size_t _period, _n;
+    double _alpha, _value;
+
+public:
+    _ema_t(std::size_t period)
+        : _period(period), _n(0), _alpha(2. / (period + 1)), _value(0)
+    {
+    }
+    void push(double x)
+    {
+        if (_n < _period) {
+            ++_n;
+            _value += (x - _value) / _n;
+            return;
+        }
+        _value += _alpha * (x - _value);
+    }
+    bool ready() const { return _n == _period; }
+    double value() const { return _value; }
+};
+
+class _sma : public Indicator {
+private:
+    stats::RollingMoments<double> _moments;
+
+protected:
+    void _update(double x, indicator_value_t& value) override
+    {
+        _moments.push(x);
+        value.ready = _moments.full();
+        value.value = _moments.mean();
+    }
+
+public:
+    _sma(const indicator_spec_t& spec)
+        : Indicator(spec), _moments(spec.period)
+    {
+    }
+};
+
+class _bollinger : public Indicator {
+private:
+    stats::RollingMoments<double> _moments;
+
+protected:
+    void _update(double x, indicator_value_t& value) override
+    {
+        _moments.push(x);
+        auto band = spec().width * _moments.stdev();
+        value.ready = _moments.full();
+        value.value = _moments.mean();
+        value.upper = value.value + band;
+        value.lower = value.value - band;
+    }
+
+public:
+    _bollinger(const indicator_spec_t& spec)
+        : Indicator(spec), _moments(spec.period)
+    {
+    }
+};
+
+class _ema : public Indicator {
+private:
+    _ema_t _average;
+
+protected:
+    void _update(double x, indicator_value_t& value) override
+    {
+        _average.push(x);
+        value.ready = _average.ready();
+        value.value = _average.value();
+    }
+
+public:
+    _ema(const indicator_spec_t& spec)
+        : Indicator(spec), _average(spec.period)
+    {
+    }
+};
+
+// Wilder's relative strength index: the average gains and losses are the
+// mean of the first period changes, then smoothed by 1/period
+class _rsi : public Indicator {
+private:
+    std::size_t _n;
+    double _last, _gain, _loss;
+
+protected:
+    void _update(double x, indicator_value_t& value) override
+    {
+        if (value.samples == 0) {
+            _last = x;
+            value.value = 50;
+            return;
+        }
+        auto change = x - _last;
+        _last = x;
+        auto gain = std::max(change, 0.), loss = std::max(-change, 0.);
+        auto period = spec().period;
+        if (_n < period) {
+            ++_n;
+            _gain += (gain - _gain) / _n;
+            _loss += (loss - _loss) / _n;
+        }
+        else {
+            _gain = (_gain * (period - 1) + gain) / period;
+            _loss = (_loss * (period - 1) + loss) / period;
+        }
+        value.ready = _n == period;
+        if (_loss == 0) {
+            // a flat series is neutral
+            value.value = _gain == 0 ? 50 : 100;
+        }
+        else {
+            value.value = 100 - 100 / (1 + _gain / _loss);
+        }
+    }
+
+public:
+    _rsi(const indicator_spec_t& spec)
+        : Indicator(spec), _n(0), _last(0), _gain(0), _loss(0)
+    {
+    }
+};
+
+class _macd : public Indicator {
+private:
+    _ema_t _fast, _slow, _signal;
+
+protected:
+    void _update(double x, indicator_value_t& value) override
+    {
+        _fast.push(x);
+        _slow.push(x);
+        if (!_slow.ready()) {
+            return;
+        }
+        value.value = _fast.value() - _slow.value();
+        _signal.push(value.value);
+        value.signal = _signal.value();
+        value.ready = _signal.ready();
+    }
+
+public:
+    _macd(const indicator_spec_t& spec)
+        : Indicator(spec),
+          _fast(spec.period),
+          _slow(spec.slow),
+          _signal(spec.signal)
+    {
+    }
+};
+
+// _extreme is the min (compare = std::less) or the max (std::greater) of the
+// window: the samples that can't be the extreme anymore, because a newer one
+// beats them, are dropped, so the front of the deque is the extreme and every
+// sample is pushed and popped once.
+// The window is the last period samples or, with a span, the samples of the
+// last span seconds: the samples are keyed by index or by time, and the ones
+// with key + period (or span) <= the newest key are out of it
+template <class compare>
+class _extreme : public Indicator {
+private:
+    // (key, sample), the extreme first
+    std::deque<std::pair<std::int64_t, double>> _window;
+    // time of the first sample
+    std::time_t _first;
+
+protected:
+    void _update(double x, indicator_value_t& value) override
+    {
+        auto span = spec().span;
+        std::int64_t key = span != 0 ? value.time : value.samples;
+        std::int64_t length = span != 0 ? span : spec().period;
+        if (value.samples == 0) {
+            _first = value.time;
+        }
+        while (!_window.empty() && !compare()(_window.back().second, x)) {
+            _window.pop_back();
+        }
+        _window.emplace_back(key, x);
+        while (_window.front().first + length <= key) {
+            _window.pop_front();
+        }
+        value.ready = span != 0 ? value.time - _first >= span
+                                : value.samples + 1 >= spec().period;
+        value.value = _window.front().second;
+    }
+
+public:
+    _extreme(const indicator_spec_t& spec) : Indicator(spec), _first(0) {}
+};
+
+std::shared_ptr<Indicator> make_indicator(const indicator_spec_t& spec)
+{
+    // validates spec
+    indicator_name(spec);
+    switch (spec.kind) {
+        case indicator_kind_t::sma:
+            return std::make_shared<_sma>(spec);
+        case indicator_kind_t::ema:
+            return std::make_shared<_ema>(spec);
+        case indicator_kind_t::rsi:
+            return std::make_shared<_rsi>(spec);
+        case indicator_kind_t::macd:
+            return std::make_shared<_macd>(spec);
+        case indicator_kind_t::bollinger:
+            return std::make_shared<_bollinger>(spec);
+        case indicator_kind_t::min:
+            return std::make_shared<_extreme<std::less<double>>>(spec);
+        case indicator_kind_t::max:
+        default:
+            return std::make_shared<_extreme<std::greater<double>>>(spec);
+    }
+}
+
+std::shared_ptr<IndicatorEngine::series_t> IndicatorEngine::_find(
+    const std::string& series)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    auto it = _series.find(series);
+    if (it == _series.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+std::shared_ptr<Indicator> IndicatorEngine::subscribe(
+    const std::string& series, const indicator_spec_t& spec, loader_t load)
+{
+    auto name = indicator_name(spec);
+    std::shared_ptr<series_t> target;
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        auto& found = _series[series];
+        if (found == nullptr) {
+            found = std::make_shared<series_t>();
+        }
+        target = found;
+    }
+
+    // the pushes wait for the warm-up: the samples ingested meanwhile are
+    // either returned by load or pushed after it
+    std::lock_guard<std::mutex> lock(target->mux);
+    auto it = target->indicators.find(name);
+    if (it != target->indicators.end()) {
+        return it->second;
+    }
+    auto indicator = make_indicator(spec);
+    auto samples = load(indicator_warmup(spec), spec.span);
+    std::sort(samples.begin(), samples.end());
+    for (const auto& [time, x] : samples) {
+        indicator->push(time, x);
+    }
+    target->indicators[name] = indicator;
+    return indicator;
+}
+
+void IndicatorEngine::push(const std::string& series, std::time_t time,
+                           double x)
+{
+    auto target = _find(series);
+    if (target == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(target->mux);
+    for (const auto& [name, indicator] : target->indicators) {
+        indicator->push(time, x);
+    }
+}
+
+std::size_t IndicatorEngine::size()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    std::size_t ret = 0;
+    for (const auto& [name, series] : _series) {
+        std::lock_guard<std::mutex> series_lock(series->mux);
+        ret += series->indicators.size();
+    }
+    return ret;
+}
+
+}  // end namespace atd
@@ -0,0 +1,170 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <atd/ledger.hpp>
+#include <set>
+#include <vector>
+
+namespace atd {
+
+// _load fetches the balance of currency the first time it's used.
+// Must be called without holding _mux: it's a network call.
+void Ledger::_load(const std::string& currency)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        if (_balances.find(currency) != _balances.end()) {
+            return;
+        }
+    }
+    auto balance = _retrier->call(
+        "balance", [&]() { return _market->balance(currency); });
+    std::lock_guard<std::mutex> lock(_mux);
+    // if another thread loaded it meanwhile, keep its value: it may have
+    // been already updated by a fill
+    _balances.insert(std::pair(currency, balance));
+}
+
+// requires _mux to be held
+void Ledger::_unreserve(const std::string& currency, double amount)
+{
+    _reserved[currency] -= amount;
+    if (_reserved[currency] < 0) {
+        _reserved[currency] = 0;
+    }
+}
+
+double Ledger::balance(const std::string& currency)
+{
+    _load(currency);
+    std::lock_guard<std::mutex> lock(_mux);
+    return _balances[currency];
+}
+
+double Ledger::available(const std::string& currency)
+{
+    _load(currency);
+    std::lock_guard<std::mutex> lock(_mux);
+    return _balances[currency] - _reserved[currency];
+}
+
+bool Ledger::reserve(const std::string& currency, double amount)
+{
+    _load(currency);
+    std::lock_guard<std::mutex> lock(_mux);
+    if (amount <= 0 || _balances[currency] - _reserved[currency] < amount) {
+        return false;
+    }
+    _reserved[currency] += amount;
+    return true;
+}
+
+void Ledger::release(const std::string& currency, double amount)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    _unreserve(currency, amount);
+}
+
+std::string Ledger::placed(const order_t& order, const std::string& currency,
+                           double amount)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    // An order without txid can't be found among the open orders: keep it
+    // reserved until the next reconciliation
+    auto id = order.txid;
+    if (id.empty()) {
+        id = "untracked-" + std::to_string(++_untracked);
+    }
+    _reservations[id] = reservation_t{.currency = currency,
+                                      .amount = amount,
+                                      .time = std::chrono::steady_clock::now()};
+    // a market order can be already filled in the balance being reconciled
+    ++_versions[currency];
+    return id;
+}
+
+void Ledger::fill(const std::string& id, const std::string& currency,
+                  double amount)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    auto it = _reservations.find(id);
+    if (it == _reservations.end()) {
+        // already reconciled: the balances come from the market
+        return;
+    }
+    auto& reservation = it->second;
+    _balances[reservation.currency] -= reservation.amount;
+    _unreserve(reservation.currency, reservation.amount);
+    _balances[currency] += amount;
+    ++_versions[reservation.currency];
+    ++_versions[currency];
+    _reservations.erase(it);
+}
+
+void Ledger::reconcile()
+{
+    // Reservations made after this point can refer to orders not in the
+    // open orders and not reflected in the balances fetched below
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> currencies;
+    std::map<std::string, std::uint64_t> versions;
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        for (const auto& [currency, balance] : _balances) {
+            currencies.push_back(currency);
+        }
+        versions = _versions;
+    }
+
+    std::set<std::string> open;
+    auto orders =
+        _retrier->call("openOrders", [&]() { return _market->openOrders(); });
+    for (const auto& order : orders) {
+        open.insert(order.txid);
+    }
+    std::map<std::string, double> balances;
+    for (const auto& currency : currencies) {
+        balances[currency] = _retrier->call(
+            "balance", [&]() { return _market->balance(currency); });
+    }
+
+    std::lock_guard<std::mutex> lock(_mux);
+    // A currency changed locally since the fetch began can have a fill not
+    // reflected in the fetched balance: keep the local one
+    std::set<std::string> changed;
+    for (const auto& [currency, version] : _versions) {
+        if (versions[currency] != version) {
+            changed.insert(currency);
+        }
+    }
+    for (const auto& [currency, balance] : balances) {
+        if (changed.find(currency) == changed.end()) {
+            _balances[currency] = balance;
+        }
+    }
+    for (auto it = _reservations.begin(); it != _reservations.end();) {
+        if (it->second.time < start && open.find(it->first) == open.end() &&
+            changed.find(it->second.currency) == changed.end()) {
+            // filled or canceled: the fetched balances already reflect it
+            _unreserve(it->second.currency, it->second.amount);
+            it = _reservations.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+}  // end namespace atd
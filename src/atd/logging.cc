@@ -0,0 +1,122 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <atd/logging.hpp>
+#include <chrono>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+namespace atd {
+
+static std::mutex _logging_mux;
+static bool _initialized = false;
+static logging_config_t _logging_config;
+static spdlog::sink_ptr _console, _structured;
+
+StructuredSink::StructuredSink(const std::string& path)
+    : _out(path, std::ios::binary | std::ios::app)
+{
+    if (!_out) {
+        throw std::runtime_error("StructuredSink: can't open " + path);
+    }
+}
+
+void StructuredSink::sink_it_(const spdlog::details::log_msg& msg)
+{
+    nlohmann::json record = {
+        {"t", std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  msg.time.time_since_epoch())
+                  .count()},
+        {"l", static_cast<int>(msg.level)},
+        {"c", std::string(msg.logger_name.data(), msg.logger_name.size())},
+        {"th", msg.thread_id},
+        {"m", std::string(msg.payload.data(), msg.payload.size())},
+    };
+    auto bytes = nlohmann::json::to_msgpack(record);
+    auto size = static_cast<std::uint32_t>(bytes.size());
+    char header[] = {
+        static_cast<char>(size & 0xff),
+        static_cast<char>((size >> 8) & 0xff),
+        static_cast<char>((size >> 16) & 0xff),
+        static_cast<char>((size >> 24) & 0xff),
+    };
+    _out.write(header, sizeof(header));
+    _out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+void StructuredSink::flush_() { _out.flush(); }
+
+// requires _logging_mux to be held
+static void _init(const logging_config_t& config)
+{
+    _logging_config = config;
+    spdlog::init_thread_pool(config.queue_size, 1);
+    _console = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    if (!config.structured.empty()) {
+        _structured = std::make_shared<StructuredSink>(config.structured);
+    }
+    // the async loggers don't flush on their own
+    spdlog::flush_every(std::chrono::seconds(1));
+    _initialized = true;
+}
+
+void init_logging(const logging_config_t& config)
+{
+    std::lock_guard<std::mutex> lock(_logging_mux);
+    if (_initialized) {
+        throw std::logic_error("init_logging: already initialized");
+    }
+    _init(config);
+}
+
+std::shared_ptr<spdlog::logger> component_logger(
+    const std::string& component, std::vector<spdlog::sink_ptr> sinks)
+{
+    std::lock_guard<std::mutex> lock(_logging_mux);
+    if (!_initialized) {
+        _init(logging_config_t{
+            .queue_size = 8192,
+            .level = spdlog::level::info,
+            .levels = {},
+            .structured = "",
+        });
+    }
+    auto logger = spdlog::get(component);
+    if (logger != nullptr) {
+        return logger;
+    }
+
+    if (sinks.empty()) {
+        sinks.push_back(_console);
+    }
+    if (_structured != nullptr) {
+        sinks.push_back(_structured);
+    }
+    logger = std::make_shared<spdlog::async_logger>(
+        component, sinks.begin(), sinks.end(), spdlog::thread_pool(),
+        spdlog::async_overflow_policy::overrun_oldest);
+    auto level = _logging_config.levels.find(component);
+    logger->set_level(level != _logging_config.levels.end()
+                          ? level->second
+                          : _logging_config.level);
+    logger->flush_on(spdlog::level::err);
+    spdlog::register_logger(logger);
+    return logger;
+}
+
+}  // end namespace atd
@@ -0,0 +1,251 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atd/metrics.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace atd {
+
+Counter::Counter()
+{
+    for (auto& shard : _values) {
+        shard.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+// _shard returns the shard of the calling thread
+std::size_t Counter::_shard()
+{
+    static thread_local std::size_t shard =
+        std::hash<std::thread::id>()(std::this_thread::get_id()) % _shards;
+    return shard;
+}
+
+std::uint64_t Counter::value() const
+{
+    std::uint64_t total = 0;
+    for (const auto& shard : _values) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// _render returns the labels in the Prometheus format: {key="value",...}
+static std::string _render(const labels_t& labels)
+{
+    if (labels.empty()) {
+        return "";
+    }
+    std::ostringstream oss;
+    oss << "{";
+    for (auto it = labels.begin(); it != labels.end(); ++it) {
+        if (it != labels.begin()) {
+            oss << ",";
+        }
+        oss << it->first << "=\"";
+        for (char c : it->second) {
+            if (c == '"' || c == '\\') {
+                oss << '\\';
+            }
+            oss << c;
+        }
+        oss << "\"";
+    }
+    oss << "}";
+    return oss.str();
+}
+
+// requires _mux to be held
+Metrics::family_t& Metrics::_family(const std::string& name,
+                                    const std::string& help,
+                                    const std::string& type)
+{
+    auto& family = _families[name];
+    if (family.type.empty()) {
+        family.help = help;
+        family.type = type;
+    }
+    else if (family.type != type) {
+        throw std::logic_error("Metrics: " + name + " is a " + family.type);
+    }
+    return family;
+}
+
+std::shared_ptr<Counter> Metrics::counter(const std::string& name,
+                                          const std::string& help,
+                                          const labels_t& labels)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    auto& counter = _family(name, help, "counter").counters[_render(labels)];
+    if (counter == nullptr) {
+        counter = std::make_shared<Counter>();
+    }
+    return counter;
+}
+
+std::shared_ptr<Gauge> Metrics::gauge(const std::string& name,
+                                      const std::string& help,
+                                      const labels_t& labels)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    auto& gauge = _family(name, help, "gauge").gauges[_render(labels)];
+    if (gauge == nullptr) {
+        gauge = std::make_shared<Gauge>();
+    }
+    return gauge;
+}
+
+void Metrics::gauge(const std::string& name, const std::string& help,
+                    const labels_t& labels, std::function<double()> read)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    _family(name, help, "gauge").readers[_render(labels)] = read;
+}
+
+std::shared_ptr<LatencyHistogram> Metrics::histogram(const std::string& name,
+                                                     const std::string& help,
+                                                     const labels_t& labels)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    auto& histogram =
+        _family(name, help, "histogram").histograms[_render(labels)];
+    if (histogram == nullptr) {
+        histogram = std::make_shared<LatencyHistogram>();
+    }
+    return histogram;
+}
+
+std::string Metrics::expose()
+{
+    // upper bounds, in seconds, of the exposed histogram buckets
+    static const double bounds[] = {0.0005, 0.001, 0.005, 0.01, 0.05, 0.1,
+                                    0.5,    1,     5,     10,   30,   60};
+
+    std::lock_guard<std::mutex> lock(_mux);
+    std::ostringstream oss;
+    for (const auto& [name, family] : _families) {
+        oss << "# HELP " << name << " " << family.help << "\n";
+        oss << "# TYPE " << name << " " << family.type << "\n";
+        for (const auto& [labels, counter] : family.counters) {
+            oss << name << labels << " " << counter->value() << "\n";
+        }
+        for (const auto& [labels, gauge] : family.gauges) {
+            oss << name << labels << " " << gauge->value() << "\n";
+        }
+        for (const auto& [labels, read] : family.readers) {
+            oss << name << labels << " " << read() << "\n";
+        }
+        for (const auto& [labels, histogram] : family.histograms) {
+            // the le label joins the other ones
+            auto prefix = labels.empty()
+                              ? std::string("{")
+                              : labels.substr(0, labels.size() - 1) + ",";
+            for (auto bound : bounds) {
+                auto upper =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::duration<double>(bound));
+                oss << name << "_bucket" << prefix << "le=\"" << bound
+                    << "\"} " << histogram->count(upper) << "\n";
+            }
+            auto count = histogram->count();
+            oss << name << "_bucket" << prefix << "le=\"+Inf\"} " << count
+                << "\n";
+            oss << name << "_sum" << labels << " "
+                << std::chrono::duration<double>(histogram->sum()).count()
+                << "\n";
+            oss << name << "_count" << labels << " " << count << "\n";
+        }
+    }
+    return oss.str();
+}
+
+void MetricsServer::serve()
+{
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) {
+        throw std::runtime_error(std::string("MetricsServer: socket: ") +
+                                 std::strerror(errno));
+    }
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(_config.port);
+    if (inet_pton(AF_INET, _config.address.c_str(), &address.sin_addr) != 1) {
+        close(server);
+        throw std::runtime_error("MetricsServer: invalid address " +
+                                 _config.address);
+    }
+    if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) <
+            0 ||
+        listen(server, 16) < 0) {
+        auto error = std::string(std::strerror(errno));
+        close(server);
+        throw std::runtime_error("MetricsServer: " + _config.address + ":" +
+                                 std::to_string(_config.port) + ": " + error);
+    }
+
+    while (true) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        // A single thread serves every client: an idle or slow one can
+        // hold it only up to the timeout
+        timeval timeout = {};
+        timeout.tv_sec = 2;
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        // only the request line matters
+        char request[1024];
+        auto size = recv(client, request, sizeof(request) - 1, 0);
+        request[size > 0 ? size : 0] = '\0';
+
+        std::string status = "404 Not Found", body = "not found\n";
+        if (std::strncmp(request, "GET /metrics", 12) == 0) {
+            status = "200 OK";
+            body = _metrics->expose();
+        }
+        std::ostringstream response;
+        response << "HTTP/1.0 " << status << "\r\n"
+                 << "Content-Type: text/plain; version=0.0.4\r\n"
+                 << "Content-Length: " << body.size() << "\r\n"
+                 << "Connection: close\r\n\r\n"
+                 << body;
+        auto data = response.str();
+        std::size_t sent = 0;
+        while (sent < data.size()) {
+            auto n = send(client, data.data() + sent, data.size() - sent,
+                          MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            sent += n;
+        }
+        close(client);
+    }
+}
+
+}  // end namespace atd
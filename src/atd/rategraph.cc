@@ -0,0 +1,191 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <atd/rategraph.hpp>
+#include <deque>
+#include <mutex>
+
+namespace atd {
+
+void RateGraph::update(std::string from, std::string to, double rate,
+                       long long day_volume_usd, std::time_t last_updated,
+                       const std::string& source)
+{
+    if (rate <= 0) {
+        return;
+    }
+    at::tolower(from);
+    at::tolower(to);
+    if (from == to) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mux);
+    auto direct = _key(from, to);
+    auto it = _edges.find(direct);
+    if (it != _edges.end()) {
+        if (it->second.source == source) {
+            // the volume of a source changes with its price: only the time
+            // of the sample matters
+            if (last_updated < it->second.last_updated) {
+                return;
+            }
+        }
+        else {
+            auto stale =
+                last_updated - it->second.last_updated > _max_age.count();
+            if (!stale && day_volume_usd < it->second.day_volume_usd) {
+                return;
+            }
+        }
+    }
+    else {
+        // new edge: the cached paths may not be the shortest anymore
+        _adjacency[from].insert(to);
+        _adjacency[to].insert(from);
+        _paths.clear();
+    }
+    _edges[direct] = rate_edge_t{.rate = rate,
+                                 .day_volume_usd = day_volume_usd,
+                                 .last_updated = last_updated,
+                                 .source = source};
+    _edges[_key(to, from)] = rate_edge_t{.rate = 1. / rate,
+                                         .day_volume_usd = day_volume_usd,
+                                         .last_updated = last_updated,
+                                         .source = source};
+}
+
+// _needs_fiat returns true if currency is a fiat currency whose edge is
+// missing or stale, or a currency never seen (that could be a fiat one)
+bool RateGraph::_needs_fiat(const std::string& currency) const
+{
+    std::shared_lock<std::shared_mutex> lock(_mux);
+    if (_fiats.find(currency) != _fiats.end()) {
+        auto edge = _edges.find(_key(currency, "usd"));
+        return edge == _edges.end() ||
+               _clock->time() - edge->second.last_updated > _max_age.count();
+    }
+    return _not_fiats.find(currency) == _not_fiats.end() &&
+           _adjacency.find(currency) == _adjacency.end();
+}
+
+// _connect_fiat adds (or refreshes) the edge currency/usd using the fiat
+// rates, remembering the currencies that are not fiat ones
+void RateGraph::_connect_fiat(const std::string& currency)
+{
+    std::lock_guard<std::mutex> fiat_lock(_fiat_mux);
+    // another thread could have connected it while waiting
+    if (!_needs_fiat(currency)) {
+        return;
+    }
+    double rate;
+    try {
+        // usd for 1 currency
+        rate = _fiat.rate(currency_pair_t(currency, "usd"));
+    }
+    catch (const std::out_of_range&) {
+        std::unique_lock<std::shared_mutex> lock(_mux);
+        _not_fiats.insert(currency);
+        return;
+    }
+    {
+        std::unique_lock<std::shared_mutex> lock(_mux);
+        _fiats.insert(currency);
+    }
+    // fiat rates have no volume: a fresher monitored market always wins
+    update(currency, "usd", rate, 0, _clock->time(), "fiat");
+}
+
+// _shortest_path finds, with a BFS, the list of edges from "from" to "to".
+// Requires _mux to be held.
+bool RateGraph::_shortest_path(const std::string& from, const std::string& to,
+                               std::vector<std::string>& path) const
+{
+    std::unordered_map<std::string, std::string> parent;
+    std::deque<std::string> frontier = {from};
+    parent[from] = from;
+    while (!frontier.empty()) {
+        auto node = frontier.front();
+        frontier.pop_front();
+        if (node == to) {
+            std::vector<std::string> reversed;
+            for (auto cur = to; cur != from; cur = parent[cur]) {
+                reversed.push_back(_key(parent[cur], cur));
+            }
+            path.assign(reversed.rbegin(), reversed.rend());
+            return true;
+        }
+        auto adjacents = _adjacency.find(node);
+        if (adjacents == _adjacency.end()) {
+            continue;
+        }
+        for (const auto& next : adjacents->second) {
+            if (parent.find(next) == parent.end()) {
+                parent[next] = node;
+                frontier.push_back(next);
+            }
+        }
+    }
+    return false;
+}
+
+double RateGraph::rate(std::string from, std::string to)
+{
+    at::tolower(from);
+    at::tolower(to);
+    if (from == to) {
+        return 1;
+    }
+
+    // Connect (or refresh) the endpoints the monitors know nothing about
+    // using the fiat rates. Done without holding the lock, it's a network
+    // call.
+    for (const auto& currency : {from, to}) {
+        if (_needs_fiat(currency)) {
+            _connect_fiat(currency);
+        }
+    }
+
+    auto key = _key(from, to);
+    {
+        std::shared_lock<std::shared_mutex> lock(_mux);
+        auto edge = _edges.find(key);
+        if (edge != _edges.end()) {
+            return edge->second.rate;
+        }
+        auto path = _paths.find(key);
+        if (path != _paths.end()) {
+            double ret = 1;
+            for (const auto& step : path->second) {
+                ret *= _edges.at(step).rate;
+            }
+            return ret;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mux);
+    std::vector<std::string> path;
+    if (!_shortest_path(from, to, path)) {
+        throw std::out_of_range("RateGraph::rate: " + key +
+                                " no conversion path");
+    }
+    double ret = 1;
+    for (const auto& step : path) {
+        ret *= _edges.at(step).rate;
+    }
+    _paths[key] = path;
+    return ret;
+}
+
+}  // end namespace atd
@@ -0,0 +1,121 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <atd/resample.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace atd {
+
+TimeSeries resample(const TimeSeries& series, std::chrono::seconds step,
+                    interpolation_t method, const std::string& volume)
+{
+    std::time_t s = step.count();
+    if (s <= 0) {
+        throw std::invalid_argument("resample: step must be positive");
+    }
+    const auto& names = series.columns();
+    auto volume_column = names.size();
+    if (method == interpolation_t::vwap) {
+        auto it = std::find(names.begin(), names.end(), volume);
+        if (it == names.end()) {
+            throw std::out_of_range("resample: no volume column " + volume);
+        }
+        volume_column = it - names.begin();
+    }
+
+    column_t<std::time_t> grid;
+    std::vector<column_t<double>> columns(names.size());
+    auto time = series.time();
+    if (time.empty()) {
+        return TimeSeries(names, std::move(grid), std::move(columns));
+    }
+    // first and last multiples of step within the samples
+    auto first = time.front() / s * s;
+    if (first < time.front()) {
+        first += s;
+    }
+    auto last = time.back() / s * s;
+    if (last > time.back()) {
+        last -= s;
+    }
+    if (first > last) {
+        return TimeSeries(names, std::move(grid), std::move(columns));
+    }
+
+    // Where every grid time falls among the samples: the last sample at or
+    // before it, the first sample after the previous grid time (the step
+    // of vwap) and the distance from the last sample to the next one
+    std::size_t n = (last - first) / s + 1, size = time.size();
+    grid.resize(n);
+    std::vector<std::size_t> at(n), from(n);
+    std::vector<double> weight(n, 0);
+    for (std::size_t k = 0, i = 0, j = 0; k < n; ++k) {
+        auto t = first + static_cast<std::time_t>(k) * s;
+        grid[k] = t;
+        while (i + 1 < size && time[i + 1] <= t) {
+            ++i;
+        }
+        while (j < size && time[j] <= t - s) {
+            ++j;
+        }
+        at[k] = i;
+        from[k] = j;
+        if (i + 1 < size) {
+            weight[k] =
+                static_cast<double>(t - time[i]) / (time[i + 1] - time[i]);
+        }
+    }
+
+    for (std::size_t c = 0; c < names.size(); ++c) {
+        const double* x = series.column(c).data();
+        auto& out = columns[c];
+        out.resize(n);
+        if (method == interpolation_t::last || c == volume_column) {
+            for (std::size_t k = 0; k < n; ++k) {
+                out[k] = x[at[k]];
+            }
+        }
+        else if (method == interpolation_t::linear) {
+            for (std::size_t k = 0; k < n; ++k) {
+                // past the last sample the weight is 0
+                auto a = at[k], b = std::min(a + 1, size - 1);
+                out[k] = x[a] + weight[k] * (x[b] - x[a]);
+            }
+        }
+        else {
+            const double* v = series.column(volume_column).data();
+            for (std::size_t k = 0; k < n; ++k) {
+                if (from[k] > at[k]) {
+                    // no samples in the step
+                    out[k] = k > 0 ? out[k - 1] : x[at[k]];
+                    continue;
+                }
+                double traded = 0, volumes = 0, sum = 0;
+                for (auto i = from[k]; i <= at[k]; ++i) {
+                    traded += v[i] * x[i];
+                    volumes += v[i];
+                    sum += x[i];
+                }
+                out[k] = volumes > 0 ? traded / volumes
+                                     : sum / (at[k] - from[k] + 1);
+            }
+        }
+    }
+    return TimeSeries(names, std::move(grid), std::move(columns));
+}
+
+}  // end namespace atd
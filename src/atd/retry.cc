@@ -0,0 +1,145 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <spdlog/spdlog.h>
+#include <atd/retry.hpp>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace atd {
+
+std::chrono::milliseconds Backoff::next()
+{
+    double delay = _policy.initial_delay.count() *
+                   std::pow(_policy.multiplier, _attempts);
+    delay = std::min(delay, static_cast<double>(_policy.max_delay.count()));
+    ++_attempts;
+
+    // spread the retries of the threads failed together
+    std::uniform_real_distribution<double> jitter(-_policy.jitter,
+                                                  _policy.jitter);
+    delay += delay * jitter(_rng);
+    return std::chrono::milliseconds(static_cast<long long>(delay));
+}
+
+bool CircuitBreaker::allow()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    switch (_state) {
+        case state_t::closed:
+            return true;
+        case state_t::open:
+            if (std::chrono::steady_clock::now() - _opened_at <
+                _policy.open_timeout) {
+                return false;
+            }
+            // let a single call probe the endpoint
+            _state = state_t::half_open;
+            return true;
+        case state_t::half_open:
+        default:
+            return false;
+    }
+}
+
+void CircuitBreaker::success()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    _state = state_t::closed;
+    _failures = 0;
+}
+
+bool CircuitBreaker::failure()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    ++_failures;
+    if (_state == state_t::half_open ||
+        (_state == state_t::closed && _policy.failure_threshold > 0 &&
+         _failures >= _policy.failure_threshold)) {
+        _state = state_t::open;
+        _opened_at = std::chrono::steady_clock::now();
+        ++_opened;
+        return true;
+    }
+    return false;
+}
+
+circuit_stats_t CircuitBreaker::stats()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    return circuit_stats_t{
+        .open = _state != state_t::closed,
+        .failures = _failures,
+        .opened = _opened,
+    };
+}
+
+Retrier::endpoint_t Retrier::_endpoint(const std::string& endpoint)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    auto& target = _endpoints[endpoint];
+    if (target.breaker == nullptr) {
+        labels_t labels = {{"service", _name}, {"endpoint", endpoint}};
+        target.breaker = std::make_shared<CircuitBreaker>(_policy);
+        target.latency = _metrics->histogram(
+            "atd_api_request_duration_seconds",
+            "Duration of the API calls, every attempt", labels);
+        labels["error"] = "server_error";
+        target.server_errors = _metrics->counter(
+            "atd_api_errors_total", "API calls failed, every attempt", labels);
+        labels["error"] = "response_error";
+        target.response_errors = _metrics->counter(
+            "atd_api_errors_total", "API calls failed, every attempt", labels);
+        auto breaker = target.breaker;
+        _metrics->gauge("atd_api_circuit_open",
+                        "1 if the calls to the endpoint are rejected",
+                        {{"service", _name}, {"endpoint", endpoint}},
+                        [breaker]() { return breaker->stats().open ? 1 : 0; });
+    }
+    return target;
+}
+
+void Retrier::_opened(const std::string& endpoint)
+{
+    auto logger = spdlog::get("console");
+    if (logger != nullptr) {
+        logger->warn("Retrier: {}/{} circuit open for {}s", _name, endpoint,
+                     _policy.open_timeout.count());
+    }
+}
+
+void Retrier::_sleep(std::chrono::milliseconds delay)
+{
+    auto stop = StopSignal::current();
+    if (stop == nullptr) {
+        std::this_thread::sleep_for(delay);
+        return;
+    }
+    if (!stop->sleep_for(delay)) {
+        throw clock_stopped("Retrier: stopped");
+    }
+}
+
+std::map<std::string, circuit_stats_t> Retrier::circuits()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    std::map<std::string, circuit_stats_t> ret;
+    for (const auto& [endpoint, target] : _endpoints) {
+        ret[_name + "/" + endpoint] = target.breaker->stats();
+    }
+    return ret;
+}
+
+}  // end namespace atd
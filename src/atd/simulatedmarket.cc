@@ -0,0 +1,295 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <atd/simulatedmarket.hpp>
+#include <cmath>
+#include <thread>
+
+namespace atd {
+
+SimulatedMarket::SimulatedMarket(const simulated_market_config_t& config)
+    : _config(config), _rng(config.seed), _balances(config.balances), _txid(0)
+{
+    for (const auto& pair : _config.pairs) {
+        _pairs[pair.pair] = pair;
+        _prices[pair.pair] = pair.price;
+    }
+}
+
+// _call simulates the round trip of a call to endpoint and the injected
+// errors. Must be called without holding _mux.
+void SimulatedMarket::_call(const std::string& endpoint)
+{
+    std::chrono::milliseconds latency;
+    double outcome;
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        auto jitter = _config.latency_jitter.count();
+        std::uniform_int_distribution<long long> jitter_dist(-jitter, jitter);
+        latency =
+            _config.latency + std::chrono::milliseconds(jitter_dist(_rng));
+        outcome = std::uniform_real_distribution<double>(0, 1)(_rng);
+    }
+    if (latency.count() > 0) {
+        std::this_thread::sleep_for(latency);
+    }
+    if (outcome < _config.server_error_rate) {
+        throw at::server_error("SimulatedMarket::" + endpoint +
+                               ": injected server error");
+    }
+    if (outcome < _config.server_error_rate + _config.response_error_rate) {
+        throw at::response_error("SimulatedMarket::" + endpoint +
+                                 ": injected response error");
+    }
+}
+
+// requires _mux to be held
+const simulated_pair_t& SimulatedMarket::_pair(const currency_pair_t& pair)
+{
+    auto it = _pairs.find(pair);
+    if (it == _pairs.end()) {
+        throw at::response_error("SimulatedMarket: unknown pair " +
+                                 pair.first + "_" + pair.second);
+    }
+    return it->second;
+}
+
+// requires _mux to be held
+ticker_t SimulatedMarket::_ticker(const currency_pair_t& pair)
+{
+    const auto& simulated = _pair(pair);
+    auto price = _prices[pair];
+    ticker_t ret = {};
+    ret.pair = pair;
+    ret.ask.price = price * (1 + simulated.spread / 2);
+    ret.ask.volume = simulated.depth;
+    ret.bid.price = price * (1 - simulated.spread / 2);
+    ret.bid.volume = simulated.depth;
+    return ret;
+}
+
+// _step moves the price of pair and fills the open orders it reaches.
+// Requires _mux to be held.
+void SimulatedMarket::_step(const currency_pair_t& pair)
+{
+    auto volatility = _pair(pair).volatility;
+    if (volatility > 0) {
+        std::normal_distribution<double> change(0, volatility);
+        _prices[pair] *= std::exp(change(_rng));
+    }
+    _reach(pair);
+}
+
+// _reach fills the open orders of pair reached by its price.
+// Requires _mux to be held.
+void SimulatedMarket::_reach(const currency_pair_t& pair)
+{
+    auto ticker = _ticker(pair);
+    for (auto it = _open.begin(); it != _open.end();) {
+        auto& order = it->second;
+        bool reached =
+            order.pair == pair &&
+            (order.action == at::order_action_t::buy
+                 ? ticker.ask.price <= order.price
+                 : ticker.bid.price >= order.price);
+        if (!reached) {
+            ++it;
+            continue;
+        }
+        if (order.action == at::order_action_t::buy) {
+            _held[pair.second] -= order.cost * (1 + _config.maker_fee / 100);
+        }
+        else {
+            _held[pair.first] -= order.volume;
+        }
+        _fill(order, order.price, _config.maker_fee);
+        _closed.push_back(order);
+        it = _open.erase(it);
+    }
+}
+
+// _fill moves the funds of the order filled at price, paying fee percent.
+// Requires _mux to be held.
+void SimulatedMarket::_fill(order_t& order, double price, double fee)
+{
+    order.price = price;
+    order.cost = order.volume * price;
+    auto paid = order.cost * fee / 100;
+    if (order.action == at::order_action_t::buy) {
+        _balances[order.pair.first] += order.volume;
+        _balances[order.pair.second] -= order.cost + paid;
+    }
+    else {
+        _balances[order.pair.first] -= order.volume;
+        _balances[order.pair.second] += order.cost - paid;
+    }
+    _fees[order.pair.second] += paid;
+}
+
+void SimulatedMarket::quote(const currency_pair_t& pair, double price)
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    _pair(pair);
+    _prices[pair] = price;
+    _reach(pair);
+}
+
+std::map<std::string, double> SimulatedMarket::fees()
+{
+    std::lock_guard<std::mutex> lock(_mux);
+    return _fees;
+}
+
+std::vector<currency_pair_t> SimulatedMarket::pairs()
+{
+    _call("pairs");
+    std::lock_guard<std::mutex> lock(_mux);
+    std::vector<currency_pair_t> ret;
+    for (const auto& [pair, config] : _pairs) {
+        ret.push_back(pair);
+    }
+    return ret;
+}
+
+std::map<currency_pair_t, market_info_t> SimulatedMarket::info()
+{
+    _call("info");
+    std::lock_guard<std::mutex> lock(_mux);
+    std::map<currency_pair_t, market_info_t> ret;
+    for (const auto& [pair, config] : _pairs) {
+        ret[pair] = market_info_t{
+            .pair = pair,
+            .limit = config.limit,
+            .maker_fee = _config.maker_fee,
+            .taker_fee = _config.taker_fee,
+        };
+    }
+    return ret;
+}
+
+market_info_t SimulatedMarket::info(const currency_pair_t& pair)
+{
+    _call("info");
+    std::lock_guard<std::mutex> lock(_mux);
+    return market_info_t{
+        .pair = pair,
+        .limit = _pair(pair).limit,
+        .maker_fee = _config.maker_fee,
+        .taker_fee = _config.taker_fee,
+    };
+}
+
+std::map<std::string, double> SimulatedMarket::balance()
+{
+    _call("balance");
+    std::lock_guard<std::mutex> lock(_mux);
+    return _balances;
+}
+
+double SimulatedMarket::balance(const std::string& currency)
+{
+    _call("balance");
+    std::lock_guard<std::mutex> lock(_mux);
+    auto it = _balances.find(currency);
+    return it == _balances.end() ? 0 : it->second;
+}
+
+ticker_t SimulatedMarket::ticker(const currency_pair_t& pair)
+{
+    _call("ticker");
+    std::lock_guard<std::mutex> lock(_mux);
+    _step(pair);
+    return _ticker(pair);
+}
+
+std::vector<order_t> SimulatedMarket::closedOrders()
+{
+    _call("closedOrders");
+    std::lock_guard<std::mutex> lock(_mux);
+    return _closed;
+}
+
+std::vector<order_t> SimulatedMarket::openOrders()
+{
+    _call("openOrders");
+    std::lock_guard<std::mutex> lock(_mux);
+    std::vector<order_t> ret;
+    for (const auto& [txid, order] : _open) {
+        ret.push_back(order);
+    }
+    return ret;
+}
+
+void SimulatedMarket::place(order_t& order)
+{
+    _call("place");
+    std::lock_guard<std::mutex> lock(_mux);
+    auto limit = _pair(order.pair).limit;
+    if (order.volume <= 0 || order.volume < limit.min ||
+        order.volume > limit.max) {
+        throw at::response_error("SimulatedMarket::place: invalid volume " +
+                                 std::to_string(order.volume));
+    }
+    _step(order.pair);
+    auto ticker = _ticker(order.pair);
+    auto buy = order.action == at::order_action_t::buy;
+
+    // market orders and limit orders crossing the spread take the best
+    // price, the other limit orders wait for the price to reach them
+    auto taker = order.type == at::order_type_t::market ||
+                 (buy ? order.price >= ticker.ask.price
+                      : order.price <= ticker.bid.price);
+    auto price = taker ? (buy ? ticker.ask.price : ticker.bid.price)
+                       : order.price;
+    auto fee = taker ? _config.taker_fee : _config.maker_fee;
+
+    auto currency = buy ? order.pair.second : order.pair.first;
+    auto needed = buy ? order.volume * price * (1 + fee / 100) : order.volume;
+    if (_balances[currency] - _held[currency] < needed) {
+        throw at::response_error("SimulatedMarket::place: insufficient " +
+                                 currency + " funds");
+    }
+
+    order.txid = "SIM-" + std::to_string(++_txid);
+    if (taker) {
+        _fill(order, price, fee);
+        _closed.push_back(order);
+        return;
+    }
+    order.cost = order.volume * order.price;
+    _held[currency] += needed;
+    _open[order.txid] = order;
+}
+
+void SimulatedMarket::cancel(const order_t& order)
+{
+    _call("cancel");
+    std::lock_guard<std::mutex> lock(_mux);
+    auto it = _open.find(order.txid);
+    if (it == _open.end()) {
+        throw at::response_error("SimulatedMarket::cancel: unknown order " +
+                                 order.txid);
+    }
+    auto& open = it->second;
+    if (open.action == at::order_action_t::buy) {
+        _held[open.pair.second] -= open.cost * (1 + _config.maker_fee / 100);
+    }
+    else {
+        _held[open.pair.first] -= open.volume;
+    }
+    _closed.push_back(open);
+    _open.erase(it);
+}
+
+}  // end namespace atd
@@ -16,45 +16,44 @@
 
 namespace atd {
 
+bool SmallChanges::_tradable(const std::string &currency,
+                             const indicator_value_t &overall) const
+{
+    auto stats_period_ago = _clock->time() -
+        std::chrono::duration_cast<std::chrono::seconds>(_stats_period).count();
+    // after a downtime the extremes hold the samples of before it: they
+    // count only once there are new samples
+    return overall.samples > 0 && overall.time >= stats_period_ago &&
+           _monitors->samples(currency, stats_period_ago) > 8;
+}
+
 void SmallChanges::buy(const currency_pair_t &pair)
 {
+    // the highest 24h change in the stats period and in its last quarter
+    auto span =
+        std::chrono::duration_cast<std::chrono::seconds>(_stats_period).count();
+    auto window_max = _monitors->indicator(
+        pair.first, "percent_change_24h",
+        {.kind = indicator_kind_t::max, .span = span});
+    auto quarter_max = _monitors->indicator(
+        pair.first, "percent_change_24h",
+        {.kind = indicator_kind_t::max, .span = span / 4});
     while (true) {
-        auto stats_period_ago = std::chrono::system_clock::to_time_t(
-            std::chrono::system_clock::now() - _stats_period);
-
-        auto currency_history =
-            _monitors->currencyHistory(pair.first, stats_period_ago);
-
-        std::size_t chsize = static_cast<std::size_t>(currency_history.size());
-
-        if (chsize <= 8) {
-            std::this_thread::sleep_for(_trade_period);
+        auto overall = window_max->value();
+        if (!_tradable(pair.first, overall)) {
+            _clock->sleep_for(_trade_period);
             continue;
         }
 
         // if the last quarter of measurement are "big dip", bargain => buy
 
-        // BARGAIN
-        bool bargain = true;
-        std::size_t halfPeriod = chsize / 2;
-        std::size_t quarter = chsize / 4;
-        for (std::size_t i = halfPeriod + quarter; i < currency_history.size();
-             ++i) {
-            bargain = bargain && currency_history[i].percent_change_24h / 100 <=
-                                     -_dip_percentage;  // negate the margin of
-                                                        // profit makint it a
-                                                        // negative threshold
-        }
+        // BARGAIN: negate the margin of profit making it a negative
+        // threshold
+        bool bargain =
+            quarter_max->value().value / 100 <= -_dip_percentage;
 
-        bool longBearRun = false;
-        if (!bargain) {
-            // check if there's a downtrend in the overall window
-            longBearRun = true;
-            for (std::size_t i = 0; i < chsize; ++i) {
-                longBearRun =
-                    longBearRun && currency_history[i].percent_change_24h <= 0;
-            }
-        }
+        // check if there's a downtrend in the overall window
+        bool longBearRun = !bargain && overall.value <= 0;
 
         if (longBearRun || bargain) {
             // auto price_usd = currency_history[chsize - 1].price_usd;
@@ -73,40 +72,48 @@ void SmallChanges::buy(const currency_pair_t &pair)
             message.budget.base = _buy_quantity;
             message.order = order;
 
-            _chan->put(message);
-            std::cout << "[BUY] " << pair;
-            if (longBearRun) {
-                std::cout << " long bear run";
-            }
-            if (bargain) {
-                std::cout << " bargain";
-            }
-            std::cout << " messege putted. Waiting for feedback" << std::endl;
+            _send(message);
+            _logger->info("[BUY] {}{}{}: message sent. Waiting for feedback",
+                          pair, longBearRun ? " long bear run" : "",
+                          bargain ? " bargain" : "");
 
             feedback_t feedback;
             if (_feedback->get(feedback)) {
                 order = feedback.order;
                 auto market = feedback.market;
-                std::cout << "[BUY] feedback: " << order.txid << std::endl;
+                _logger->info("[BUY] feedback: {}", order.txid);
 
                 if (order.txid.length() > 0) {
+                    // the polling, up to the fill, ends the trace
+                    TraceScope scope(feedback.trace);
+                    Span span(feedback.trace, "fill");
                     bool closed = false;
                     while (!closed) {
-                        std::cout << "[BUY] checking for order: " << order.txid
-                                  << " fulfillment" << std::endl;
+                        _logger->debug(
+                            "[BUY] checking for order: {} fulfillment",
+                            order.txid);
                         closed = true;
                         std::vector<at::order_t> openOrders;
                         auto retry = true;
                         while (retry) {
                             try {
-                                openOrders = market->openOrders();
+                                openOrders = feedback.retrier->call(
+                                    "openOrders",
+                                    [&]() { return market->openOrders(); });
                                 retry = false;
                             }
                             catch (const at::server_error &e) {
-                                std::cout << "smallchanges: market->openOrders "
-                                          << e.what() << "\n sleep and retry";
+                                _logger->warn(
+                                    "market->openOrders: {}. Sleep and retry",
+                                    e.what());
+                                retry = true;
+                                _clock->sleep_for(1min);
+                            }
+                            catch (const circuit_open &e) {
+                                _logger->warn("{}. Sleep and retry",
+                                              e.what());
                                 retry = true;
-                                std::this_thread::sleep_for(1min);
+                                _clock->sleep_for(1min);
                             }
                         }
                         for (const auto &openOrder : openOrders) {
@@ -116,14 +123,14 @@ void SmallChanges::buy(const currency_pair_t &pair)
                             }
                         }
                         if (!closed) {
-                            std::cout << "[BUY] order not closed, "
-                                         "sleepting for 1min\n";
+                            _logger->debug(
+                                "[BUY] order not closed, sleeping for 1min");
 
-                            std::this_thread::sleep_for(1min);
+                            _clock->sleep_for(1min);
                         }
                     }
 
-                    std::cout << "[BUY] order fulfilled!\n";
+                    _logger->info("[BUY] order fulfilled!");
                     _bought = true;
                     _price = std::max(order.price, _price);
 
@@ -132,87 +139,53 @@ void SmallChanges::buy(const currency_pair_t &pair)
                     // some hours in order to measure a lot of snapshot of
                     // the market and do not place equals order in a short
                     // period of time
-                    std::this_thread::sleep_for(12h);
+                    _clock->sleep_for(12h);
                 }
             }
         }
 
-        std::this_thread::sleep_for(_trade_period);
+        _clock->sleep_for(_trade_period);
     }
 }
 
 void SmallChanges::sell(const currency_pair_t &pair)
 {
+    // the lowest 24h change in the stats period and in its last quarter
+    auto span =
+        std::chrono::duration_cast<std::chrono::seconds>(_stats_period).count();
+    auto window_min = _monitors->indicator(
+        pair.first, "percent_change_24h",
+        {.kind = indicator_kind_t::min, .span = span});
+    auto quarter_min = _monitors->indicator(
+        pair.first, "percent_change_24h",
+        {.kind = indicator_kind_t::min, .span = span / 4});
     while (true) {
-        auto stats_period_ago = std::chrono::system_clock::to_time_t(
-            std::chrono::system_clock::now() - _stats_period);
-
-        auto currency_history =
-            _monitors->currencyHistory(pair.first, stats_period_ago);
-
-        std::size_t chsize = static_cast<std::size_t>(currency_history.size());
-
-        if (chsize <= 8) {
-            std::this_thread::sleep_for(_trade_period);
+        auto overall = window_min->value();
+        if (!_tradable(pair.first, overall)) {
+            _clock->sleep_for(_trade_period);
             continue;
         }
 
-        // BARGAIN
-        bool spike = true;
-        std::size_t halfPeriod = chsize / 2;
-        std::size_t quarter = chsize / 4;
-        for (std::size_t i = halfPeriod + quarter; i < currency_history.size();
-             ++i) {
-            spike = spike && currency_history[i].percent_change_24h / 100 >=
-                                 _margin_profit_percentage;
-        }
-
-        bool longBullRun = false;
+        // SPIKE
+        bool spike =
+            quarter_min->value().value / 100 >= _margin_profit_percentage;
 
-        if (!spike) {
-            // check if there's a downtrend in the overall window
-            longBullRun = true;
-            for (std::size_t i = 0; i < chsize; ++i) {
-                longBullRun =
-                    longBullRun && currency_history[i].percent_change_24h > 0;
-            }
-        }
+        // check if there's an uptrend in the overall window
+        bool longBullRun = !spike && overall.value > 0;
 
         bool canComparePrice = false;
-        auto price_usd = currency_history[chsize - 1].price_usd;
+        double price_usd = 0;
         auto quote = pair.second;
         double quote_usd_ratio = 0;
-        // is fiat
         try {
-            quote_usd_ratio = _fiat.rate(at::currency_pair_t(quote, "usd"));
+            // latest ingested price
+            price_usd = _monitors->rates()->rate(pair.first, "usd");
+            // how many quote for 1 usd
+            quote_usd_ratio = _monitors->rates()->rate("usd", quote);
             canComparePrice = true;
         }
         catch (const std::out_of_range &) {
-            // if here is not fiat, let's say is xrp/eth
-            auto oneHourAgo = std::chrono::system_clock::to_time_t(
-                std::chrono::system_clock::now() - 1h);
-            auto ph = _monitors->pairHistory(at::currency_pair_t(quote, "usd"),
-                                             oneHourAgo);
-            if (ph.size() > 0) {
-                // There's the pair quote, usd stored
-                // find the market with the highest volume, pick the price in
-                // usd from there
-                size_t max_id = 0;
-                long long max_volume = 0;
-                for (size_t i = 0; i < ph.size(); ++i) {
-                    if (ph[i].day_volume_usd > max_volume) {
-                        max_volume = ph[i].day_volume_usd;
-                        max_id = i;
-                    }
-                }
-                if (max_volume > 0) {
-                    // price usd = usd/eth
-                    auto price_usd = ph[max_id].price_usd;
-                    // hence eth/usd ratio = 1/price_usd
-                    quote_usd_ratio = 1. / price_usd;
-                    canComparePrice = true;
-                }
-            }
+            // quote is neither a monitored currency nor a fiat one
         }
 
         auto price_quote = price_usd * quote_usd_ratio;
@@ -222,18 +195,10 @@ void SmallChanges::sell(const currency_pair_t &pair)
             price_quote >= _price * (1. + _margin_profit_percentage);
 
         if (takeProfit || spike || longBullRun) {
-            std::cout << "[SELL]" << pair;
-            if (takeProfit) {
-                std::cout << " take profit";
-            }
-            if (spike) {
-                std::cout << " spike";
-            }
-            if (longBullRun) {
-                std::cout << " long bull run";
-            }
-
-            std::cout << std::endl;
+            _logger->info("[SELL] {}{}{}{}", pair,
+                          takeProfit ? " take profit" : "",
+                          spike ? " spike" : "",
+                          longBullRun ? " long bull run" : "");
             atd::message_t message = {};
             message.feedback = _feedback;
 
@@ -251,33 +216,46 @@ void SmallChanges::sell(const currency_pair_t &pair)
             message.budget.base = _sell_quantity;
             message.order = order;
 
-            _chan->put(message);
+            _send(message);
 
             feedback_t feedback;
             if (_feedback->get(feedback)) {
                 order = feedback.order;
                 auto market = feedback.market;
-                std::cout << "[SELL] feedback: " << order.txid << std::endl;
+                _logger->info("[SELL] feedback: {}", order.txid);
 
                 if (order.txid.length() > 0) {
+                    // the polling, up to the fill, ends the trace
+                    TraceScope scope(feedback.trace);
+                    Span span(feedback.trace, "fill");
                     bool closed = false;
                     while (!closed) {
-                        std::cout << "[SELL] checking for order: " << order.txid
-                                  << " fulfillment" << std::endl;
+                        _logger->debug(
+                            "[SELL] checking for order: {} fulfillment",
+                            order.txid);
 
                         closed = true;
                         std::vector<at::order_t> openOrders;
                         auto retry = true;
                         while (retry) {
                             try {
-                                openOrders = market->openOrders();
+                                openOrders = feedback.retrier->call(
+                                    "openOrders",
+                                    [&]() { return market->openOrders(); });
                                 retry = false;
                             }
                             catch (const at::server_error &e) {
-                                std::cout << "smallchanges: market->openOrders "
-                                          << e.what() << "\n sleep and retry";
+                                _logger->warn(
+                                    "market->openOrders: {}. Sleep and retry",
+                                    e.what());
+                                retry = true;
+                                _clock->sleep_for(1min);
+                            }
+                            catch (const circuit_open &e) {
+                                _logger->warn("{}. Sleep and retry",
+                                              e.what());
                                 retry = true;
-                                std::this_thread::sleep_for(1min);
+                                _clock->sleep_for(1min);
                             }
                         }
                         for (const auto &openOrder : openOrders) {
@@ -287,15 +265,14 @@ void SmallChanges::sell(const currency_pair_t &pair)
                             }
                         }
                         if (!closed) {
-                            std::cout << "[SELL] order not closed, "
-                                         "sleepting for 1min"
-                                      << std::endl;
+                            _logger->debug(
+                                "[SELL] order not closed, sleeping for 1min");
 
-                            std::this_thread::sleep_for(1min);
+                            _clock->sleep_for(1min);
                         }
                     }
 
-                    std::cout << "[SELL] order fulfilled!" << std::endl;
+                    _logger->info("[SELL] order fulfilled!");
                     if (takeProfit) {
                         _bought = false;
                         _price = 0;
@@ -306,13 +283,12 @@ void SmallChanges::sell(const currency_pair_t &pair)
                     // some hours in order to measure a lot of snapshot of
                     // the market and do not place equals order in a short
                     // period of time
-                    std::this_thread::sleep_for(spike || longBullRun ? 12h
-                                                                     : 2h);
+                    _clock->sleep_for(spike || longBullRun ? 12h : 2h);
                 }
             }
         }
 
-        std::this_thread::sleep_for(_trade_period);
+        _clock->sleep_for(_trade_period);
     }
 }
 
@@ -0,0 +1,80 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <atd/statementcache.hpp>
+
+namespace atd {
+
+StatementCache::lease StatementCache::acquire(const std::string& sql)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        auto& idle = _idle[sql];
+        if (!idle.empty()) {
+            auto statement = std::move(idle.back());
+            idle.pop_back();
+            return lease(this, sql, std::move(statement));
+        }
+    }
+
+    // Compile outside the lock: other threads can keep leasing the
+    // statements already prepared
+    auto start = std::chrono::steady_clock::now();
+    auto statement = std::make_unique<SQLite::Statement>(*_db, sql);
+    _prepare_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    ++_prepared;
+    return lease(this, sql, std::move(statement));
+}
+
+void StatementCache::_release(const std::string& sql,
+                              std::unique_ptr<SQLite::Statement> statement,
+                              std::chrono::steady_clock::time_point leased_at)
+    noexcept
+{
+    _execute_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - leased_at)
+                       .count();
+    ++_executed;
+
+    // A SELECT not reset keeps its read transaction open, blocking the
+    // writers of the monitor threads: always reset before caching.
+    // This runs in the lease destructor, hence it must never throw: reset
+    // reports the error of the last step (e.g. SQLITE_BUSY), in that case
+    // the statement is finalized instead of being cached.
+    if (statement->tryReset() != SQLite::OK) {
+        return;
+    }
+    try {
+        statement->clearBindings();
+        std::lock_guard<std::mutex> lock(_mux);
+        _idle[sql].push_back(std::move(statement));
+    }
+    catch (...) {
+        // dropped: the next acquire prepares a new one
+    }
+}
+
+statement_stats_t StatementCache::stats() const
+{
+    return statement_stats_t{
+        .prepared = _prepared,
+        .executed = _executed,
+        .prepare_time = std::chrono::nanoseconds(_prepare_ns),
+        .execute_time = std::chrono::nanoseconds(_execute_ns),
+    };
+}
+
+}  // end namespace atd
@@ -0,0 +1,203 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <atd/stats/CorrelationMatrix.hpp>
+#include <atd/stats/kernels.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace atd::stats {
+
+// assets per side of the tiles of pairs computed by a thread: the columns
+// of a tile stay in cache while its pairs are computed
+static constexpr std::size_t _tile = 16;
+
+CorrelationMatrix::CorrelationMatrix(std::size_t assets, std::size_t window)
+    : _assets(assets),
+      _window(window),
+      _count(0),
+      _next(0),
+      _pushes(0),
+      _rows(assets * window),
+      _shift(assets, 0),
+      _sums(assets, 0),
+      _products(assets * assets, 0),
+      _added(assets, 0),
+      _removed(assets, 0)
+{
+    if (window < 2) {
+        throw std::invalid_argument(
+            "CorrelationMatrix: the window must have at least 2 rows");
+    }
+}
+
+// _build computes the sums from rows values of every asset, stored column by
+// column
+void CorrelationMatrix::_build(const std::vector<const double *> &columns,
+                               std::size_t rows, unsigned threads)
+{
+    for (std::size_t i = 0; i < _assets; ++i) {
+        _shift[i] = rows > 0 ? columns[i][0] : 0;
+    }
+    // the tiles of the upper triangle of the matrix
+    std::vector<std::pair<std::size_t, std::size_t>> tiles;
+    for (std::size_t a = 0; a < _assets; a += _tile) {
+        for (std::size_t b = a; b < _assets; b += _tile) {
+            tiles.emplace_back(a, b);
+        }
+    }
+    const auto &kernel = kernels<double>();
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]() {
+        double sums[5];
+        for (auto k = next++; k < tiles.size(); k = next++) {
+            auto [a, b] = tiles[k];
+            for (auto i = a; i < std::min(a + _tile, _assets); ++i) {
+                for (auto j = std::max(b, i); j < std::min(b + _tile, _assets);
+                     ++j) {
+                    kernel.comoments(columns[i], columns[j], rows, _shift[i],
+                                     _shift[j], sums);
+                    _products[i * _assets + j] = sums[4];
+                    _products[j * _assets + i] = sums[4];
+                    if (i == j) {
+                        _sums[i] = sums[0];
+                    }
+                }
+            }
+        }
+    };
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min<std::size_t>(threads, tiles.size());
+    if (threads <= 1) {
+        worker();
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back(worker);
+    }
+    for (auto &thread : workers) {
+        thread.join();
+    }
+}
+
+// _rebuild recomputes the sums from the rows in the window
+void CorrelationMatrix::_rebuild()
+{
+    column_t<double> transposed(_assets * _count);
+    std::vector<const double *> columns(_assets);
+    for (std::size_t i = 0; i < _assets; ++i) {
+        for (std::size_t r = 0; r < _count; ++r) {
+            transposed[i * _count + r] = _rows[r * _assets + i];
+        }
+        columns[i] = transposed.data() + i * _count;
+    }
+    _build(columns, _count, 1);
+    _pushes = 0;
+}
+
+void CorrelationMatrix::build(const std::vector<column_view<double>> &columns,
+                              unsigned threads)
+{
+    if (columns.size() != _assets) {
+        throw std::invalid_argument(
+            "CorrelationMatrix: " + std::to_string(columns.size()) +
+            " columns for " + std::to_string(_assets) + " assets");
+    }
+    auto size = columns.empty() ? 0 : columns[0].size();
+    for (const auto &column : columns) {
+        if (column.size() != size) {
+            throw std::invalid_argument(
+                "CorrelationMatrix: columns of different sizes");
+        }
+    }
+    _count = std::min(size, _window);
+    _next = _count % _window;
+    _pushes = 0;
+    std::vector<const double *> last(_assets);
+    for (std::size_t i = 0; i < _assets; ++i) {
+        last[i] = columns[i].last(_count).data();
+        for (std::size_t r = 0; r < _count; ++r) {
+            _rows[r * _assets + i] = last[i][r];
+        }
+    }
+    _build(last, _count, threads);
+}
+
+void CorrelationMatrix::push(const double *row)
+{
+    auto n = _assets;
+    double *evicted = _rows.data() + _next * n;
+    for (std::size_t i = 0; i < n; ++i) {
+        _added[i] = row[i] - _shift[i];
+        _removed[i] = _count == _window ? evicted[i] - _shift[i] : 0;
+        _sums[i] += _added[i] - _removed[i];
+    }
+    // rank-one update with the new row and downdate with the evicted one
+    const double *added = _added.data(), *removed = _removed.data();
+    for (std::size_t i = 0; i < n; ++i) {
+        double *products = _products.data() + i * n;
+        auto a = added[i], r = removed[i];
+        for (std::size_t j = 0; j < n; ++j) {
+            products[j] += a * added[j] - r * removed[j];
+        }
+    }
+    std::copy(row, row + n, evicted);
+    _next = (_next + 1) % _window;
+    if (_count < _window) {
+        ++_count;
+    }
+    if (++_pushes >= _window) {
+        _rebuild();
+    }
+}
+
+double CorrelationMatrix::correlation(std::size_t i, std::size_t j) const
+{
+    if (_count < 2) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    double n = _count;
+    auto covariance = _products[i * _assets + j] - _sums[i] * _sums[j] / n;
+    auto variance_i = _products[i * _assets + i] - _sums[i] * _sums[i] / n;
+    auto variance_j = _products[j * _assets + j] - _sums[j] * _sums[j] / n;
+    if (!(variance_i > 0 && variance_j > 0)) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    // rounding can push it slightly out of [-1, 1]
+    return std::clamp(covariance / std::sqrt(variance_i * variance_j), -1.,
+                      1.);
+}
+
+std::vector<double> CorrelationMatrix::matrix() const
+{
+    std::vector<double> ret(_assets * _assets);
+    for (std::size_t i = 0; i < _assets; ++i) {
+        for (std::size_t j = 0; j < _assets; ++j) {
+            ret[i * _assets + j] = correlation(i, j);
+        }
+    }
+    return ret;
+}
+
+}  // namespace atd::stats
@@ -0,0 +1,95 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <atd/stats/FFT.hpp>
+#include <cmath>
+#include <stdexcept>
+
+namespace atd::stats {
+
+FFT::FFT(std::size_t size) : _size(size)
+{
+    if (size == 0 || (size & (size - 1)) != 0) {
+        throw std::invalid_argument("atd::stats::FFT: size " +
+                                    std::to_string(size) +
+                                    " is not a power of 2");
+    }
+    _twiddles.resize(size / 2);
+    for (std::size_t i = 0; i < size / 2; ++i) {
+        _twiddles[i] = std::polar(1.0, -2 * M_PI * i / size);
+    }
+    std::size_t bits = 0;
+    while ((std::size_t(1) << bits) < size) {
+        ++bits;
+    }
+    _reversed.resize(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        std::size_t reversed = 0;
+        for (std::size_t b = 0; b < bits; ++b) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        _reversed[i] = reversed;
+    }
+}
+
+void FFT::_transform(std::vector<std::complex<double>> &data,
+                     bool inverse) const
+{
+    if (data.size() != _size) {
+        throw std::invalid_argument("atd::stats::FFT: expected " +
+                                    std::to_string(_size) + " items, got " +
+                                    std::to_string(data.size()));
+    }
+    for (std::size_t i = 0; i < _size; ++i) {
+        if (i < _reversed[i]) {
+            std::swap(data[i], data[_reversed[i]]);
+        }
+    }
+    for (std::size_t half = 1; half < _size; half *= 2) {
+        // stride in the twiddles of the size N transform
+        auto stride = _size / (2 * half);
+        for (std::size_t start = 0; start < _size; start += 2 * half) {
+            for (std::size_t k = 0; k < half; ++k) {
+                // products written out: std::complex checks for NaNs
+                auto tr = _twiddles[k * stride].real();
+                auto ti = inverse ? -_twiddles[k * stride].imag()
+                                  : _twiddles[k * stride].imag();
+                auto &even = data[start + k];
+                auto &odd = data[start + k + half];
+                double r = odd.real() * tr - odd.imag() * ti;
+                double i = odd.real() * ti + odd.imag() * tr;
+                odd = std::complex<double>(even.real() - r, even.imag() - i);
+                even = std::complex<double>(even.real() + r, even.imag() + i);
+            }
+        }
+    }
+    if (inverse) {
+        for (auto &x : data) {
+            x /= static_cast<double>(_size);
+        }
+    }
+}
+
+void FFT::forward(std::vector<std::complex<double>> &data) const
+{
+    _transform(data, false);
+}
+
+void FFT::inverse(std::vector<std::complex<double>> &data) const
+{
+    _transform(data, true);
+}
+
+}  // namespace atd::stats
@@ -0,0 +1,217 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <atd/stats/GaussianSmoothing.hpp>
+#include <atd/stats/namespace.hpp>
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace atd::stats {
+
+// kernels kept in the cache, the least recently used is dropped first
+static constexpr std::size_t _cached_kernels = 64;
+// The direct convolution costs ~0.6ns per tap and vector lane for every
+// value, the overlap-add 30-40ns whatever the length: kernels longer than
+// this many taps per lane are convolved by FFT
+static constexpr std::size_t _fft_taps_per_lane = 48;
+// series shorter than this many kernels are always convolved directly: the
+// FFT blocks would be mostly padding
+static constexpr std::size_t _fft_min_kernels = 4;
+
+static std::mutex _kernels_mux;
+static std::list<std::pair<std::pair<std::size_t, double>,
+                           std::shared_ptr<const GaussianSmoothing::kernel_t>>>
+    _kernels;
+
+// _fft_size returns the transform size for a kernel of length taps: a power
+// of 2 at least 4 times length, so that every block carries 3 times more
+// new samples than padding
+static std::size_t _fft_size(std::size_t length)
+{
+    std::size_t size = 1;
+    while (size < 4 * length) {
+        size *= 2;
+    }
+    return size;
+}
+
+// _quantize rounds sigma to 8 significant bits: a sigma computed from the
+// data (a standard deviation) changes at every call, the kernels of sigmas
+// that close are the same but for rounding
+static double _quantize(double sigma)
+{
+    int exponent;
+    auto mantissa = std::frexp(sigma, &exponent);
+    return std::ldexp(std::round(std::ldexp(mantissa, 8)), exponent - 8);
+}
+
+std::shared_ptr<const GaussianSmoothing::kernel_t> GaussianSmoothing::kernel(
+    std::size_t length, double sigma)
+{
+    sigma = _quantize(sigma);
+    auto key = std::pair(length, sigma);
+    // the taps are length exponentials, cheap enough to be built under the
+    // lock: threads asking for the same new key build it once
+    std::lock_guard<std::mutex> lock(_kernels_mux);
+    for (auto it = _kernels.begin(); it != _kernels.end(); ++it) {
+        if (it->first == key) {
+            _kernels.splice(_kernels.begin(), _kernels, it);
+            return it->second;
+        }
+    }
+
+    auto built = std::make_shared<kernel_t>();
+    built->taps = gaussian1d(length, sigma);
+    _kernels.push_front(std::pair(key, built));
+    if (_kernels.size() > _cached_kernels) {
+        _kernels.pop_back();
+    }
+    return built;
+}
+
+// _spectrum returns the spectrum of kernel, transforming it the first time
+static const GaussianSmoothing::spectrum_t &_spectrum(
+    const GaussianSmoothing::kernel_t &kernel)
+{
+    std::call_once(kernel.transformed, [&kernel]() {
+        const auto &taps = kernel.taps;
+        FFT fft(_fft_size(taps.size()));
+        std::vector<std::complex<double>> spectrum(fft.size());
+        std::copy(taps.begin(), taps.end(), spectrum.begin());
+        fft.forward(spectrum);
+        kernel.spectrum.emplace(GaussianSmoothing::spectrum_t{
+            .fft = std::move(fft),
+            .spectrum = std::move(spectrum),
+        });
+    });
+    return *kernel.spectrum;
+}
+
+GaussianSmoothing::GaussianSmoothing(std::size_t length, double sigma)
+    : _kernel(kernel(length, sigma)),
+      _window(2 * length),
+      _next(0),
+      _pushed(0)
+{
+}
+
+std::vector<double> GaussianSmoothing::_direct(column_view<double> series) const
+{
+    // the kernel is symmetric: the convolution is the correlation
+    const auto &taps = _kernel->taps;
+    std::vector<double> out(series.size() - taps.size() + 1);
+    kernels<double>().correlate(series.data(), series.size(), taps.data(),
+                                taps.size(), out.data());
+    return out;
+}
+
+std::vector<double> GaussianSmoothing::_overlap_add(
+    column_view<double> series) const
+{
+    const auto &transformed = _spectrum(*_kernel);
+    const auto &fft = transformed.fft;
+    const auto &spectrum = transformed.spectrum;
+    auto length = _kernel->taps.size();
+    auto size = fft.size();
+    // new samples per block, the rest of the block is the tail of the
+    // convolution
+    auto block = size - length + 1;
+    auto n = series.size();
+
+    // full convolution, n + length - 1 values
+    std::vector<double> full(n + length - 1, 0);
+    std::vector<std::complex<double>> data(size);
+    // two real blocks per transform: the first in the real part, the
+    // second in the imaginary one. The kernel is real, so they don't mix
+    for (std::size_t start = 0; start < n; start += 2 * block) {
+        std::fill(data.begin(), data.end(), std::complex<double>(0, 0));
+        auto second = start + block;
+        for (std::size_t i = 0; i < block && start + i < n; ++i) {
+            data[i].real(series[start + i]);
+        }
+        for (std::size_t i = 0; i < block && second + i < n; ++i) {
+            data[i].imag(series[second + i]);
+        }
+        fft.forward(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            // products written out: std::complex checks for NaNs
+            auto a = data[i], b = spectrum[i];
+            data[i] = std::complex<double>(
+                a.real() * b.real() - a.imag() * b.imag(),
+                a.real() * b.imag() + a.imag() * b.real());
+        }
+        fft.inverse(data);
+        for (std::size_t i = 0; i < size && start + i < full.size(); ++i) {
+            full[start + i] += data[i].real();
+        }
+        for (std::size_t i = 0; i < size && second + i < full.size(); ++i) {
+            full[second + i] += data[i].imag();
+        }
+    }
+    return std::vector<double>(full.begin() + length - 1, full.begin() + n);
+}
+
+std::vector<double> GaussianSmoothing::smooth(column_view<double> series) const
+{
+    auto length = _kernel->taps.size();
+    if (series.size() < length) {
+        return {};
+    }
+    std::size_t lanes = 1;
+    switch (kernels<double>().isa) {
+        case isa_t::sse2:
+            lanes = 2;
+            break;
+        case isa_t::avx2:
+            lanes = 4;
+            break;
+        case isa_t::avx512:
+            lanes = 8;
+            break;
+        default:
+            break;
+    }
+    if (length > _fft_taps_per_lane * lanes &&
+        series.size() >= _fft_min_kernels * length) {
+        return _overlap_add(series);
+    }
+    return _direct(series);
+}
+
+bool GaussianSmoothing::push(double sample, double &smoothed)
+{
+    auto length = _kernel->taps.size();
+    _window[_next] = _window[_next + length] = sample;
+    _next = (_next + 1) % length;
+    ++_pushed;
+    if (_pushed < length) {
+        return false;
+    }
+    // the oldest sample is at _next
+    kernels<double>().correlate(_window.data() + _next, length,
+                                _kernel->taps.data(), length, &smoothed);
+    return true;
+}
+
+void GaussianSmoothing::reset()
+{
+    _next = _pushed = 0;
+}
+
+}  // namespace atd::stats
@@ -0,0 +1,311 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <atd/stats/kernels.hpp>
+#include <cstring>
+#include <stdexcept>
+
+namespace atd::stats {
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ATD_STATS_X86
+#endif
+
+// The kernels are written once, on GCC vector extensions of the given size
+// in bytes, and built for every instruction set by the flattened wrappers
+// below: inlined in a function with a target attribute, the vector
+// operations are compiled with the instructions of that target.
+// Every kernel keeps independent accumulators for consecutive vectors, so
+// that the additions don't wait for each other.
+
+template <typename T, std::size_t bytes>
+[[gnu::always_inline]] inline void _moments(const T *x, std::size_t n,
+                                            T shift, T *out)
+{
+    typedef T vec __attribute__((vector_size(bytes)));
+    constexpr std::size_t width = bytes / sizeof(T);
+    vec k = vec{} + shift;
+    vec s0 = {}, s1 = {}, q0 = {}, q1 = {};
+    std::size_t i = 0;
+    for (; i + 2 * width <= n; i += 2 * width) {
+        vec a, b;
+        std::memcpy(&a, x + i, sizeof(vec));
+        std::memcpy(&b, x + i + width, sizeof(vec));
+        a -= k;
+        b -= k;
+        s0 += a;
+        s1 += b;
+        q0 += a * a;
+        q1 += b * b;
+    }
+    s0 += s1;
+    q0 += q1;
+    T sum = 0, sum_sq = 0;
+    for (std::size_t j = 0; j < width; ++j) {
+        sum += s0[j];
+        sum_sq += q0[j];
+    }
+    for (; i < n; ++i) {
+        T d = x[i] - shift;
+        sum += d;
+        sum_sq += d * d;
+    }
+    out[0] = sum;
+    out[1] = sum_sq;
+}
+
+template <typename T, std::size_t bytes>
+[[gnu::always_inline]] inline void _comoments(const T *x, const T *y,
+                                              std::size_t n, T x_shift,
+                                              T y_shift, T *out)
+{
+    typedef T vec __attribute__((vector_size(bytes)));
+    constexpr std::size_t width = bytes / sizeof(T);
+    vec kx = vec{} + x_shift, ky = vec{} + y_shift;
+    vec sx = {}, sy = {}, sxx = {}, syy = {}, sxy = {};
+    std::size_t i = 0;
+    for (; i + width <= n; i += width) {
+        vec a, b;
+        std::memcpy(&a, x + i, sizeof(vec));
+        std::memcpy(&b, y + i, sizeof(vec));
+        a -= kx;
+        b -= ky;
+        sx += a;
+        sy += b;
+        sxx += a * a;
+        syy += b * b;
+        sxy += a * b;
+    }
+    T sums[5] = {};
+    for (std::size_t j = 0; j < width; ++j) {
+        sums[0] += sx[j];
+        sums[1] += sy[j];
+        sums[2] += sxx[j];
+        sums[3] += syy[j];
+        sums[4] += sxy[j];
+    }
+    for (; i < n; ++i) {
+        T a = x[i] - x_shift, b = y[i] - y_shift;
+        sums[0] += a;
+        sums[1] += b;
+        sums[2] += a * a;
+        sums[3] += b * b;
+        sums[4] += a * b;
+    }
+    std::memcpy(out, sums, sizeof(sums));
+}
+
+template <typename T, std::size_t bytes>
+[[gnu::always_inline]] inline void _correlate(const T *signal, std::size_t n,
+                                              const T *taps,
+                                              std::size_t taps_size, T *out)
+{
+    typedef T vec __attribute__((vector_size(bytes)));
+    constexpr std::size_t width = bytes / sizeof(T);
+    if (taps_size == 0 || taps_size > n) {
+        return;
+    }
+    auto size = n - taps_size + 1;
+    std::size_t i = 0;
+    // blocks of 4 vectors of outputs, kept in registers across the taps
+    for (; i + 4 * width <= size; i += 4 * width) {
+        vec a0 = {}, a1 = {}, a2 = {}, a3 = {};
+        for (std::size_t t = 0; t < taps_size; ++t) {
+            vec tap = vec{} + taps[t];
+            vec v0, v1, v2, v3;
+            const T *s = signal + i + t;
+            std::memcpy(&v0, s, sizeof(vec));
+            std::memcpy(&v1, s + width, sizeof(vec));
+            std::memcpy(&v2, s + 2 * width, sizeof(vec));
+            std::memcpy(&v3, s + 3 * width, sizeof(vec));
+            a0 += tap * v0;
+            a1 += tap * v1;
+            a2 += tap * v2;
+            a3 += tap * v3;
+        }
+        std::memcpy(out + i, &a0, sizeof(vec));
+        std::memcpy(out + i + width, &a1, sizeof(vec));
+        std::memcpy(out + i + 2 * width, &a2, sizeof(vec));
+        std::memcpy(out + i + 3 * width, &a3, sizeof(vec));
+    }
+    for (; i + width <= size; i += width) {
+        vec a = {};
+        for (std::size_t t = 0; t < taps_size; ++t) {
+            vec v;
+            std::memcpy(&v, signal + i + t, sizeof(vec));
+            a += (vec{} + taps[t]) * v;
+        }
+        std::memcpy(out + i, &a, sizeof(vec));
+    }
+    for (; i < size; ++i) {
+        T a = 0;
+        for (std::size_t t = 0; t < taps_size; ++t) {
+            a += taps[t] * signal[i + t];
+        }
+        out[i] = a;
+    }
+}
+
+// ATD_STATS_BUILD defines the kernels of an instruction set, in namespace
+// name, compiled for the target features with vectors of bytes
+#define ATD_STATS_BUILD(name, features, bytes)                                 \
+    namespace name {                                                         \
+    template <typename T>                                                    \
+    __attribute__((target(features), flatten)) void moments(                   \
+        const T *x, std::size_t n, T shift, T *out)                          \
+    {                                                                        \
+        _moments<T, bytes>(x, n, shift, out);                                \
+    }                                                                        \
+    template <typename T>                                                    \
+    __attribute__((target(features), flatten)) void comoments(                 \
+        const T *x, const T *y, std::size_t n, T x_shift, T y_shift, T *out) \
+    {                                                                        \
+        _comoments<T, bytes>(x, y, n, x_shift, y_shift, out);                \
+    }                                                                        \
+    template <typename T>                                                    \
+    __attribute__((target(features), flatten)) void correlate(                 \
+        const T *signal, std::size_t n, const T *taps,                       \
+        std::size_t taps_size, T *out)                                       \
+    {                                                                        \
+        _correlate<T, bytes>(signal, n, taps, taps_size, out);               \
+    }                                                                        \
+    }
+
+// scalar: plain loops, left to the optimizer of the target
+namespace scalar {
+template <typename T>
+void moments(const T *x, std::size_t n, T shift, T *out)
+{
+    T sum = 0, sum_sq = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        T d = x[i] - shift;
+        sum += d;
+        sum_sq += d * d;
+    }
+    out[0] = sum;
+    out[1] = sum_sq;
+}
+template <typename T>
+void comoments(const T *x, const T *y, std::size_t n, T x_shift, T y_shift,
+               T *out)
+{
+    T sums[5] = {};
+    for (std::size_t i = 0; i < n; ++i) {
+        T a = x[i] - x_shift, b = y[i] - y_shift;
+        sums[0] += a;
+        sums[1] += b;
+        sums[2] += a * a;
+        sums[3] += b * b;
+        sums[4] += a * b;
+    }
+    std::memcpy(out, sums, sizeof(sums));
+}
+template <typename T>
+void correlate(const T *signal, std::size_t n, const T *taps,
+               std::size_t taps_size, T *out)
+{
+    if (taps_size == 0 || taps_size > n) {
+        return;
+    }
+    for (std::size_t i = 0; i < n - taps_size + 1; ++i) {
+        T a = 0;
+        for (std::size_t t = 0; t < taps_size; ++t) {
+            a += taps[t] * signal[i + t];
+        }
+        out[i] = a;
+    }
+}
+}  // namespace scalar
+
+#ifdef ATD_STATS_X86
+ATD_STATS_BUILD(sse2, "sse2", 16)
+ATD_STATS_BUILD(avx2, "avx2,fma", 32)
+ATD_STATS_BUILD(avx512, "avx512f", 64)
+#endif
+
+bool supported(isa_t isa)
+{
+    switch (isa) {
+        case isa_t::scalar:
+            return true;
+#ifdef ATD_STATS_X86
+        case isa_t::sse2:
+            return __builtin_cpu_supports("sse2");
+        case isa_t::avx2:
+            return __builtin_cpu_supports("avx2") &&
+                   __builtin_cpu_supports("fma");
+        case isa_t::avx512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+isa_t best_isa()
+{
+    for (auto isa : {isa_t::avx512, isa_t::avx2, isa_t::sse2}) {
+        if (supported(isa)) {
+            return isa;
+        }
+    }
+    return isa_t::scalar;
+}
+
+const char *isa_name(isa_t isa)
+{
+    switch (isa) {
+        case isa_t::sse2:
+            return "sse2";
+        case isa_t::avx2:
+            return "avx2";
+        case isa_t::avx512:
+            return "avx512";
+        case isa_t::scalar:
+        default:
+            return "scalar";
+    }
+}
+
+template <typename T>
+const kernels_t<T> &kernels(isa_t isa)
+{
+    static const kernels_t<T> builds[] = {
+        {isa_t::scalar, scalar::moments<T>, scalar::comoments<T>,
+         scalar::correlate<T>},
+#ifdef ATD_STATS_X86
+        {isa_t::sse2, sse2::moments<T>, sse2::comoments<T>,
+         sse2::correlate<T>},
+        {isa_t::avx2, avx2::moments<T>, avx2::comoments<T>,
+         avx2::correlate<T>},
+        {isa_t::avx512, avx512::moments<T>, avx512::comoments<T>,
+         avx512::correlate<T>},
+#endif
+    };
+    if (supported(isa)) {
+        for (const auto &build : builds) {
+            if (build.isa == isa) {
+                return build;
+            }
+        }
+    }
+    throw std::invalid_argument(std::string("atd::stats::kernels: ") +
+                                isa_name(isa) + " not supported");
+}
+
+template const kernels_t<float> &kernels<float>(isa_t);
+template const kernels_t<double> &kernels<double>(isa_t);
+
+}  // namespace atd::stats
@@ -0,0 +1,154 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <curlpp/Exception.hpp>
+#include <atd/supervisor.hpp>
+#include <stdexcept>
+
+namespace atd {
+
+void Supervisor::supervise(const std::string& name,
+                           std::function<void(std::shared_ptr<Heartbeat>)> f)
+{
+    labels_t labels = {{"worker", name}};
+    worker_t worker = {
+        .name = name,
+        .heartbeat = std::make_shared<Heartbeat>(_config.stall_timeout),
+        .failures = std::make_shared<channel<std::exception_ptr>>(),
+        .restarts = _metrics->counter("atd_worker_restarts_total",
+                                      "Restarts of the worker after a failure",
+                                      labels),
+        .stalled = _metrics->gauge(
+            "atd_worker_stalled", "1 if the heartbeat of the worker stopped",
+            labels),
+    };
+    auto heartbeat = worker.heartbeat;
+    _metrics->gauge(
+        "atd_worker_heartbeat_overdue_seconds",
+        "Time since the heartbeat of the worker was due, negative if alive",
+        labels, [heartbeat]() {
+            return std::chrono::duration<double>(heartbeat->overdue())
+                .count();
+        });
+
+    std::lock_guard<std::mutex> lock(_mux);
+    _workers.push_back(worker);
+    _threads.push_back(std::thread([this, worker, f]() {
+        _console_logger->info("Supervisor: started {}", worker.name);
+        Backoff backoff(_restart_policy);
+        while (true) {
+            auto start = std::chrono::steady_clock::now();
+            worker.heartbeat->beat();
+            try {
+                f(worker.heartbeat);
+                throw std::logic_error("worker returned");
+            }
+            catch (...) {
+                worker.failures->put(std::current_exception());
+            }
+            worker.restarts->inc();
+
+            // A worker that ran longer than the max delay failed for a new
+            // reason: start again from the shortest delay
+            if (std::chrono::steady_clock::now() - start >
+                _restart_policy.max_delay) {
+                backoff.reset();
+            }
+            auto delay = backoff.next();
+            worker.heartbeat->idle(delay);
+            std::this_thread::sleep_for(delay);
+        }
+    }));
+}
+
+void Supervisor::_log(const worker_t& worker, std::exception_ptr failure)
+{
+    try {
+        std::rethrow_exception(failure);
+    }
+    catch (const at::response_error& e) {
+        // pair unavailable for trade, for instance
+        _error_logger->error("{}: at::response_error: {}", worker.name,
+                             e.what());
+    }
+    catch (const at::server_error& e) {
+        _error_logger->error("{}: at::server_error: {}", worker.name,
+                             e.what());
+    }
+    catch (const circuit_open& e) {
+        _error_logger->error("{}: {}", worker.name, e.what());
+    }
+    catch (const curlpp::RuntimeError& e) {
+        _error_logger->error("{}: curlpp::RuntimeError: {}", worker.name,
+                             e.what());
+    }
+    catch (const curlpp::LogicError& e) {
+        _error_logger->error("{}: curlpp::LogicError: {}", worker.name,
+                             e.what());
+    }
+    catch (const std::logic_error& e) {
+        _error_logger->error("{}: std::logic_error: {}", worker.name,
+                             e.what());
+    }
+    catch (const std::runtime_error& e) {
+        _error_logger->error("{}: std::runtime_error: {}", worker.name,
+                             e.what());
+    }
+    catch (const std::exception& e) {
+        _error_logger->error("{}: std::exception: {}", worker.name, e.what());
+    }
+    catch (...) {
+        _error_logger->error("{}: unknown failure", worker.name);
+    }
+}
+
+void Supervisor::_check(const worker_t& worker)
+{
+    auto overdue = worker.heartbeat->overdue();
+    auto stalled = overdue > std::chrono::steady_clock::duration::zero();
+    auto was_stalled = worker.stalled->value() > 0;
+    if (stalled && !was_stalled) {
+        _error_logger->error(
+            "{}: stalled: no heartbeat for {}s", worker.name,
+            std::chrono::duration_cast<std::chrono::seconds>(
+                worker.heartbeat->timeout() + overdue)
+                .count());
+    }
+    else if (!stalled && was_stalled) {
+        _console_logger->info("Supervisor: {} recovered", worker.name);
+    }
+    worker.stalled->set(stalled ? 1 : 0);
+}
+
+void Supervisor::run()
+{
+    while (true) {
+        std::vector<worker_t> workers;
+        {
+            std::lock_guard<std::mutex> lock(_mux);
+            workers = _workers;
+        }
+        for (const auto& worker : workers) {
+            std::exception_ptr failure;
+            while (worker.failures->get(failure, false)) {
+                _log(worker, failure);
+            }
+            _check(worker);
+        }
+        std::this_thread::sleep_for(_config.check_period);
+    }
+}
+
+}  // end namespace atd
@@ -0,0 +1,352 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <atd/tape.hpp>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+namespace atd {
+
+json encode(bool value) { return value; }
+json encode(double value) { return value; }
+json encode(const std::map<std::string, double>& values) { return values; }
+
+json encode(const currency_pair_t& pair)
+{
+    return json::array({pair.first, pair.second});
+}
+
+json encode(const cm_ticker_t& tick)
+{
+    return json{
+        {"symbol", tick.symbol},
+        {"price_usd", tick.price_usd},
+        {"price_btc", tick.price_btc},
+        {"day_volume_usd", tick.day_volume_usd},
+        {"market_cap_usd", tick.market_cap_usd},
+        {"percent_change_1h", tick.percent_change_1h},
+        {"percent_change_24h", tick.percent_change_24h},
+        {"percent_change_7d", tick.percent_change_7d},
+        {"last_updated", tick.last_updated},
+    };
+}
+
+json encode(const cm_market_t& market)
+{
+    return json{
+        {"name", market.name},
+        {"pair", encode(market.pair)},
+        {"day_volume_usd", market.day_volume_usd},
+        {"price_usd", market.price_usd},
+        {"percent_volume", market.percent_volume},
+        {"last_updated", market.last_updated},
+    };
+}
+
+json encode(const market_info_t& info)
+{
+    return json{
+        {"pair", encode(info.pair)},
+        {"min", info.limit.min},
+        {"max", info.limit.max},
+        {"maker_fee", info.maker_fee},
+        {"taker_fee", info.taker_fee},
+    };
+}
+
+json encode(const ticker_t& ticker)
+{
+    return json{
+        {"pair", encode(ticker.pair)},
+        {"ask", {ticker.ask.price, ticker.ask.volume}},
+        {"bid", {ticker.bid.price, ticker.bid.volume}},
+    };
+}
+
+json encode(const order_t& order)
+{
+    return json{
+        {"txid", order.txid},
+        {"action", order.action == order_action_t::buy ? "buy" : "sell"},
+        {"pair", encode(order.pair)},
+        {"type", order.type == order_type_t::market ? "market" : "limit"},
+        {"volume", order.volume},
+        {"price", order.price},
+        {"cost", order.cost},
+    };
+}
+
+void decode(const json& obj, bool& value) { value = obj; }
+void decode(const json& obj, double& value) { value = obj; }
+void decode(const json& obj, std::map<std::string, double>& values)
+{
+    values = obj.get<std::map<std::string, double>>();
+}
+
+void decode(const json& obj, currency_pair_t& pair)
+{
+    pair = currency_pair_t(obj.at(0), obj.at(1));
+}
+
+void decode(const json& obj, cm_ticker_t& tick)
+{
+    tick.symbol = obj.at("symbol");
+    tick.price_usd = obj.at("price_usd");
+    tick.price_btc = obj.at("price_btc");
+    tick.day_volume_usd = obj.at("day_volume_usd");
+    tick.market_cap_usd = obj.at("market_cap_usd");
+    tick.percent_change_1h = obj.at("percent_change_1h");
+    tick.percent_change_24h = obj.at("percent_change_24h");
+    tick.percent_change_7d = obj.at("percent_change_7d");
+    tick.last_updated = obj.at("last_updated");
+}
+
+void decode(const json& obj, cm_market_t& market)
+{
+    market.name = obj.at("name");
+    decode(obj.at("pair"), market.pair);
+    market.day_volume_usd = obj.at("day_volume_usd");
+    market.price_usd = obj.at("price_usd");
+    market.percent_volume = obj.at("percent_volume");
+    market.last_updated = obj.at("last_updated");
+}
+
+void decode(const json& obj, market_info_t& info)
+{
+    decode(obj.at("pair"), info.pair);
+    info.limit.min = obj.at("min");
+    info.limit.max = obj.at("max");
+    info.maker_fee = obj.at("maker_fee");
+    info.taker_fee = obj.at("taker_fee");
+}
+
+void decode(const json& obj, ticker_t& ticker)
+{
+    decode(obj.at("pair"), ticker.pair);
+    ticker.ask.price = obj.at("ask").at(0);
+    ticker.ask.volume = obj.at("ask").at(1);
+    ticker.bid.price = obj.at("bid").at(0);
+    ticker.bid.volume = obj.at("bid").at(1);
+}
+
+void decode(const json& obj, order_t& order)
+{
+    order.txid = obj.at("txid");
+    order.action = obj.at("action") == "buy" ? order_action_t::buy
+                                             : order_action_t::sell;
+    decode(obj.at("pair"), order.pair);
+    order.type = obj.at("type") == "market" ? order_type_t::market
+                                            : order_type_t::limit;
+    order.volume = obj.at("volume");
+    order.price = obj.at("price");
+    order.cost = obj.at("cost");
+}
+
+Tape::Tape(const tape_config_t& config)
+    : _config(config), _start(std::chrono::steady_clock::now())
+{
+    if (_config.mode == tape_mode_t::record) {
+        // the times of the records are relative to the start of the run:
+        // records of another run can't be replayed after them
+        _out.open(_config.path, std::ios::binary | std::ios::trunc);
+        if (!_out) {
+            throw std::runtime_error("Tape: can't open " + _config.path);
+        }
+    }
+    else if (_config.mode == tape_mode_t::replay) {
+        _load();
+    }
+}
+
+void Tape::_load()
+{
+    std::ifstream in(_config.path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Tape: can't open " + _config.path);
+    }
+    unsigned char header[4];
+    while (in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        std::uint32_t size = header[0] | header[1] << 8 | header[2] << 16 |
+                             static_cast<std::uint32_t>(header[3]) << 24;
+        std::vector<std::uint8_t> bytes(size);
+        if (!in.read(reinterpret_cast<char*>(bytes.data()), size)) {
+            // truncated by a crash while recording: ignore the last record
+            break;
+        }
+        auto record = json::from_msgpack(bytes);
+        _records[record.at("c").get<std::string>()].push_back(record);
+    }
+}
+
+// _write appends the record, timestamped, to the tape
+void Tape::_write(json& record)
+{
+    record["t"] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - _start)
+                      .count();
+    auto bytes = json::to_msgpack(record);
+    auto size = static_cast<std::uint32_t>(bytes.size());
+    char header[4] = {
+        static_cast<char>(size & 0xff),
+        static_cast<char>((size >> 8) & 0xff),
+        static_cast<char>((size >> 16) & 0xff),
+        static_cast<char>((size >> 24) & 0xff),
+    };
+    std::lock_guard<std::mutex> lock(_mux);
+    _out.write(header, sizeof(header));
+    _out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    // a record must survive a crash: it's what we want to reproduce
+    _out.flush();
+}
+
+json Tape::_replay(const std::string& call)
+{
+    json record;
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        auto& records = _records[call];
+        if (records.empty()) {
+            throw std::runtime_error("Tape: no more recorded responses for " +
+                                     call);
+        }
+        record = records.front();
+        records.pop_front();
+    }
+    if (_config.original_pacing) {
+        std::this_thread::sleep_until(
+            _start + std::chrono::nanoseconds(record.at("t").get<long long>()));
+    }
+    if (record.contains("e")) {
+        std::string what = record.at("w");
+        if (record.at("e") == "server_error") {
+            throw at::server_error(what);
+        }
+        throw at::response_error(what);
+    }
+    return record.at("r");
+}
+
+json Tape::_call(const std::string& call, const std::function<json()>& live)
+{
+    if (_config.mode == tape_mode_t::replay) {
+        return _replay(call);
+    }
+    json record = {{"c", call}};
+    try {
+        record["r"] = live();
+    }
+    catch (const at::server_error& e) {
+        record["e"] = "server_error";
+        record["w"] = e.what();
+        _write(record);
+        throw;
+    }
+    catch (const at::response_error& e) {
+        record["e"] = "response_error";
+        record["w"] = e.what();
+        _write(record);
+        throw;
+    }
+    _write(record);
+    return record["r"];
+}
+
+void Tape::sleep_for(std::chrono::nanoseconds duration)
+{
+    if (_config.mode != tape_mode_t::replay) {
+        std::this_thread::sleep_for(duration);
+    }
+}
+
+std::vector<currency_pair_t> TapedMarket::pairs()
+{
+    return _tape->call(_name + "/pairs", [&]() { return _market->pairs(); });
+}
+
+std::map<currency_pair_t, market_info_t> TapedMarket::info()
+{
+    // the info contain their pair: record them as a list
+    auto infos = _tape->call(_name + "/info", [&]() {
+        std::vector<market_info_t> ret;
+        for (const auto& [pair, info] : _market->info()) {
+            ret.push_back(info);
+        }
+        return ret;
+    });
+    std::map<currency_pair_t, market_info_t> ret;
+    for (const auto& info : infos) {
+        ret[info.pair] = info;
+    }
+    return ret;
+}
+
+market_info_t TapedMarket::info(const currency_pair_t& pair)
+{
+    return _tape->call(_name + "/info/" + pair.first + "_" + pair.second,
+                       [&]() { return _market->info(pair); });
+}
+
+std::map<std::string, double> TapedMarket::balance()
+{
+    return _tape->call(_name + "/balance",
+                       [&]() { return _market->balance(); });
+}
+
+double TapedMarket::balance(const std::string& currency)
+{
+    return _tape->call(_name + "/balance/" + currency,
+                       [&]() { return _market->balance(currency); });
+}
+
+ticker_t TapedMarket::ticker(const currency_pair_t& pair)
+{
+    return _tape->call(_name + "/ticker/" + pair.first + "_" + pair.second,
+                       [&]() { return _market->ticker(pair); });
+}
+
+std::vector<order_t> TapedMarket::closedOrders()
+{
+    return _tape->call(_name + "/closedOrders",
+                       [&]() { return _market->closedOrders(); });
+}
+
+std::vector<order_t> TapedMarket::openOrders()
+{
+    return _tape->call(_name + "/openOrders",
+                       [&]() { return _market->openOrders(); });
+}
+
+void TapedMarket::place(order_t& order)
+{
+    // the market completes the order: record the completed one
+    auto action = order.action == order_action_t::buy ? "buy" : "sell";
+    order = _tape->call(_name + "/place/" + order.pair.first + "_" +
+                            order.pair.second + "/" + action,
+                        [&]() {
+                            auto placed = order;
+                            _market->place(placed);
+                            return placed;
+                        });
+}
+
+void TapedMarket::cancel(const order_t& order)
+{
+    _tape->call(_name + "/cancel/" + order.txid, [&]() {
+        _market->cancel(order);
+        return true;
+    });
+}
+
+}  // end namespace atd
@@ -0,0 +1,107 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+
+#include <atd/timeseries.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace atd {
+
+TimeSeries::TimeSeries(const std::vector<std::string>& columns)
+    : _names(columns), _columns(columns.size())
+{
+}
+
+TimeSeries::TimeSeries(const std::vector<std::string>& names,
+                       column_t<std::time_t> time,
+                       std::vector<column_t<double>> columns)
+    : _names(names), _time(std::move(time)), _columns(std::move(columns))
+{
+    if (_columns.size() != _names.size()) {
+        throw std::invalid_argument("TimeSeries: " +
+                                    std::to_string(_columns.size()) +
+                                    " columns for " +
+                                    std::to_string(_names.size()) + " names");
+    }
+    for (const auto& column : _columns) {
+        if (column.size() != _time.size()) {
+            throw std::invalid_argument(
+                "TimeSeries: columns of different sizes");
+        }
+    }
+    if (!std::is_sorted(_time.begin(), _time.end())) {
+        throw std::invalid_argument(
+            "TimeSeries: rows must be appended in time order");
+    }
+}
+
+void TimeSeries::reserve(std::size_t rows)
+{
+    _time.reserve(rows);
+    for (auto& column : _columns) {
+        column.reserve(rows);
+    }
+}
+
+void TimeSeries::_check(std::time_t time, std::size_t values) const
+{
+    if (values != _columns.size()) {
+        throw std::invalid_argument("TimeSeries: " + std::to_string(values) +
+                                    " values for " +
+                                    std::to_string(_columns.size()) +
+                                    " columns");
+    }
+    if (!_time.empty() && time < _time.back()) {
+        throw std::invalid_argument(
+            "TimeSeries: rows must be appended in time order");
+    }
+}
+
+void TimeSeries::append(std::time_t time,
+                        std::initializer_list<double> values)
+{
+    _check(time, values.size());
+    _time.push_back(time);
+    auto column = _columns.begin();
+    for (const auto& value : values) {
+        column->push_back(value);
+        ++column;
+    }
+}
+
+void TimeSeries::append(std::time_t time, const std::vector<double>& values)
+{
+    _check(time, values.size());
+    _time.push_back(time);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        _columns[i].push_back(values[i]);
+    }
+}
+
+column_view<double> TimeSeries::column(const std::string& name) const
+{
+    auto it = std::find(_names.begin(), _names.end(), name);
+    if (it == _names.end()) {
+        throw std::out_of_range("TimeSeries: no column " + name);
+    }
+    return _columns[it - _names.begin()];
+}
+
+std::size_t TimeSeries::since(std::time_t time) const
+{
+    return std::lower_bound(_time.begin(), _time.end(), time) - _time.begin();
+}
+
+}  // end namespace atd
@@ -0,0 +1,173 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <atd/tracing.hpp>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+namespace atd {
+
+// spans kept per thread
+static constexpr std::size_t _ring_capacity = 4096;
+// rings of the exited threads kept, the oldest are dropped first: the
+// threads of a failing market are restarted over and over
+static constexpr std::size_t _exited_rings = 64;
+
+typedef struct {
+    // taken by the owner thread when recording and by dump
+    std::mutex mux;
+    std::vector<span_t> spans;
+    // spans recorded, the oldest are overwritten
+    std::uint64_t recorded;
+    std::uint32_t thread;
+} ring_t;
+
+static const auto _epoch = std::chrono::steady_clock::now();
+static std::atomic<std::uint64_t> _last_trace(0);
+static std::atomic<std::uint32_t> _last_thread(0);
+static std::mutex _rings_mux;
+// rings of the running threads
+static std::vector<std::shared_ptr<ring_t>> _rings;
+// rings of the last exited threads, the latest last
+static std::deque<std::shared_ptr<ring_t>> _exited;
+static thread_local std::uint64_t _current = 0;
+
+// _ring_owner registers the ring of its thread and, when the thread exits,
+// moves it to the exited ones
+class _ring_owner {
+private:
+    std::shared_ptr<ring_t> _ring;
+
+public:
+    _ring_owner() : _ring(std::make_shared<ring_t>())
+    {
+        _ring->recorded = 0;
+        _ring->thread = ++_last_thread;
+        std::lock_guard<std::mutex> lock(_rings_mux);
+        _rings.push_back(_ring);
+    }
+    ~_ring_owner()
+    {
+        std::lock_guard<std::mutex> lock(_rings_mux);
+        _rings.erase(std::find(_rings.begin(), _rings.end(), _ring));
+        _exited.push_back(_ring);
+        if (_exited.size() > _exited_rings) {
+            _exited.pop_front();
+        }
+    }
+    ring_t& ring() { return *_ring; }
+};
+
+static ring_t& _ring()
+{
+    static thread_local _ring_owner owner;
+    return owner.ring();
+}
+
+std::uint64_t Tracer::newTrace() { return ++_last_trace; }
+
+std::uint64_t Tracer::current() { return _current; }
+
+void Tracer::_set_current(std::uint64_t trace) { _current = trace; }
+
+void Tracer::record(std::uint64_t trace, const std::string& name,
+                    std::chrono::steady_clock::time_point begin,
+                    std::chrono::steady_clock::time_point end)
+{
+    if (trace == 0) {
+        return;
+    }
+    auto& ring = _ring();
+    std::lock_guard<std::mutex> lock(ring.mux);
+    span_t span{trace, name, begin, end};
+    if (ring.spans.size() < _ring_capacity) {
+        ring.spans.push_back(span);
+    }
+    else {
+        ring.spans[ring.recorded % _ring_capacity] = span;
+    }
+    ++ring.recorded;
+}
+
+void Tracer::dump(std::ostream& out)
+{
+    auto micros = [](std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+
+    std::vector<std::shared_ptr<ring_t>> rings;
+    {
+        std::lock_guard<std::mutex> lock(_rings_mux);
+        rings = _rings;
+        rings.insert(rings.end(), _exited.begin(), _exited.end());
+    }
+    // spans, with their thread, by trace
+    std::map<std::uint64_t, std::vector<std::pair<span_t, std::uint32_t>>>
+        traces;
+    for (const auto& ring : rings) {
+        std::lock_guard<std::mutex> lock(ring->mux);
+        for (const auto& span : ring->spans) {
+            traces[span.trace].push_back(std::pair(span, ring->thread));
+        }
+    }
+
+    auto events = nlohmann::json::array();
+    for (auto& [trace, spans] : traces) {
+        std::sort(spans.begin(), spans.end(), [](auto& a, auto& b) {
+            return a.first.begin < b.first.begin;
+        });
+        for (std::size_t i = 0; i < spans.size(); ++i) {
+            const auto& [span, thread] = spans[i];
+            events.push_back({
+                {"name", span.name},
+                {"cat", "order"},
+                {"ph", "X"},
+                {"ts", micros(span.begin - _epoch)},
+                {"dur", micros(span.end - span.begin)},
+                {"pid", 1},
+                {"tid", thread},
+                {"args", {{"trace", trace}}},
+            });
+            if (spans.size() < 2) {
+                continue;
+            }
+            // flow arrows, from every span to the next one of the trace
+            nlohmann::json flow = {
+                {"name", "order"}, {"cat", "order"},
+                {"id", trace},     {"ts", micros(span.begin - _epoch)},
+                {"pid", 1},        {"tid", thread},
+            };
+            if (i == 0) {
+                flow["ph"] = "s";
+            }
+            else if (i + 1 == spans.size()) {
+                flow["ph"] = "f";
+                flow["bp"] = "e";
+            }
+            else {
+                flow["ph"] = "t";
+            }
+            events.push_back(flow);
+        }
+    }
+    out << nlohmann::json{{"traceEvents", events}}.dump();
+}
+
+}  // end namespace atd
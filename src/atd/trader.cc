@@ -13,26 +13,224 @@
  * limitations under the License.*/
 
 #include <atd/trader.hpp>
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <iomanip>
+#include <sstream>
 
 namespace atd {
 
+void Trader::_init_state(const std::string& name,
+                         std::shared_ptr<Market> market)
+{
+    std::lock_guard<std::mutex> lock(_states_mux);
+    auto& state = _states[market.get()];
+    if (state != nullptr) {
+        // intramarket restarted: keep caches, ledger and circuits
+        return;
+    }
+    state = std::make_shared<market_state_t>();
+    state->retrier = std::make_shared<Retrier>(name, _config.retry, _metrics);
+    state->infos = std::make_shared<
+        expiring_cache<currency_pair_t, market_info_t>>(_config.info_ttl);
+    state->tickers =
+        std::make_shared<expiring_cache<currency_pair_t, ticker_t>>(
+            _config.ticker_freshness);
+    state->ledger = std::make_shared<Ledger>(market, state->retrier);
+    state->in_flight = std::make_shared<semaphore>(_config.max_in_flight);
+}
+
+std::shared_ptr<market_state_t> Trader::_state(std::shared_ptr<Market> market)
+{
+    std::lock_guard<std::mutex> lock(_states_mux);
+    return _states.at(market.get());
+}
+
+// _placing returns the semaphore that lets a single order of pair be in
+// flight
+std::shared_ptr<semaphore> Trader::_placing(std::shared_ptr<Market> market,
+                                            const currency_pair_t& pair)
+{
+    auto state = _state(market);
+    std::lock_guard<std::mutex> lock(state->placing_mux);
+    auto& placing = state->placing[pair];
+    if (placing == nullptr) {
+        placing = std::make_shared<semaphore>(1);
+    }
+    return placing;
+}
+
+// fees and volume limits change rarely: read them from the cache and
+// call the market only when they're expired
+market_info_t Trader::_market_info(std::shared_ptr<Market> market,
+                                   const at::currency_pair_t& pair)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto state = _state(market);
+    auto info = state->infos->get(pair, [&](const currency_pair_t& pair) {
+        return state->retrier->call("info",
+                                    [&]() { return market->info(pair); });
+    });
+    _latency(market, pair, &stage_latencies_t::info,
+             std::chrono::steady_clock::now() - start);
+    return info;
+}
+
+// a single order can need the ticker more than once, and concurrent orders
+// on the same pair need the same ticker: share a fresh enough one and
+// coalesce the concurrent requests in a single call
+ticker_t Trader::_ticker(std::shared_ptr<Market> market,
+                         const at::currency_pair_t& pair)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto state = _state(market);
+    auto ticker = state->tickers->get(pair, [&](const currency_pair_t& pair) {
+        return state->retrier->call("ticker",
+                                    [&]() { return market->ticker(pair); });
+    });
+    _latency(market, pair, &stage_latencies_t::ticker,
+             std::chrono::steady_clock::now() - start);
+    return ticker;
+}
+
+// _available returns the available balance of currency, to trade pair
+double Trader::_available(std::shared_ptr<Market> market,
+                          const at::currency_pair_t& pair,
+                          const std::string& currency)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto balance = _state(market)->ledger->available(currency);
+    _latency(market, pair, &stage_latencies_t::balance,
+             std::chrono::steady_clock::now() - start);
+    return balance;
+}
+
+// _latency records the duration of stage of an order of pair, both in the
+// market and in the pair latencies
+void Trader::_latency(std::shared_ptr<Market> market,
+                      const currency_pair_t& pair,
+                      LatencyHistogram stage_latencies_t::*stage,
+                      std::chrono::nanoseconds duration)
+{
+    auto state = _state(market);
+    std::shared_ptr<stage_latencies_t> pair_latencies;
+    {
+        std::lock_guard<std::mutex> lock(state->latencies_mux);
+        auto& latencies = state->pair_latencies[pair];
+        if (latencies == nullptr) {
+            latencies = std::make_shared<stage_latencies_t>();
+        }
+        pair_latencies = latencies;
+    }
+    (state->latencies.*stage).record(duration);
+    ((*pair_latencies).*stage).record(duration);
+}
+
+// _report logs the median and 99th percentile of every stage of the order
+// path, in milliseconds, for the market and for every pair
+void Trader::_report(const std::string& name, std::shared_ptr<Market> market)
+{
+    static const std::vector<
+        std::pair<const char*, LatencyHistogram stage_latencies_t::*>>
+        stages = {
+            {"channel", &stage_latencies_t::channel},
+            {"queue", &stage_latencies_t::queue},
+            {"balance", &stage_latencies_t::balance},
+            {"info", &stage_latencies_t::info},
+            {"ticker", &stage_latencies_t::ticker},
+            {"slot", &stage_latencies_t::slot},
+            {"place", &stage_latencies_t::place},
+            {"total", &stage_latencies_t::total},
+        };
+    auto format = [&](const stage_latencies_t& latencies) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(3);
+        for (const auto& [stage, histogram] : stages) {
+            std::chrono::duration<double, std::milli> p50 =
+                (latencies.*histogram).percentile(0.5);
+            std::chrono::duration<double, std::milli> p99 =
+                (latencies.*histogram).percentile(0.99);
+            oss << " " << stage << ": " << p50.count() << "/" << p99.count();
+        }
+        return oss.str();
+    };
+
+    auto state = _state(market);
+    _console_logger->info(
+        "Trader::intramarket: {} latency p50/p99 (ms):{}", name,
+        format(state->latencies));
+    std::map<currency_pair_t, std::shared_ptr<stage_latencies_t>> pairs;
+    {
+        std::lock_guard<std::mutex> lock(state->latencies_mux);
+        pairs = state->pair_latencies;
+    }
+    for (const auto& [pair, latencies] : pairs) {
+        _console_logger->info(
+            "Trader::intramarket: {} {} latency p50/p99 (ms):{}", name, pair,
+            format(*latencies));
+    }
+}
+
+// _spending returns the currency spent by the order, and how much of it
+static std::pair<std::string, double> _spending(const order_t& order,
+                                                double fee)
+{
+    if (order.action == at::order_action_t::buy) {
+        return std::pair(order.pair.second, order.cost + fee);
+    }
+    return std::pair(order.pair.first, order.volume);
+}
+
+// _place places the order, whose funds have been already reserved in the
+// ledger. If the market rejects it, the cached info of the pair may be
+// outdated: invalidate them.
+void Trader::_place(std::shared_ptr<Market> market, order_t& order, double fee)
+{
+    auto state = _state(market);
+    auto [currency, amount] = _spending(order, fee);
+    try {
+        state->retrier->call("place", [&]() { market->place(order); });
+    }
+    catch (const at::response_error&) {
+        state->infos->invalidate(order.pair);
+        state->ledger->release(currency, amount);
+        throw;
+    }
+    catch (...) {
+        state->ledger->release(currency, amount);
+        throw;
+    }
+
+    auto id = state->ledger->placed(order, currency, amount);
+    // market orders are filled as soon as they're placed, limit orders are
+    // settled by the ledger reconciliation
+    if (order.type == at::order_type_t::market) {
+        if (order.action == at::order_action_t::buy) {
+            state->ledger->fill(id, order.pair.first, order.volume);
+        }
+        else {
+            state->ledger->fill(id, order.pair.second, order.cost - fee);
+        }
+    }
+}
+
 double Trader::_market_buy_price(std::shared_ptr<Market> market,
                                  const at::currency_pair_t& pair)
 {
-    return market->ticker(pair).bid.price;
+    return _ticker(market, pair).bid.price;
 }
 
 double Trader::_market_sell_price(std::shared_ptr<Market> market,
                                   const at::currency_pair_t& pair)
 {
-    return market->ticker(pair).ask.price;
+    return _ticker(market, pair).ask.price;
 }
 
-double Trader::_buy_trade_balance(std::shared_ptr<Market> market,
-                                  const message_t& message)
+double buy_trade_balance(const message_t& message, double quote_balance,
+                         const std::function<double()>& price)
 {
     double trade_balance = 0;
-    double quote_balance = market->balance(message.order.pair.second);
 
     if (quote_balance <= 0) {
         return trade_balance;
@@ -56,28 +254,26 @@ double Trader::_buy_trade_balance(std::shared_ptr<Market> market,
     else if (message.budget.base.balance_percentage > 0 ||
              message.budget.base.fixed_amount > 0) {
         auto budget = message.budget.base;
-        auto price = message.order.price > 0
-                         ? message.order.price
-                         : _market_sell_price(market, message.order.pair);
+        auto base_price =
+            message.order.price > 0 ? message.order.price : price();
         if (budget.fixed_amount > 0) {
-            trade_balance = budget.fixed_amount * price;
+            trade_balance = budget.fixed_amount * base_price;
 
             if (trade_balance > quote_balance) {
                 trade_balance = 0;
             }
         }
         else {
-            trade_balance = quote_balance * price;
+            trade_balance = quote_balance * base_price;
         }
     }
     return trade_balance;
 }
 
-double Trader::_sell_trade_balance(std::shared_ptr<Market> market,
-                                   const message_t& message)
+double sell_trade_balance(const message_t& message, double base_balance,
+                          const std::function<double()>& price)
 {
     double trade_balance = 0;
-    double base_balance = market->balance(message.order.pair.first);
 
     if (base_balance <= 0) {
         return trade_balance;
@@ -101,225 +297,806 @@ double Trader::_sell_trade_balance(std::shared_ptr<Market> market,
     else if (message.budget.quote.balance_percentage > 0 ||
              message.budget.quote.fixed_amount > 0) {
         auto budget = message.budget.quote;
-        auto price = message.order.price > 0
-                         ? message.order.price
-                         : _market_buy_price(market, message.order.pair);
+        auto quote_price =
+            message.order.price > 0 ? message.order.price : price();
 
         if (budget.fixed_amount > 0) {
-            trade_balance = budget.fixed_amount * price;
+            trade_balance = budget.fixed_amount * quote_price;
 
             if (trade_balance > base_balance) {
                 trade_balance = 0;
             }
         }
         else {
-            trade_balance = budget.balance_percentage * price;
+            trade_balance = budget.balance_percentage * quote_price;
         }
     }
 
     return trade_balance;
 }
 
+// _prepare prices and checks the order of the message, then reserves its
+// funds. Returns true if order is ready to be placed, with fee its
+// estimated fee.
+bool Trader::_prepare(std::shared_ptr<Market> market, const message_t& message,
+                      order_t& order, double& fee)
+{
+    order = message.order;
+    auto ready = false;
+
+    _console_logger->info(
+        "Trader::intramarket: received message. Order type: {}, Pair: {}",
+        order.action == at::order_action_t::buy ? "BUY" : "SELL", order.pair);
+
+    try {
+        // handle buy orders
+        if (order.action == at::order_action_t::buy) {
+            auto ledger = _state(market)->ledger;
+            auto balance = _available(market, order.pair, order.pair.second);
+            auto trade_balance =
+                buy_trade_balance(message, balance, [&]() {
+                    return _market_sell_price(market, order.pair);
+                });
+
+            auto info = _market_info(market, order.pair);
+            fee = 0;
+            // info.{maker,taker}_fee are a percentage. eg. 0.16 means 0.16%
+            // of the cost
+            if (order.type == at::order_type_t::limit) {
+                order.volume = trade_balance / order.price;
+
+                // keep track of the cost
+                order.cost =
+                    order.volume * order.price;  // 0.33 *60 = 19.8 EUR/LTC
+                fee = order.cost * info.maker_fee /
+                      100;  // 19.8 * 0.0016 = 0.3164
+            }
+            else if (order.type == at::order_type_t::market) {
+                order.price = _market_sell_price(market, order.pair);
+                order.volume = trade_balance / order.price;
+
+                order.cost = order.volume * order.price;
+                fee = order.cost * info.taker_fee / 100;
+            }
+
+            if (order.volume >= info.limit.min &&
+                order.volume <= info.limit.max &&
+                balance - trade_balance - fee >= 0 &&
+                // lock the funds: concurrent orders can't use them
+                ledger->reserve(order.pair.second, order.cost + fee)) {
+                _console_logger->info(
+                    "Trader::intramarket-> BUY "
+                    "Pair: {} "
+                    "Balance: {} "
+                    "Trade balanace: {} "
+                    "Volume: {} "
+                    "Price: {} "
+                    "Estimated cost: {} "
+                    "Estimated fees: {}",
+                    order.pair, balance, trade_balance, order.volume,
+                    order.price, order.cost, fee);
+
+                ready = true;
+            }
+            else {
+                // the limits could be changed: refresh them for the next order
+                _state(market)->infos->invalidate(order.pair);
+                _console_logger->info(
+                    "Trader::intramarket-> BUY [FAIL!] "
+                    "Pair: {} "
+                    "Balance: {} "
+                    "Trade balanace: {} "
+                    "Volume: {} "
+                    "Price: {} "
+                    "Estimated cost: {} "
+                    "Estimated fees: {} "
+                    "Min volume: {} "
+                    "Max volume: {} "
+                    "balance - trade_balance - fee: {}",
+                    order.pair, balance, trade_balance, order.volume,
+                    order.price, order.cost, fee, info.limit.min,
+                    info.limit.max, balance - trade_balance - fee);
+            }
+        }
+        else {
+            // handle sell order
+            // can I sell pair.first(LTC) for pair.second(EUR)?
+            auto ledger = _state(market)->ledger;
+            // 10 LTC
+            auto balance = _available(market, order.pair, order.pair.first);
+            auto trade_balance =
+                sell_trade_balance(message, balance, [&]() {
+                    return _market_buy_price(market, order.pair);
+                });
+
+            // How many items of pair.first can I sell given the specified
+            // trade balance?
+            order.volume = trade_balance;
+
+            auto info = _market_info(market, order.pair);
+            fee = 0;
+            // info.{maker,taker}_fee are a percentage. eg. 0.16 means 0.16%
+            // of the cost
+            if (order.type == at::order_type_t::limit) {
+                order.cost = order.price * order.volume;
+                fee = order.cost * info.maker_fee / 100;  // 60 * 0.0016 = 0.096
+            }
+            else if (order.type == at::order_type_t::market) {
+                order.price = _market_sell_price(market, order.pair);
+                order.cost = order.price * order.volume;
+                fee = order.cost * info.taker_fee / 100;
+            }
+
+            if (order.volume >= info.limit.min &&
+                order.volume <= info.limit.max &&
+                balance - trade_balance - fee >= 0 &&
+                ledger->reserve(order.pair.first, order.volume)) {
+                _console_logger->info(
+                    "Trader::intramarket-> SELL "
+                    "Pair: {} "
+                    "Balance: {} "
+                    "Trade balanace: {} "
+                    "Volume: {} "
+                    "Price: {} "
+                    "Estimated return: {} "
+                    "Estimated fees: {}",
+                    order.pair, balance, trade_balance, order.volume,
+                    order.price, order.cost, fee);
+
+                ready = true;
+            }
+            else {
+                _state(market)->infos->invalidate(order.pair);
+                _console_logger->info(
+                    "Trader::intramarket-> SELL [FAIL!] "
+                    "Pair: {} "
+                    "Balance: {} "
+                    "Trade balanace: {} "
+                    "Volume: {} "
+                    "Price: {} "
+                    "Estimated return: {} "
+                    "Estimated fees: {} "
+                    "Min volume: {} "
+                    "Max volume: {} "
+                    "balance - trade_balance - fee: {}",
+                    order.pair, balance, trade_balance, order.volume,
+                    order.price, order.cost, fee, info.limit.min,
+                    info.limit.max, balance - trade_balance - fee);
+            }
+        }
+    }
+    catch (const at::server_error& e) {
+        // catch only server error.
+        // response_error should make the process die because it's a
+        // malformed request that have to be fixed instead, a server
+        // error is usually an overloaded server error.
+        // The retrier already retried the failed call: give up the order
+        _error_logger->error(
+            "Trader::intramarket: {}: order dropped: at::server_error: {}",
+            order.pair, e.what());
+        order.txid = "";
+    }
+    catch (const circuit_open& e) {
+        _error_logger->error("Trader::intramarket: {}: order dropped: {}",
+                             order.pair, e.what());
+        order.txid = "";
+    }
+    return ready;
+}
+
+// _send places the prepared order and records how long it took.
+// Returns false if the order has been dropped.
+bool Trader::_send(std::shared_ptr<Market> market, order_t& order, double fee)
+{
+    auto start = std::chrono::steady_clock::now();
+    try {
+        _place(market, order, fee);
+        _latency(market, order.pair, &stage_latencies_t::place,
+                 std::chrono::steady_clock::now() - start);
+        return true;
+    }
+    catch (const at::server_error& e) {
+        _error_logger->error(
+            "Trader::intramarket: {}: order dropped: at::server_error: {}",
+            order.pair, e.what());
+    }
+    catch (const circuit_open& e) {
+        _error_logger->error("Trader::intramarket: {}: order dropped: {}",
+                             order.pair, e.what());
+    }
+    order.txid = "";
+    return false;
+}
+
+// _feedback gives the outcome of its order to the strategy that sent the
+// message. It must be called even if the order has not been placed: the
+// strategy is waiting for it
+void Trader::_feedback(std::shared_ptr<Market> market, const message_t& message,
+                       const order_t& order)
+{
+    if (message.feedback != nullptr) {
+        Span span(message.trace, "feedback");
+        feedback_t feedback;
+        feedback.market = market;
+        feedback.order = order;
+        feedback.retrier = _state(market)->retrier;
+        feedback.trace = message.trace;
+        {
+            auto state = _state(market);
+            std::lock_guard<std::mutex> lock(state->pending_mux);
+            state->pending.erase(message.trace);
+        }
+        message.feedback->put(feedback);
+    }
+    if (message.sent.time_since_epoch().count() > 0) {
+        _latency(market, message.order.pair, &stage_latencies_t::total,
+                 std::chrono::steady_clock::now() - message.sent);
+    }
+}
+
+// _execute prepares and places the order of the message, waiting for the
+// answer of the market, then gives feedback to the strategy.
+// Returns true if the order has been placed.
+bool Trader::_execute(std::shared_ptr<Market> market, const message_t& message,
+                      order_t& order)
+{
+    TraceScope scope(message.trace);
+    double fee = 0;
+    auto placed = false;
+    auto prepare = std::chrono::steady_clock::now();
+    auto ready = _prepare(market, message, order, fee);
+    Tracer::record(message.trace, "prepare", prepare,
+                   std::chrono::steady_clock::now());
+    if (ready) {
+        auto placing = _placing(market, order.pair);
+        auto in_flight = _state(market)->in_flight;
+        auto start = std::chrono::steady_clock::now();
+        // the dispatched orders of the pair are placed first
+        placing->acquire();
+        in_flight->acquire();
+        _latency(market, order.pair, &stage_latencies_t::slot,
+                 std::chrono::steady_clock::now() - start);
+        Tracer::record(message.trace, "slot", start,
+                       std::chrono::steady_clock::now());
+        try {
+            Span span(message.trace, "place");
+            placed = _send(market, order, fee);
+        }
+        catch (...) {
+            in_flight->release();
+            placing->release();
+            throw;
+        }
+        in_flight->release();
+        placing->release();
+    }
+    _feedback(market, message, order);
+    return placed;
+}
+
+// _dispatch prepares the order of the message and sends it to the placers,
+// without waiting for the answer of the market: the placer gives feedback
+// to the strategy. It waits only if the previous order of the pair, or
+// max_in_flight orders, are still in flight.
+void Trader::_dispatch(std::shared_ptr<Market> market,
+                       const message_t& message,
+                       std::shared_ptr<channel<placement_t>> placements)
+{
+    TraceScope scope(message.trace);
+    placement_t placement = {};
+    placement.message = message;
+    auto prepare = std::chrono::steady_clock::now();
+    auto ready = _prepare(market, message, placement.order, placement.fee);
+    Tracer::record(message.trace, "prepare", prepare,
+                   std::chrono::steady_clock::now());
+    if (!ready) {
+        _feedback(market, message, placement.order);
+        return;
+    }
+    placement.dispatched = std::chrono::steady_clock::now();
+    _placing(market, placement.order.pair)->acquire();
+    _state(market)->in_flight->acquire();
+    placements->put(placement);
+}
+
+// _net executes the messages collected for a pair in the netting window.
+// The volumes of the market orders are computed as if they were placed one
+// by one, then the buys are netted against the sells: the matched volume
+// doesn't change the balances and never reaches the market, the remainder
+// is placed as a single order. Every strategy receives its share of the
+// fill. Limit orders have their own price and are executed one by one.
+void Trader::_net(std::shared_ptr<Market> market,
+                  const std::vector<message_t>& messages,
+                  std::shared_ptr<channel<placement_t>> placements)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<message_t> intents;
+    for (const auto& message : messages) {
+        if (message.order.type == at::order_type_t::market) {
+            intents.push_back(message);
+        }
+        else {
+            _dispatch(market, message, placements);
+        }
+    }
+    if (intents.size() <= 1) {
+        for (const auto& intent : intents) {
+            _dispatch(market, intent, placements);
+        }
+        return;
+    }
+
+    auto pair = intents.front().order.pair;
+    std::vector<double> volumes;
+    double bought = 0, sold = 0, ask = 0, bid = 0;
+    // can't size the orders together: let every order fail on its own
+    auto fallback = [&](const std::string& error) {
+        _error_logger->error("Trader::intramarket: {}: netting: {}", pair,
+                             error);
+        for (const auto& intent : intents) {
+            _dispatch(market, intent, placements);
+        }
+    };
+    try {
+        // buys pay the ask, sells get the bid
+        ask = _market_sell_price(market, pair);
+        bid = _market_buy_price(market, pair);
+        // every intent is sized on what the previous ones left, like the
+        // reservations of orders placed one by one do
+        auto quote_balance = _available(market, pair, pair.second);
+        auto base_balance = _available(market, pair, pair.first);
+        for (const auto& intent : intents) {
+            double volume = 0;
+            if (intent.order.action == at::order_action_t::buy) {
+                auto trade_balance = buy_trade_balance(
+                    intent, quote_balance, [&]() { return ask; });
+                quote_balance -= trade_balance;
+                volume = trade_balance / ask;
+                bought += volume;
+            }
+            else {
+                volume = sell_trade_balance(intent, base_balance,
+                                            [&]() { return bid; });
+                base_balance -= volume;
+                sold += volume;
+            }
+            volumes.push_back(volume);
+        }
+    }
+    catch (const at::server_error& e) {
+        fallback(std::string("at::server_error: ") + e.what());
+        return;
+    }
+    catch (const circuit_open& e) {
+        fallback(e.what());
+        return;
+    }
+
+    order_t net = {};
+    net.pair = pair;
+    net.type = at::order_type_t::market;
+    net.action =
+        bought > sold ? at::order_action_t::buy : at::order_action_t::sell;
+    auto matched = std::min(bought, sold);
+    auto remainder = std::abs(bought - sold);
+
+    double placed_volume = 0, placed_price = 0;
+    if (remainder > 0) {
+        // the net order is traced in the trace of the first intent
+        message_t message = {};
+        message.order = net;
+        message.budget.base.fixed_amount = remainder;
+        message.trace = intents.front().trace;
+        if (_execute(market, message, net)) {
+            placed_volume = net.volume;
+            placed_price = net.price;
+        }
+    }
+    _console_logger->info(
+        "Trader::intramarket: {} netted {} orders. Bought: {} Sold: {} "
+        "Matched: {} Placed: {}",
+        pair, intents.size(), bought, sold, matched, placed_volume);
+
+    // the orders on the smaller side are filled by the matched volume,
+    // the ones on the bigger side share the matched and placed volume
+    auto bigger_side = std::max(bought, sold);
+    auto filled = bigger_side > 0 ? (matched + placed_volume) / bigger_side : 0;
+    auto internal = "netted-" + std::to_string(++_netted);
+    for (std::size_t i = 0; i < intents.size(); ++i) {
+        auto order = intents[i].order;
+        auto bigger = order.action == net.action;
+        order.volume = bigger ? volumes[i] * filled : volumes[i];
+        if (bigger && placed_volume > 0) {
+            order.price = placed_price;
+        }
+        else {
+            order.price = order.action == at::order_action_t::buy ? ask : bid;
+        }
+        order.cost = order.volume * order.price;
+        if (order.volume <= 0) {
+            order.txid = "";
+        }
+        else if (bigger && placed_volume > 0) {
+            order.txid = net.txid;
+        }
+        else {
+            order.txid = internal;
+        }
+        Tracer::record(intents[i].trace, "net", start,
+                       std::chrono::steady_clock::now());
+        _feedback(market, intents[i], order);
+    }
+}
+
+void Trader::_record(std::shared_ptr<Market> market,
+                     const currency_pair_t& pair,
+                     std::chrono::nanoseconds wait,
+                     std::chrono::nanoseconds execution)
+{
+    auto state = _state(market);
+    std::lock_guard<std::mutex> lock(state->stats_mux);
+    auto& stats = state->stats[pair];
+    ++stats.orders;
+    stats.wait += wait;
+    stats.max_wait = std::max(stats.max_wait, wait);
+    stats.execution += execution;
+    stats.max_execution = std::max(stats.max_execution, execution);
+}
+
+std::map<currency_pair_t, execution_stats_t> Trader::stats(
+    std::shared_ptr<Market> market)
+{
+    auto state = _state(market);
+    std::lock_guard<std::mutex> lock(state->stats_mux);
+    return state->stats;
+}
+
+placement_stats_t Trader::placementStats(std::shared_ptr<Market> market)
+{
+    auto state = _state(market);
+    return placement_stats_t{
+        .orders = state->latencies.place.count(),
+        .p50 = state->latencies.place.percentile(0.5),
+        .p99 = state->latencies.place.percentile(0.99),
+    };
+}
+
 void Trader::intramarket(
-    std::shared_ptr<Market> market,
+    const std::string& name, std::shared_ptr<Market> market,
     const std::map<currency_pair_t, std::vector<std::shared_ptr<Strategy>>>&
-        strategies)
-
+        strategies,
+    std::shared_ptr<Heartbeat> heartbeat)
 {
+    _init_state(name, market);
+
+    // Every thread started here catches its failures: the first one stops
+    // all the threads, and it's rethrown once they've all been joined, so
+    // that the supervisor restarts intramarket from scratch.
+    // The threads run in the scope of the stop: their sleeps, and the
+    // backoffs of their retried calls, throw clock_stopped once stopped
+    auto stop = std::make_shared<StopSignal>();
+    std::mutex failure_mux;
+    std::exception_ptr failure;
+    auto fail = [&](std::exception_ptr error) {
+        {
+            std::lock_guard<std::mutex> lock(failure_mux);
+            if (failure == nullptr) {
+                failure = error;
+            }
+        }
+        stop->request();
+    };
+
+    // Orders of different pairs are executed concurrently: every pair has
+    // its own queue and worker thread, so that the orders of the same pair
+    // stay serialized
+    // When netting is enabled, the worker collects the messages arrived
+    // within the netting window from the first one and executes them
+    // together.
+    // Workers only prepare the orders: placers place them, up to
+    // max_in_flight at the same time but one per pair, and give feedback to
+    // the strategies. A worker prepares the next order of its pair while the
+    // previous one is in flight.
+    // Once stopped, workers and placers drain their queues without placing:
+    // the strategies waiting for a feedback receive a failed one.
+    auto placements = std::make_shared<channel<placement_t>>();
+    _metrics->gauge("atd_trader_placements_depth",
+                    "Prepared orders waiting for a placer", {{"market", name}},
+                    [placements]() { return placements->size(); });
+    auto placer = [&]() {
+        StopScope stopping(stop.get());
+        auto state = _state(market);
+        placement_t placement;
+        while (placements->get(placement)) {
+            auto trace = placement.message.trace;
+            TraceScope scope(trace);
+            try {
+                if (stop->requested()) {
+                    auto [currency, amount] =
+                        _spending(placement.order, placement.fee);
+                    state->ledger->release(currency, amount);
+                    placement.order.txid = "";
+                }
+                else {
+                    _latency(market, placement.order.pair,
+                             &stage_latencies_t::slot,
+                             std::chrono::steady_clock::now() -
+                                 placement.dispatched);
+                    Tracer::record(trace, "slot", placement.dispatched,
+                                   std::chrono::steady_clock::now());
+                    Span span(trace, "place");
+                    _send(market, placement.order, placement.fee);
+                }
+            }
+            catch (...) {
+                // _place already released the reserved funds
+                placement.order.txid = "";
+                fail(std::current_exception());
+            }
+            state->in_flight->release();
+            _placing(market, placement.order.pair)->release();
+            _feedback(market, placement.message, placement.order);
+        }
+    };
+
+    auto worker = [&](std::shared_ptr<channel<queued_message_t>> queue) {
+        StopScope stopping(stop.get());
+        queued_message_t queued;
+        while (queue->get(queued)) {
+            if (stop->requested()) {
+                // the failed feedback is given once stopped
+                continue;
+            }
+            std::vector<queued_message_t> batch{queued};
+            if (_config.netting_window.count() > 0) {
+                auto deadline =
+                    std::chrono::steady_clock::now() + _config.netting_window;
+                while (queue->get_until(queued, deadline)) {
+                    batch.push_back(queued);
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            auto pair = batch.front().message.order.pair;
+            try {
+                if (batch.size() == 1) {
+                    _dispatch(market, batch.front().message, placements);
+                }
+                else {
+                    std::vector<message_t> messages;
+                    for (const auto& item : batch) {
+                        messages.push_back(item.message);
+                    }
+                    _net(market, messages, placements);
+                }
+            }
+            catch (...) {
+                fail(std::current_exception());
+                continue;
+            }
+            auto execution = std::chrono::steady_clock::now() - start;
+            for (const auto& item : batch) {
+                auto wait = start - item.time;
+                _latency(market, pair, &stage_latencies_t::queue, wait);
+                Tracer::record(item.message.trace, "queue", item.time, start);
+                _record(market, pair, wait, execution);
+                _console_logger->debug(
+                    "Trader::intramarket: {} queued for {}ms, executed in "
+                    "{}ms",
+                    pair,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(wait)
+                        .count(),
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        execution)
+                        .count());
+            }
+        }
+    };
+
     auto decisor = [&]() {
+        StopScope stopping(stop.get());
+        std::map<currency_pair_t, std::shared_ptr<channel<queued_message_t>>>
+            queues;
+        std::vector<std::thread> workers;
+        std::vector<std::thread> placers;
+        for (unsigned int i = 0; i < _config.max_in_flight; ++i) {
+            placers.push_back(std::thread(placer));
+        }
+        auto state = _state(market);
         message_t message = {};
         _console_logger->info("Trader::intramarket: waiting");
-        while (_chan->get(message)) {
-            auto order = message.order;
-
-            bool retry = true;
-            _console_logger->info(
-                "Trader::intramarket: received message. Order type: {}, "
-                "Pair: "
-                "{}",
-                order.action == at::order_action_t::buy ? "BUY" : "SELL",
-                order.pair);
-
-            while (retry) {
-                try {
-                    // handle buy orders
-                    if (order.action == at::order_action_t::buy) {
-                        auto balance = market->balance(order.pair.second);
-                        auto trade_balance =
-                            _buy_trade_balance(market, message);
-
-                        auto info = market->info(order.pair);
-                        double fee = 0;
-                        // info.{maker,taker}_fee are a percentage. eg. 0.16
-                        // means 0.16% of the cost
-                        if (order.type == at::order_type_t::limit) {
-                            order.volume = trade_balance / order.price;
-
-                            // keep track of the cost
-                            order.cost =
-                                order.volume *
-                                order.price;  // 0.33 *60 = 19.8 EUR/LTC
-                            fee = order.cost * info.maker_fee /
-                                  100;  // 19.8 * 0.0016 = 0.3164
-                        }
-                        else if (order.type == at::order_type_t::market) {
-                            order.price =
-                                _market_sell_price(market, order.pair);
-                            order.volume = trade_balance / order.price;
-
-                            order.cost = order.volume * order.price;
-                            fee = order.cost * info.taker_fee / 100;
-                        }
-
-                        if (order.volume >= info.limit.min &&
-                            order.volume <= info.limit.max &&
-                            balance - trade_balance - fee >= 0) {
-                            _console_logger->info(
-                                "Trader::intramarket-> BUY "
-                                "Pair: {} "
-                                "Balance: {} "
-                                "Trade balanace: {} "
-                                "Volume: {} "
-                                "Price: {} "
-                                "Estimated cost: {} "
-                                "Estimated fees: {}",
-                                order.pair, balance, trade_balance,
-                                order.volume, order.price, order.cost, fee);
-
-                            market->place(order);
-                        }
-                        else {
-                            _console_logger->info(
-                                "Trader::intramarket-> BUY [FAIL!] "
-                                "Pair: {} "
-                                "Balance: {} "
-                                "Trade balanace: {} "
-                                "Volume: {} "
-                                "Price: {} "
-                                "Estimated cost: {} "
-                                "Estimated fees: {} "
-                                "Min volume: {} "
-                                "Max volume: {} "
-                                "balance - trade_balance - fee: {}",
-                                order.pair, balance, trade_balance,
-                                order.volume, order.price, order.cost, fee,
-                                info.limit.min, info.limit.max,
-                                balance - trade_balance - fee);
-                        }
-                    }
-                    else {
-                        // handle sell order
-                        // can I sell pair.first(LTC) for pair.second(EUR)?
-                        auto balance =
-                            market->balance(order.pair.first);  // 10 LTC
-                        auto trade_balance =
-                            _sell_trade_balance(market, message);
-
-                        // How many items of pair.first can I sell
-                        // given the specified trade balance?
-                        order.volume = trade_balance;
-
-                        auto info = market->info(order.pair);
-                        double fee = 0;
-                        // info.{maker,taker}_fee are a percentage. eg. 0.16
-                        // means 0.16% of the cost
-                        if (order.type == at::order_type_t::limit) {
-                            order.cost = order.price * order.volume;
-                            fee = order.cost * info.maker_fee /
-                                  100;  // 60 * 0.0016 = 0.096
-                        }
-                        else if (order.type == at::order_type_t::market) {
-                            order.price =
-                                _market_sell_price(market, order.pair);
-                            order.cost = order.price * order.volume;
-                            fee = order.cost * info.taker_fee / 100;
-                        }
-
-                        if (order.volume >= info.limit.min &&
-                            order.volume <= info.limit.max &&
-                            balance - trade_balance - fee >= 0) {
-                            _console_logger->info(
-                                "Trader::intramarket-> SELL "
-                                "Pair: {} "
-                                "Balance: {} "
-                                "Trade balanace: {} "
-                                "Volume: {} "
-                                "Price: {} "
-                                "Estimated return: {} "
-                                "Estimated fees: {}",
-                                order.pair, balance, trade_balance,
-                                order.volume, order.price, order.cost, fee);
-
-                            market->place(order);
-                        }
-                        else {
-                            _console_logger->info(
-                                "Trader::intramarket-> SELL [FAIL!] "
-                                "Pair: {} "
-                                "Balance: {} "
-                                "Trade balanace: {} "
-                                "Volume: {} "
-                                "Price: {} "
-                                "Estimated return: {} "
-                                "Estimated fees: {} "
-                                "Min volume: {} "
-                                "Max volume: {} "
-                                "balance - trade_balance - fee: {}",
-                                order.pair, balance, trade_balance,
-                                order.volume, order.price, order.cost, fee,
-                                info.limit.min, info.limit.max,
-                                balance - trade_balance - fee);
-                        }
+        try {
+            while (!stop->requested()) {
+                // wake up at least twice per heartbeat timeout, to beat
+                heartbeat->beat();
+                if (!_chan->get_until(message,
+                                      std::chrono::steady_clock::now() +
+                                          heartbeat->timeout() / 2)) {
+                    if (_chan->is_closed()) {
+                        break;
                     }
+                    continue;
+                }
+                if (message.feedback != nullptr) {
+                    std::lock_guard<std::mutex> lock(state->pending_mux);
+                    state->pending[message.trace] = message;
+                }
+                if (message.sent.time_since_epoch().count() > 0) {
+                    _latency(market, message.order.pair,
+                             &stage_latencies_t::channel,
+                             std::chrono::steady_clock::now() - message.sent);
+                    Tracer::record(message.trace, "channel", message.sent,
+                                   std::chrono::steady_clock::now());
+                }
+                auto& queue = queues[message.order.pair];
+                if (queue == nullptr) {
+                    queue = std::make_shared<channel<queued_message_t>>();
+                    workers.push_back(std::thread(worker, queue));
+                    auto pair = message.order.pair;
+                    labels_t labels = {
+                        {"market", name},
+                        {"pair", pair.first + "_" + pair.second}};
+                    _metrics->gauge("atd_trader_queue_depth",
+                                    "Messages waiting in the queue of a pair",
+                                    labels,
+                                    [queue]() { return queue->size(); });
+                }
+                queue->put(queued_message_t{
+                    .message = message,
+                    .time = std::chrono::steady_clock::now(),
+                });
+                message = {};
+            }
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+        --_decisors;
 
-                    // Give feedback to the strategy
-                    if (message.feedback != nullptr) {
-                        feedback_t feedback;
-                        feedback.market = market;
-                        feedback.order = order;
-                        message.feedback->put(feedback);
-                    }
+        for (auto& [pair, queue] : queues) {
+            queue->close();
+        }
+        for (auto& worker_thread : workers) {
+            worker_thread.join();
+        }
+        placements->close();
+        for (auto& placer_thread : placers) {
+            placer_thread.join();
+        }
+    };  // end decisor definition
 
-                    _console_logger->info("Trader::intramarket: waiting");
+    // Prefetch the info of every configured pair, so the first orders
+    // don't pay the round trip
+    for (const auto& [pair, strategy_vector] : strategies) {
+        try {
+            _market_info(market, pair);
+        }
+        catch (const at::server_error& e) {
+            _error_logger->error(
+                "Trader::intramarket: prefetch info {}: at::server_error: {}",
+                pair, e.what());
+        }
+        catch (const at::response_error& e) {
+            // pair not traded in this market
+            _error_logger->error(
+                "Trader::intramarket: prefetch info {}: at::response_error: "
+                "{}",
+                pair, e.what());
+        }
+        catch (const circuit_open& e) {
+            _error_logger->error("Trader::intramarket: prefetch info {}: {}",
+                                 pair, e.what());
+        }
+    }
 
-                    message = {};
-                    retry = false;
-                }
-                catch (const at::server_error& e) {
-                    // catch only server error.
-                    // response_error should make the process die
-                    // because it's a malformed request that have to be
-                    // fixed instead, a server error is usually an
-                    // overloaded server error
-                    _error_logger->error(
-                        "Trader::intramarket: at::server_error: {}", e.what());
-                    retry = true;
-                }
-            }  // end while retry
+    // Realign the ledger with the market: fills of limit orders and
+    // movements made outside of the trader
+    auto reconciler = [&]() {
+        StopScope stopping(stop.get());
+        auto ledger = _state(market)->ledger;
+        while (stop->sleep_for(_config.ledger_reconcile_period)) {
+            try {
+                ledger->reconcile();
+            }
+            catch (const at::server_error& e) {
+                _error_logger->error(
+                    "Trader::intramarket: ledger reconcile: at::server_error: "
+                    "{}",
+                    e.what());
+            }
+            catch (const circuit_open& e) {
+                _error_logger->error(
+                    "Trader::intramarket: ledger reconcile: {}", e.what());
+            }
+            catch (...) {
+                fail(std::current_exception());
+            }
+        }
+    };
 
-        }  // end while get chan
-    };     // end decisor definition
+    auto reporter = [&]() {
+        StopScope stopping(stop.get());
+        while (stop->sleep_for(_config.latency_report_period)) {
+            try {
+                _report(name, market);
+            }
+            catch (...) {
+                fail(std::current_exception());
+            }
+        }
+    };
 
+    // Strategies sleep on the clock: once stopped, their sleeps throw
+    // clock_stopped and they return
+    std::atomic<std::size_t> running(0);
+    auto trade = [&](std::function<void()> f) {
+        StopScope scope(stop.get());
+        try {
+            f();
+        }
+        catch (const clock_stopped&) {
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+        --running;
+    };
+
+    ++_decisors;
     std::thread decisor_thread(decisor);
-    std::vector<std::thread> buy_strategies;
-    std::vector<std::thread> sell_strategies;
+    std::thread reconciler_thread(reconciler);
+    std::thread reporter_thread(reporter);
+    std::vector<std::thread> strategy_threads;
     for (const auto& [pair, strategy_vector] : strategies) {
-        for (const auto strategy : strategy_vector) {
-            sell_strategies.push_back(
-                std::thread(&Strategy::sell, strategy.get(), std::ref(pair)));
-            buy_strategies.push_back(
-                std::thread(&Strategy::buy, strategy.get(), std::ref(pair)));
+        auto traded = &pair;
+        for (const auto& strategy : strategy_vector) {
+            running += 2;
+            strategy_threads.push_back(std::thread(
+                trade, [strategy, traded]() { strategy->sell(*traded); }));
+            strategy_threads.push_back(std::thread(
+                trade, [strategy, traded]() { strategy->buy(*traded); }));
         }
     }
 
-    // wait for endless threads
-    for (auto& buyer : buy_strategies) {
-        buyer.join();
+    // endless threads: wait for a failure
+    stop->wait();
+    decisor_thread.join();
+    reconciler_thread.join();
+    reporter_thread.join();
+
+    // A strategy waiting for the feedback of a message not executed would
+    // never return: give it a failed one, until every strategy returned.
+    // The messages still in the shared channel are executed by the
+    // decisors of the other markets, if any: drain it only without them
+    auto state = _state(market);
+    auto drop = [&](const message_t& message) {
+        auto order = message.order;
+        order.txid = "";
+        _feedback(market, message, order);
+    };
+    while (true) {
+        std::map<std::uint64_t, message_t> pending;
+        {
+            std::lock_guard<std::mutex> lock(state->pending_mux);
+            pending.swap(state->pending);
+        }
+        for (const auto& [trace, message] : pending) {
+            drop(message);
+        }
+        message_t message;
+        while (_decisors == 0 && _chan->get(message, false)) {
+            drop(message);
+        }
+        if (running == 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
-    for (auto& seller : sell_strategies) {
-        seller.join();
+    for (auto& strategy_thread : strategy_threads) {
+        strategy_thread.join();
     }
-    decisor_thread.join();
+
+    std::rethrow_exception(failure);
 }
 
 }  // end namespace atd
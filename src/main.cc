@@ -13,96 +13,81 @@
  * limitations under the License.*/
 
 #include <spdlog/sinks/rotating_file_sink.h>
-#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <atd/backtest.hpp>
 #include <atd/channel.hpp>
+#include <atd/clock.hpp>
 #include <atd/config.hpp>
 #include <atd/datamonitor.hpp>
+#include <atd/logging.hpp>
+#include <atd/metrics.hpp>
+#include <atd/retry.hpp>
+#include <atd/supervisor.hpp>
+#include <atd/tape.hpp>
+#include <atd/tracing.hpp>
 #include <atd/trader.hpp>
 #include <atd/types.hpp>
-#include <condition_variable>
+#include <chrono>
+#include <csignal>
+#include <ctime>
+#include <fstream>
 #include <stdexcept>
+#include <string>
 #include <thread>
 
 using namespace atd;
 
-std::mutex mux;
-std::condition_variable thread_exception_condtion;
-
-static std::exception_ptr currencies_monitor_thread_except;
-static std::exception_ptr pairs_monitor_thread_except;
-static std::exception_ptr intramarket_trader;
-
-void exception_handler(std::shared_ptr<spdlog::logger> error_logger)
+int main(int argc, char* argv[])
 {
-    while (true) {
-        // wait until exception
-        std::unique_lock<std::mutex> lock(mux);
-        thread_exception_condtion.wait(lock);
-
-        // if here, exception has been thrown
-        // and this thread has the lock
-        std::string tid;
-        try {
-            if (currencies_monitor_thread_except) {
-                tid = "currencies monitor";
-                std::rethrow_exception(currencies_monitor_thread_except);
-            }
-            if (pairs_monitor_thread_except) {
-                tid = "pairs monitor";
-                std::rethrow_exception(pairs_monitor_thread_except);
-            }
-            if (intramarket_trader) {
-                tid = "intramarket profit maker";
-                std::rethrow_exception(intramarket_trader);
-            }
-        }
-        catch (const at::response_error& e) {
-            // pair unavailable for trade, for instance
-            error_logger->error("{}: at::response_error: {}", tid, e.what());
-        }
-        catch (const at::server_error& e) {
-            error_logger->error("{}: at::server_error: {}", tid, e.what());
-        }
-        catch (const curlpp::RuntimeError& e) {
-            error_logger->error("{}: curlpp::RuntimeError: {}", tid, e.what());
-        }
-        catch (const curlpp::LogicError& e) {
-            error_logger->error("{}: curlpp::LogicError: {}", tid, e.what());
-        }
-        catch (const std::logic_error& e) {
-            error_logger->error("{}: std::logic_error: {}", tid, e.what());
-        }
-        catch (const std::runtime_error& e) {
-            error_logger->error("{}: std::runtime_error {}", tid, e.what());
-        }
-        catch (...) {
-            error_logger->error("{}: {}: unknown failure", tid,
-                                typeid(std::current_exception()).name());
-        }
-
-        // discard lock
-        lock.unlock();
-    }
-}
+    // SIGUSR1 dumps the traces of the orders. Blocked before starting any
+    // thread, so that it's received only by the thread waiting for it
+    sigset_t trace_signals;
+    sigemptyset(&trace_signals);
+    sigaddset(&trace_signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &trace_signals, nullptr);
 
-int main()
-{
     // If we cant' create table, let the process die brutally
     SQLite::Database db("db.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
     // Same future for the configuration file
     Config config("config.json");
+    // Every component logs through the same asynchronous pipeline: logging
+    // never blocks the trading threads
+    init_logging(config.logging());
+
+    // openatd --backtest replays the saved history through the configured
+    // strategies, on a virtual clock, and reports their PnL
+    if (argc > 1 && std::string(argv[1]) == "--backtest") {
+        Backtest backtest(&db, config.monitorPeriod(),
+                          config.correlationWindow(), config.backtest(),
+                          config.retryPolicy(), std::make_shared<Metrics>());
+        backtest.run(config.strategies(backtest.monitors(), backtest.chan()));
+        spdlog::shutdown();
+        return 0;
+    }
+
+    // Every call to the APIs goes through the tape, that records or replays
+    // them when configured
+    auto tape = std::make_shared<Tape>(config.tape());
     // From config, instantiate configured markets and exchanges
-    auto markets = config.markets();
+    auto markets = config.markets(tape);
     auto exchanges = config.exchanges();
 
+    // Registry of the metrics, served if configured
+    auto metrics = std::make_shared<Metrics>();
+
     // Create monitor object, used by the monitor threads
-    auto monitors = std::make_shared<DataMonitor>(&db, config.monitorPeriod());
+    auto retry_policy = config.retryPolicy();
+    auto monitors = std::make_shared<DataMonitor>(
+        &db, config.monitorPeriod(), config.correlationWindow(), retry_policy,
+        tape, metrics, std::make_shared<SystemClock>());
 
     // Create channel of message_t
     std::shared_ptr<channel<atd::message_t>> chan =
         std::make_shared<channel<atd::message_t>>();
+    metrics->gauge("atd_channel_depth",
+                   "Messages sent by the strategies, waiting for the trader",
+                   {{"channel", "orders"}}, [chan]() { return chan->size(); });
 
     // Create the trading strategies
     // pass the monitor and the shared channel.
@@ -111,106 +96,101 @@ int main()
     // If, instead, we're here, we handle the execution of everything,
     // logging every exception to the error_logger. When an exceptin
     // occurs, log it on the error_logger, wait for 2 seconds and retry.
-    auto error_logger = spdlog::rotating_logger_mt(
-        "file_error_logger", "error.log", 1024 * 1024 * 5, 3);
+    auto error_logger = component_logger(
+        "file_error_logger",
+        {std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
+            "error.log", 1024 * 1024 * 5, 3)});
 
     // console logger is used to show messages, instead of cout
-    auto console_logger = spdlog::stdout_color_mt("console");
+    auto console_logger = component_logger("console");
 
     // Creater treader object
-    Trader trader(monitors, chan, error_logger, console_logger);
-
-    // Thread for exception logging
-    std::thread handler([&]() {
-        console_logger->info("Started exception handler thread");
-        exception_handler(error_logger);
-    });
-
-    // Thread that monitors coinmarketcap and saves infos about
-    // monitored pairs
-    std::thread pairs_monitor_thread([&]() {
-        auto pairs = config.monitorPairs();
-        std::ostringstream oss;
-        for (const auto& pair : pairs) {
-            oss << pair;
-            oss << " ";
+    Trader trader(monitors, chan, error_logger, component_logger("trader"),
+                  config.trader(), metrics);
+
+    // Thread that serves the metrics
+    auto metrics_config = config.metrics();
+    std::thread metrics_thread([&]() {
+        if (!metrics_config.enabled) {
+            return;
         }
-        console_logger->info("Started pairs_monitor thread\nMonitoring: {}",
-                             oss.str());
-        while (true) {
-            try {
-                // monitors.pairs is a never ending function. It ends
-                // only when an exception is thrown
-                monitors->pairs(pairs);
-            }
-            catch (...) {
-                // acquire lock
-                std::lock_guard<std::mutex> lock(mux);
-                pairs_monitor_thread_except = std::current_exception();
-                // wake up exception handler
-                thread_exception_condtion.notify_one();
-                // lock is released when lock goes out of scope
-            }
+        console_logger->info("Serving metrics on http://{}:{}/metrics",
+                             metrics_config.address, metrics_config.port);
+        try {
+            MetricsServer(metrics, metrics_config).serve();
         }
-    });
-
-    // Thread that monitors coinmarketcap and saves info about
-    // monitored currencies
-    std::thread currencies_monitor_thread([&]() {
-        std::ostringstream oss;
-        auto currencies = config.monitorCurrencies();
-        for (const auto& currency : currencies) {
-            oss << currency;
-            oss << " ";
+        catch (const std::exception& e) {
+            // the daemon can work without metrics
+            error_logger->error("metrics: {}", e.what());
         }
+    });
 
-        console_logger->info(
-            "Started currencies_monitor thread. Monitoring: {}", oss.str());
-        while (true) {
-            try {
-                // monitors.currencies is a never ending function. It
-                // ends only when an exception is thrown
-                monitors->currencies(currencies);
+    // Thread that dumps the traces on SIGUSR1. Waits forever: detached
+    std::thread([&]() {
+        int signal;
+        while (sigwait(&trace_signals, &signal) == 0) {
+            auto path =
+                "atd-trace-" + std::to_string(std::time(nullptr)) + ".json";
+            std::ofstream out(path);
+            Tracer::dump(out);
+            if (out) {
+                console_logger->info("Traces dumped to {}", path);
             }
-            catch (...) {
-                // acquire lock
-                std::lock_guard<std::mutex> lock(mux);
-                currencies_monitor_thread_except = std::current_exception();
-                // wake up exception handler
-                thread_exception_condtion.notify_one();
-                // lock is released when lock goes out of scope
+            else {
+                error_logger->error("Traces not dumped to {}", path);
             }
         }
-    });
+    }).detach();
 
-    // Threads for treader.intramarket
-    std::vector<std::thread> intramarket_trading_threads;
+    // Every never ending function runs in a worker of the supervisor:
+    // restarted with backoff when it fails, reported when its heartbeat
+    // stops
+    Supervisor supervisor(retry_policy, config.supervisor(), error_logger,
+                          console_logger, metrics);
+
+    // Worker that monitors coinmarketcap and saves infos about
+    // monitored pairs
+    auto pairs = config.monitorPairs();
+    std::ostringstream pairs_oss;
+    for (const auto& pair : pairs) {
+        pairs_oss << pair;
+        pairs_oss << " ";
+    }
+    console_logger->info("Monitoring pairs: {}", pairs_oss.str());
+    supervisor.supervise("pairs monitor",
+                         [&](std::shared_ptr<Heartbeat> heartbeat) {
+                             // never ending, unless an exception is thrown
+                             monitors->pairs(pairs, heartbeat);
+                         });
+
+    // Worker that monitors coinmarketcap and saves info about
+    // monitored currencies
+    auto currencies = config.monitorCurrencies();
+    std::ostringstream currencies_oss;
+    for (const auto& currency : currencies) {
+        currencies_oss << currency;
+        currencies_oss << " ";
+    }
+    console_logger->info("Monitoring currencies: {}", currencies_oss.str());
+    supervisor.supervise("currencies monitor",
+                         [&](std::shared_ptr<Heartbeat> heartbeat) {
+                             // never ending, unless an exception is thrown
+                             monitors->currencies(currencies, heartbeat);
+                         });
+
+    // Workers for treader.intramarket
     for (const auto& market : markets) {
-        intramarket_trading_threads.push_back(std::thread([&]() {
-            console_logger->info("Started trader.intramareket for market: {}",
-                                 market.first);
-            while (true) {
-                try {
-                    trader.intramarket(market.second, strategies);
-                }
-                catch (...) {
-                    // acquire lock
-                    std::lock_guard<std::mutex> lock(mux);
-                    intramarket_trader = std::current_exception();
-                    // wake up exception handler
-                    thread_exception_condtion.notify_one();
-                    // lock is released when lock goes out of scope
-                }
-            }
-        }));
+        supervisor.supervise("intramarket " + market.first,
+                             [&](std::shared_ptr<Heartbeat> heartbeat) {
+                                 trader.intramarket(market.first,
+                                                    market.second, strategies,
+                                                    heartbeat);
+                             });
     }
 
-    // Daemonize: wait for endless threads
-    currencies_monitor_thread.join();
-    pairs_monitor_thread.join();
-    for (auto& thread : intramarket_trading_threads) {
-        thread.join();
-    }
+    // Daemonize: supervise the endless workers
+    supervisor.run();
+    metrics_thread.join();
 
     // should be never reached
     return 0;
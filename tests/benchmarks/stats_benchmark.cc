@@ -0,0 +1,201 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <benchmark/benchmark.h>
+#include <atd/stats/ExponentialSmoothing.hpp>
+#include <atd/stats/namespace.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace atd::stats;
+
+namespace {
+
+template <typename T>
+std::vector<T> series(std::size_t n)
+{
+    std::mt19937 rng(42);
+    std::normal_distribution<double> step(0, 1);
+    std::vector<T> ret(n);
+    for (auto& x : ret) {
+        x = static_cast<T>(1000 + step(rng));
+    }
+    return ret;
+}
+
+// _isa returns the instruction set of the benchmark, false if the CPU
+// doesn't support it
+bool _isa(benchmark::State& state, isa_t& isa)
+{
+    isa = static_cast<isa_t>(state.range(0));
+    if (!supported(isa)) {
+        state.SkipWithError("instruction set not supported");
+        return false;
+    }
+    state.SetLabel(isa_name(isa));
+    return true;
+}
+
+void _isa_args(benchmark::internal::Benchmark* benchmark)
+{
+    for (auto isa :
+         {isa_t::scalar, isa_t::sse2, isa_t::avx2, isa_t::avx512}) {
+        for (auto n : {1000, 100000}) {
+            benchmark->Args({static_cast<long>(isa), n});
+        }
+    }
+}
+
+}  // namespace
+
+// Kernels, per instruction set: range(0) is the isa, range(1) the samples
+
+template <typename T>
+static void BM_Moments(benchmark::State& state)
+{
+    isa_t isa;
+    if (!_isa(state, isa)) {
+        return;
+    }
+    const auto& build = kernels<T>(isa);
+    auto x = series<T>(state.range(1));
+    T sums[2];
+    for (auto _ : state) {
+        build.moments(x.data(), x.size(), x[0], sums);
+        benchmark::DoNotOptimize(sums);
+    }
+    state.SetItemsProcessed(state.iterations() * x.size());
+}
+BENCHMARK_TEMPLATE(BM_Moments, float)->Apply(_isa_args);
+BENCHMARK_TEMPLATE(BM_Moments, double)->Apply(_isa_args);
+
+template <typename T>
+static void BM_Comoments(benchmark::State& state)
+{
+    isa_t isa;
+    if (!_isa(state, isa)) {
+        return;
+    }
+    const auto& build = kernels<T>(isa);
+    auto x = series<T>(state.range(1));
+    auto y = series<T>(state.range(1));
+    T sums[5];
+    for (auto _ : state) {
+        build.comoments(x.data(), y.data(), x.size(), x[0], y[0], sums);
+        benchmark::DoNotOptimize(sums);
+    }
+    state.SetItemsProcessed(state.iterations() * x.size());
+}
+BENCHMARK_TEMPLATE(BM_Comoments, float)->Apply(_isa_args);
+BENCHMARK_TEMPLATE(BM_Comoments, double)->Apply(_isa_args);
+
+template <typename T>
+static void BM_Correlate(benchmark::State& state)
+{
+    isa_t isa;
+    if (!_isa(state, isa)) {
+        return;
+    }
+    const auto& build = kernels<T>(isa);
+    auto signal = series<T>(state.range(1));
+    // the gaussian kernel of BuyLowAndHodl
+    std::vector<T> taps(71, T(1) / 71);
+    std::vector<T> out(signal.size() - taps.size() + 1);
+    for (auto _ : state) {
+        build.correlate(signal.data(), signal.size(), taps.data(),
+                        taps.size(), out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * signal.size());
+}
+BENCHMARK_TEMPLATE(BM_Correlate, float)->Apply(_isa_args);
+BENCHMARK_TEMPLATE(BM_Correlate, double)->Apply(_isa_args);
+
+// Statistics on the best instruction set: range(0) is the samples
+
+template <typename T>
+static void BM_MeanStdev(benchmark::State& state)
+{
+    auto x = series<T>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mean_stdev(x));
+    }
+    state.SetItemsProcessed(state.iterations() * x.size());
+}
+BENCHMARK_TEMPLATE(BM_MeanStdev, double)->Arg(1000)->Arg(100000);
+// generic code, for comparison
+BENCHMARK_TEMPLATE(BM_MeanStdev, long double)->Arg(1000)->Arg(100000);
+
+template <typename T>
+static void BM_Pearson(benchmark::State& state)
+{
+    auto x = series<T>(state.range(0));
+    auto y = series<T>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(pearson(x, y));
+    }
+    state.SetItemsProcessed(state.iterations() * x.size());
+}
+BENCHMARK_TEMPLATE(BM_Pearson, double)->Arg(1000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_Pearson, long double)->Arg(1000)->Arg(100000);
+
+template <typename T>
+static void BM_LeastSquares(benchmark::State& state)
+{
+    auto x = series<T>(state.range(0));
+    auto y = series<T>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(least_squares(x, y));
+    }
+    state.SetItemsProcessed(state.iterations() * x.size());
+}
+BENCHMARK_TEMPLATE(BM_LeastSquares, double)->Arg(1000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_LeastSquares, long double)->Arg(1000)->Arg(100000);
+
+template <typename T>
+static void BM_Conv(benchmark::State& state)
+{
+    auto signal = series<T>(state.range(0));
+    auto kernel = gaussian1d(71, 5);
+    std::vector<T> taps(kernel.begin(), kernel.end());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(conv(signal, taps));
+    }
+    state.SetItemsProcessed(state.iterations() * signal.size());
+}
+BENCHMARK_TEMPLATE(BM_Conv, double)->Arg(5000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_Conv, long double)->Arg(5000)->Arg(100000);
+
+// Streaming smoothers: a push and a forecast per sample, range(0) is 1 for
+// Holt's smoother, 0 for Brown's
+
+template <typename T>
+static void BM_ExponentialSmoothing(benchmark::State& state)
+{
+    auto x = series<T>(100000);
+    auto smoothing = state.range(0) ? ExponentialSmoothing<T>(0.5, 0.1)
+                                    : ExponentialSmoothing<T>(0.5);
+    state.SetLabel(state.range(0) ? "holt" : "brown");
+    for (auto _ : state) {
+        smoothing.reset();
+        for (auto sample : x) {
+            smoothing.push(sample);
+            benchmark::DoNotOptimize(smoothing.forecast());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * x.size());
+}
+BENCHMARK_TEMPLATE(BM_ExponentialSmoothing, float)->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_ExponentialSmoothing, double)->Arg(0)->Arg(1);
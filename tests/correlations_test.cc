@@ -0,0 +1,226 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <gtest/gtest.h>
+#include <atd/correlations.hpp>
+#include <atd/stats/CorrelationMatrix.hpp>
+#include <atd/stats/namespace.hpp>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace atd;
+using namespace std::chrono_literals;
+
+namespace {
+
+// rows of assets correlated returns, around a large mean: the sums lose
+// precision if they aren't shifted
+std::vector<std::vector<double>> rows(std::size_t n, std::size_t assets,
+                                      unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0, 1);
+    std::vector<std::vector<double>> ret(n, std::vector<double>(assets));
+    for (auto& row : ret) {
+        auto market = noise(rng);
+        for (std::size_t i = 0; i < assets; ++i) {
+            row[i] = 1000 + (i % 3) * market + noise(rng);
+        }
+    }
+    return ret;
+}
+
+// column returns the values of asset in the rows [first, last)
+std::vector<double> column(const std::vector<std::vector<double>>& rows,
+                           std::size_t asset, std::size_t first,
+                           std::size_t last)
+{
+    std::vector<double> ret;
+    for (auto r = first; r < last; ++r) {
+        ret.push_back(rows[r][asset]);
+    }
+    return ret;
+}
+
+// expect_pearson checks every correlation of matrix against pearson over
+// the rows [first, last)
+void expect_pearson(const stats::CorrelationMatrix& matrix,
+                    const std::vector<std::vector<double>>& rows,
+                    std::size_t first, std::size_t last)
+{
+    for (std::size_t i = 0; i < matrix.assets(); ++i) {
+        auto x = column(rows, i, first, last);
+        for (std::size_t j = 0; j < matrix.assets(); ++j) {
+            auto y = column(rows, j, first, last);
+            ASSERT_NEAR(matrix.correlation(i, j), stats::pearson(x, y), 1e-9)
+                << "assets " << i << ", " << j << " rows " << first << "-"
+                << last;
+        }
+    }
+}
+
+}  // namespace
+
+TEST(CorrelationMatrixTest, PushMatchesPearsonOverManyWindows)
+{
+    std::size_t window = 50;
+    auto values = rows(20 * window + 7, 6, 1);
+    stats::CorrelationMatrix matrix(6, window);
+    for (std::size_t r = 0; r < values.size(); ++r) {
+        matrix.push(values[r]);
+        auto count = std::min(r + 1, window);
+        ASSERT_EQ(matrix.count(), count);
+        if (count >= 2) {
+            expect_pearson(matrix, values, r + 1 - count, r + 1);
+        }
+    }
+    EXPECT_TRUE(matrix.full());
+}
+
+TEST(CorrelationMatrixTest, ParallelBuildMatchesSingleThread)
+{
+    // more assets than a tile: the pairs are split among the threads
+    std::size_t assets = 40, window = 200;
+    auto values = rows(3 * window, assets, 2);
+    std::vector<std::vector<double>> columns;
+    std::vector<column_view<double>> views;
+    for (std::size_t i = 0; i < assets; ++i) {
+        columns.push_back(column(values, i, 0, values.size()));
+    }
+    for (const auto& values_of : columns) {
+        views.push_back(values_of);
+    }
+    stats::CorrelationMatrix single(assets, window), parallel(assets, window);
+    single.build(views, 1);
+    parallel.build(views, 4);
+    ASSERT_EQ(parallel.count(), window);
+    EXPECT_EQ(parallel.matrix(), single.matrix());
+    expect_pearson(parallel, values, values.size() - window, values.size());
+
+    // the pushes go on from the window built
+    auto more = rows(window + 13, assets, 3);
+    for (const auto& row : more) {
+        single.push(row);
+        parallel.push(row);
+        values.push_back(row);
+    }
+    EXPECT_EQ(parallel.matrix(), single.matrix());
+    expect_pearson(parallel, values, values.size() - window, values.size());
+}
+
+TEST(CorrelationMatrixTest, ConstantAssetIsNaN)
+{
+    auto values = rows(500, 3, 4);
+    stats::CorrelationMatrix matrix(3, 40);
+    for (auto& row : values) {
+        row[1] = 42;
+        matrix.push(row);
+    }
+    EXPECT_TRUE(std::isnan(matrix.correlation(0, 1)));
+    EXPECT_TRUE(std::isnan(matrix.correlation(1, 1)));
+    EXPECT_FALSE(std::isnan(matrix.correlation(0, 2)));
+}
+
+TEST(CorrelationMatrixTest, InvalidWindow)
+{
+    EXPECT_THROW(stats::CorrelationMatrix(3, 1), std::invalid_argument);
+}
+
+TEST(CorrelationEngineTest, MissedPricesRepeatThePreviousOne)
+{
+    std::vector<std::string> currencies = {"btc", "eth", "ltc"};
+    std::size_t window = 30;
+    CorrelationEngine engine(window);
+    engine.start(currencies,
+                 std::vector<TimeSeries>(3, TimeSeries({"price_usd"})), 60s);
+    EXPECT_EQ(engine.snapshot()->samples, 0u);
+
+    std::mt19937 rng(5);
+    std::normal_distribution<double> noise(0, 0.01);
+    std::uniform_int_distribution<int> missed(0, 9);
+    std::vector<double> last(3, 0);
+    // the log returns the engine should see, one column per currency
+    std::vector<std::vector<double>> returns(3);
+    std::vector<double> prices = {10000, 300, 50};
+    for (std::time_t round = 1; round <= 200; ++round) {
+        auto market = noise(rng);
+        std::vector<double> pushed(3);
+        for (std::size_t i = 0; i < 3; ++i) {
+            prices[i] *= std::exp(market + noise(rng));
+            // not fetched: 0, or a negative price
+            pushed[i] = missed(rng) == 0 ? (round % 2 ? 0 : -1) : prices[i];
+        }
+        bool primed = last[0] > 0 && last[1] > 0 && last[2] > 0;
+        for (std::size_t i = 0; i < 3; ++i) {
+            auto price = pushed[i] > 0 ? pushed[i] : last[i];
+            if (primed) {
+                returns[i].push_back(std::log(price / last[i]));
+            }
+            last[i] = price;
+        }
+        engine.push(round * 60, pushed);
+    }
+
+    auto snapshot = engine.snapshot();
+    ASSERT_EQ(snapshot->samples, window);
+    EXPECT_EQ(snapshot->time, 200 * 60);
+    auto first = returns[0].size() - window;
+    for (std::size_t i = 0; i < 3; ++i) {
+        std::vector<double> x(returns[i].begin() + first, returns[i].end());
+        for (std::size_t j = 0; j < 3; ++j) {
+            std::vector<double> y(returns[j].begin() + first,
+                                  returns[j].end());
+            EXPECT_NEAR(snapshot->matrix[i * 3 + j], stats::pearson(x, y),
+                        1e-9);
+        }
+    }
+    EXPECT_EQ(engine.correlation("BTC", "eth"), snapshot->matrix[1]);
+    EXPECT_THROW(engine.correlation("btc", "xmr"), std::out_of_range);
+}
+
+TEST(CorrelationEngineTest, StartFromTheHistories)
+{
+    std::size_t window = 20;
+    auto values = rows(60, 2, 6);
+    std::vector<TimeSeries> histories(2, TimeSeries({"price_usd"}));
+    for (std::size_t r = 0; r < values.size(); ++r) {
+        for (std::size_t i = 0; i < 2; ++i) {
+            histories[i].append(static_cast<std::time_t>(r) * 60,
+                                {values[r][i]});
+        }
+    }
+    CorrelationEngine engine(window);
+    engine.start({"btc", "eth"}, histories, 60s);
+    auto snapshot = engine.snapshot();
+    ASSERT_EQ(snapshot->samples, window);
+    EXPECT_EQ(snapshot->time, 59 * 60);
+
+    // log returns of the last window rows
+    std::vector<double> x, y;
+    for (auto r = values.size() - window; r < values.size(); ++r) {
+        x.push_back(std::log(values[r][0] / values[r - 1][0]));
+        y.push_back(std::log(values[r][1] / values[r - 1][1]));
+    }
+    EXPECT_NEAR(engine.correlation("btc", "eth"), stats::pearson(x, y), 1e-9);
+
+    // the next round goes on from the last price of the histories
+    engine.push(60 * 60, {values.back()[0] * 1.01, values.back()[1]});
+    x.erase(x.begin());
+    y.erase(y.begin());
+    x.push_back(std::log(1.01));
+    y.push_back(0);
+    EXPECT_NEAR(engine.correlation("btc", "eth"), stats::pearson(x, y), 1e-9);
+}
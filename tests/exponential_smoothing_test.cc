@@ -0,0 +1,165 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <gtest/gtest.h>
+#include <atd/stats/ExponentialSmoothing.hpp>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace atd::stats;
+
+namespace {
+
+std::vector<double> series(std::size_t n, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> step(0, 1);
+    std::vector<double> ret(n);
+    double price = 100;
+    for (auto& x : ret) {
+        x = price += step(rng);
+    }
+    return ret;
+}
+
+// Batch definitions, recomputed from the first sample, in long double. They
+// return the forecast m steps after the first n samples of x
+
+long double brown_forecast(const std::vector<double>& x, std::size_t n,
+                           long double alpha, std::size_t m)
+{
+    std::vector<long double> s1(n), s2(n);
+    s1[0] = s2[0] = x[0];
+    for (std::size_t t = 1; t < n; ++t) {
+        s1[t] = alpha * x[t] + (1 - alpha) * s1[t - 1];
+        s2[t] = alpha * s1[t] + (1 - alpha) * s2[t - 1];
+    }
+    auto level = 2 * s1[n - 1] - s2[n - 1];
+    auto trend = alpha / (1 - alpha) * (s1[n - 1] - s2[n - 1]);
+    return level + m * trend;
+}
+
+long double holt_forecast(const std::vector<double>& x, std::size_t n,
+                          long double alpha, long double beta, std::size_t m)
+{
+    std::vector<long double> level(n), trend(n);
+    level[0] = x[0];
+    trend[0] = 0;
+    if (n > 1) {
+        level[1] = x[1];
+        trend[1] = x[1] - x[0];
+    }
+    for (std::size_t t = 2; t < n; ++t) {
+        level[t] =
+            alpha * x[t] + (1 - alpha) * (level[t - 1] + trend[t - 1]);
+        trend[t] = beta * (level[t] - level[t - 1]) + (1 - beta) * trend[t - 1];
+    }
+    return level[n - 1] + m * trend[n - 1];
+}
+
+}  // namespace
+
+TEST(ExponentialSmoothingTest, BrownMatchesBatch)
+{
+    auto x = series(500, 1);
+    for (double alpha : {0.05, 0.3, 0.9}) {
+        ExponentialSmoothing<double> smoothing(alpha);
+        for (std::size_t n = 1; n <= x.size(); ++n) {
+            smoothing.push(x[n - 1]);
+            ASSERT_EQ(smoothing.count(), n);
+            for (std::size_t m : {1, 10}) {
+                EXPECT_NEAR(smoothing.forecast(m),
+                            brown_forecast(x, n, alpha, m), 1e-8);
+            }
+        }
+    }
+}
+
+TEST(ExponentialSmoothingTest, HoltMatchesBatch)
+{
+    auto x = series(500, 2);
+    for (auto [alpha, beta] : {std::pair(0.5, 0.1), std::pair(0.2, 0.8),
+                               std::pair(1.0, 1.0)}) {
+        ExponentialSmoothing<double> smoothing(alpha, beta);
+        for (std::size_t n = 1; n <= x.size(); ++n) {
+            smoothing.push(x[n - 1]);
+            ASSERT_EQ(smoothing.count(), n);
+            for (std::size_t m : {1, 10}) {
+                EXPECT_NEAR(smoothing.forecast(m),
+                            holt_forecast(x, n, alpha, beta, m), 1e-8);
+            }
+        }
+    }
+}
+
+TEST(ExponentialSmoothingTest, ResetForgetsTheSamples)
+{
+    auto x = series(100, 3);
+    ExponentialSmoothing<double> smoothing(0.5, 0.5);
+    for (auto sample : x) {
+        smoothing.push(sample);
+    }
+    smoothing.reset();
+    EXPECT_EQ(smoothing.count(), 0u);
+    for (std::size_t n = 1; n <= 10; ++n) {
+        smoothing.push(x[n - 1]);
+    }
+    EXPECT_NEAR(smoothing.forecast(), holt_forecast(x, 10, 0.5, 0.5, 1),
+                1e-9);
+}
+
+TEST(ExponentialSmoothingTest, HoltForecastsALine)
+{
+    // the first trend is the slope: the line is tracked from the start
+    ExponentialSmoothing<double> smoothing(0.3, 0.2);
+    for (int t = 0; t < 50; ++t) {
+        smoothing.push(2 + 0.5 * t);
+        if (t > 0) {
+            EXPECT_NEAR(smoothing.level(), 2 + 0.5 * t, 1e-9);
+            EXPECT_NEAR(smoothing.trend(), 0.5, 1e-9);
+            EXPECT_NEAR(smoothing.forecast(10), 2 + 0.5 * (t + 10), 1e-9);
+        }
+    }
+}
+
+TEST(ExponentialSmoothingTest, BrownForecastsALine)
+{
+    // the trend starts at 0 and converges to the slope
+    ExponentialSmoothing<double> smoothing(0.3);
+    for (int t = 0; t < 200; ++t) {
+        smoothing.push(2 - 0.5 * t);
+    }
+    EXPECT_NEAR(smoothing.level(), 2 - 0.5 * 199, 1e-9);
+    EXPECT_NEAR(smoothing.trend(), -0.5, 1e-9);
+    EXPECT_NEAR(smoothing.forecast(10), 2 - 0.5 * 209, 1e-9);
+}
+
+TEST(ExponentialSmoothingTest, InvalidFactorsThrow)
+{
+    auto nan = std::numeric_limits<double>::quiet_NaN();
+    for (double alpha : {0.0, 1.0, -0.1, 1.5, nan}) {
+        EXPECT_THROW(ExponentialSmoothing<double>{alpha},
+                     std::invalid_argument);
+    }
+    for (auto [alpha, beta] :
+         {std::pair(0.0, 0.5), std::pair(0.5, 0.0), std::pair(1.5, 0.5),
+          std::pair(0.5, 1.5), std::pair(nan, 0.5), std::pair(0.5, nan)}) {
+        EXPECT_THROW((ExponentialSmoothing<double>{alpha, beta}),
+                     std::invalid_argument);
+    }
+    EXPECT_NO_THROW((ExponentialSmoothing<double>{1, 1}));
+}
@@ -0,0 +1,111 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <gtest/gtest.h>
+#include <atd/stats/GaussianSmoothing.hpp>
+#include <atd/stats/namespace.hpp>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace atd::stats;
+
+namespace {
+
+std::vector<double> series(std::size_t n, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> step(0, 1);
+    std::vector<double> ret(n);
+    double price = 100;
+    for (auto& x : ret) {
+        x = price += step(rng);
+    }
+    return ret;
+}
+
+void expect_conv(const std::vector<double>& signal, std::size_t length,
+                 double sigma)
+{
+    auto expected = conv(signal, gaussian1d(length, sigma));
+    auto actual = GaussianSmoothing(length, sigma).smooth(signal);
+    ASSERT_EQ(actual.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_NEAR(actual[i], expected[i], 1e-9);
+    }
+}
+
+}  // namespace
+
+TEST(GaussianSmoothingTest, CloseSigmasShareTheKernel)
+{
+    auto kernel = GaussianSmoothing::kernel(71, 5);
+    EXPECT_EQ(kernel, GaussianSmoothing::kernel(71, 5 + 1e-6));
+    EXPECT_EQ(kernel, GaussianSmoothing::kernel(71, 5 - 1e-6));
+    EXPECT_NE(kernel, GaussianSmoothing::kernel(71, 6));
+    EXPECT_NE(kernel, GaussianSmoothing::kernel(73, 5));
+}
+
+TEST(GaussianSmoothingTest, ConcurrentBuildsShareTheKernel)
+{
+    std::vector<std::shared_ptr<const GaussianSmoothing::kernel_t>> kernels(
+        8);
+    std::vector<std::thread> threads;
+    for (auto& kernel : kernels) {
+        threads.emplace_back(
+            [&kernel]() { kernel = GaussianSmoothing::kernel(75, 3.25); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::set<const GaussianSmoothing::kernel_t*> distinct;
+    for (const auto& kernel : kernels) {
+        distinct.insert(kernel.get());
+    }
+    EXPECT_EQ(distinct.size(), 1u);
+}
+
+TEST(GaussianSmoothingTest, DirectPathDoesNotTransform)
+{
+    auto signal = series(1000, 1);
+    expect_conv(signal, 71, 7);
+    EXPECT_FALSE(GaussianSmoothing::kernel(71, 7)->spectrum.has_value());
+}
+
+TEST(GaussianSmoothingTest, OverlapAddMatchesConv)
+{
+    // longer than the direct convolution of any ISA
+    auto signal = series(20000, 2);
+    expect_conv(signal, 801, 100);
+    EXPECT_TRUE(GaussianSmoothing::kernel(801, 100)->spectrum.has_value());
+}
+
+TEST(GaussianSmoothingTest, PushMatchesSmooth)
+{
+    auto signal = series(500, 3);
+    GaussianSmoothing smoothing(71, 7);
+    auto expected = smoothing.smooth(signal);
+    std::vector<double> actual;
+    for (auto sample : signal) {
+        double smoothed;
+        if (smoothing.push(sample, smoothed)) {
+            actual.push_back(smoothed);
+        }
+    }
+    ASSERT_EQ(actual.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_NEAR(actual[i], expected[i], 1e-9);
+    }
+}
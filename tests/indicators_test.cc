@@ -0,0 +1,137 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <gtest/gtest.h>
+#include <atd/indicators.hpp>
+#include <algorithm>
+#include <ctime>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace atd;
+
+namespace {
+
+typedef struct {
+    std::time_t time;
+    double value;
+} sample_t;
+
+// samples at irregular times, 1 to 5 minutes apart
+std::vector<sample_t> samples(std::size_t n, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> step(0, 1);
+    std::uniform_int_distribution<std::time_t> gap(60, 300);
+    std::vector<sample_t> ret(n);
+    std::time_t time = 1500000000;
+    double x = 0;
+    for (auto& sample : ret) {
+        sample = {time += gap(rng), x += step(rng)};
+    }
+    return ret;
+}
+
+}  // namespace
+
+TEST(IndicatorsTest, ExtremesOfPeriodMatchBruteForce)
+{
+    auto series = samples(2000, 1);
+    auto min = make_indicator({.kind = indicator_kind_t::min, .period = 50});
+    auto max = make_indicator({.kind = indicator_kind_t::max, .period = 50});
+    for (std::size_t i = 0; i < series.size(); ++i) {
+        min->push(series[i].time, series[i].value);
+        max->push(series[i].time, series[i].value);
+        auto first = series.begin() + (i >= 50 ? i - 49 : 0);
+        auto last = series.begin() + i + 1;
+        auto compare = [](const sample_t& a, const sample_t& b) {
+            return a.value < b.value;
+        };
+        EXPECT_EQ(min->value().value,
+                  std::min_element(first, last, compare)->value);
+        EXPECT_EQ(max->value().value,
+                  std::max_element(first, last, compare)->value);
+        EXPECT_EQ(max->value().ready, i + 1 >= 50);
+    }
+}
+
+TEST(IndicatorsTest, ExtremesOfSpanMatchBruteForce)
+{
+    auto series = samples(2000, 2);
+    std::time_t span = 3600;
+    auto min = make_indicator({.kind = indicator_kind_t::min, .span = span});
+    auto max = make_indicator({.kind = indicator_kind_t::max, .span = span});
+    for (std::size_t i = 0; i < series.size(); ++i) {
+        auto now = series[i].time;
+        min->push(now, series[i].value);
+        max->push(now, series[i].value);
+        double expected_min = series[i].value, expected_max = expected_min;
+        for (std::size_t j = 0; j < i; ++j) {
+            if (series[j].time > now - span) {
+                expected_min = std::min(expected_min, series[j].value);
+                expected_max = std::max(expected_max, series[j].value);
+            }
+        }
+        EXPECT_EQ(min->value().value, expected_min);
+        EXPECT_EQ(max->value().value, expected_max);
+        EXPECT_EQ(max->value().ready, now - series[0].time >= span);
+    }
+}
+
+TEST(IndicatorsTest, SpanDropsTheSamplesBeforeAGap)
+{
+    auto max = make_indicator({.kind = indicator_kind_t::max, .span = 3600});
+    max->push(1000, 10);
+    max->push(1060, 5);
+    // a downtime longer than the span: only the new sample is in it
+    max->push(1000 + 86400, -3);
+    EXPECT_EQ(max->value().value, -3);
+    EXPECT_EQ(max->value().time, 1000 + 86400);
+}
+
+TEST(IndicatorsTest, SpanOnlyForExtremes)
+{
+    EXPECT_EQ(indicator_name({.kind = indicator_kind_t::max, .span = 60}),
+              "max(60s)");
+    EXPECT_EQ(indicator_warmup({.kind = indicator_kind_t::min, .span = 60}),
+              0u);
+    EXPECT_THROW(indicator_name({.kind = indicator_kind_t::sma, .span = 60}),
+                 std::invalid_argument);
+    EXPECT_THROW(indicator_name({.kind = indicator_kind_t::min, .span = -1}),
+                 std::invalid_argument);
+    EXPECT_THROW(indicator_name({.kind = indicator_kind_t::min}),
+                 std::invalid_argument);
+}
+
+TEST(IndicatorsTest, WarmupOfSpanLoadsTheSpan)
+{
+    IndicatorEngine engine;
+    std::size_t loaded_n = 1;
+    std::time_t loaded_span = 0;
+    auto max = engine.subscribe(
+        "btc/percent_change_24h", {.kind = indicator_kind_t::max, .span = 600},
+        [&](std::size_t n, std::time_t span) {
+            loaded_n = n;
+            loaded_span = span;
+            return std::vector<std::pair<std::time_t, double>>{{200, 1},
+                                                               {100, 2}};
+        });
+    EXPECT_EQ(loaded_n, 0u);
+    EXPECT_EQ(loaded_span, 600);
+    EXPECT_EQ(max->value().value, 2);
+    EXPECT_EQ(max->value().samples, 2u);
+    engine.push("btc/percent_change_24h", 750, 0);
+    EXPECT_EQ(max->value().value, 1);
+}
@@ -0,0 +1,170 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <gtest/gtest.h>
+#include <atd/stats/kernels.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace atd::stats;
+
+namespace {
+
+// sizes covering the empty series, the scalar tails and several vectors
+const std::vector<std::size_t> sizes = {0, 1, 3, 7, 8, 17, 64, 1001};
+
+std::vector<isa_t> supported_isas()
+{
+    std::vector<isa_t> ret;
+    for (auto isa :
+         {isa_t::scalar, isa_t::sse2, isa_t::avx2, isa_t::avx512}) {
+        if (supported(isa)) {
+            ret.push_back(isa);
+        }
+    }
+    return ret;
+}
+
+// prices: a large mean and small changes
+template <typename T>
+std::vector<T> series(std::size_t n, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> step(0, 1);
+    std::vector<T> ret(n);
+    for (auto& x : ret) {
+        x = static_cast<T>(1000 + step(rng));
+    }
+    return ret;
+}
+
+// the builds sum in different orders: compare the sums relative to the sum
+// of the magnitudes of their terms
+template <typename T>
+void expect_sum_near(T expected, T actual, double magnitude)
+{
+    double epsilon = std::is_same_v<T, float> ? 1e-5 : 1e-12;
+    EXPECT_NEAR(expected, actual, epsilon * std::max(1., magnitude));
+}
+
+}  // namespace
+
+template <typename T>
+class KernelsTest : public ::testing::Test {
+};
+
+typedef ::testing::Types<float, double> FloatingTypes;
+TYPED_TEST_SUITE(KernelsTest, FloatingTypes);
+
+TYPED_TEST(KernelsTest, BestIsaIsSupported)
+{
+    EXPECT_TRUE(supported(best_isa()));
+    EXPECT_TRUE(supported(isa_t::scalar));
+    EXPECT_EQ(kernels<TypeParam>().isa, best_isa());
+}
+
+TYPED_TEST(KernelsTest, MomentsMatchScalar)
+{
+    const auto& reference = kernels<TypeParam>(isa_t::scalar);
+    for (auto isa : supported_isas()) {
+        const auto& build = kernels<TypeParam>(isa);
+        for (auto n : sizes) {
+            SCOPED_TRACE(std::string(isa_name(isa)) + " n=" +
+                         std::to_string(n));
+            auto x = series<TypeParam>(n, 1);
+            TypeParam shift = n > 0 ? x[0] : 0;
+            TypeParam expected[2], actual[2];
+            reference.moments(x.data(), n, shift, expected);
+            build.moments(x.data(), n, shift, actual);
+            expect_sum_near(expected[0], actual[0], 4. * n);
+            expect_sum_near(expected[1], actual[1], 16. * n);
+        }
+    }
+}
+
+TYPED_TEST(KernelsTest, ComomentsMatchScalar)
+{
+    const auto& reference = kernels<TypeParam>(isa_t::scalar);
+    for (auto isa : supported_isas()) {
+        const auto& build = kernels<TypeParam>(isa);
+        for (auto n : sizes) {
+            SCOPED_TRACE(std::string(isa_name(isa)) + " n=" +
+                         std::to_string(n));
+            auto x = series<TypeParam>(n, 2);
+            auto y = series<TypeParam>(n, 3);
+            TypeParam x_shift = n > 0 ? x[0] : 0, y_shift = n > 0 ? y[0] : 0;
+            TypeParam expected[5], actual[5];
+            reference.comoments(x.data(), y.data(), n, x_shift, y_shift,
+                                expected);
+            build.comoments(x.data(), y.data(), n, x_shift, y_shift, actual);
+            expect_sum_near(expected[0], actual[0], 4. * n);
+            expect_sum_near(expected[1], actual[1], 4. * n);
+            for (int i = 2; i < 5; ++i) {
+                expect_sum_near(expected[i], actual[i], 16. * n);
+            }
+        }
+    }
+}
+
+TYPED_TEST(KernelsTest, ScalarMomentsMatchDefinition)
+{
+    std::vector<TypeParam> x = {1, 2, 3, 4, 6};
+    TypeParam sums[2];
+    kernels<TypeParam>(isa_t::scalar).moments(x.data(), x.size(), 1, sums);
+    // differences from 1: 0, 1, 2, 3, 5
+    EXPECT_EQ(sums[0], 11);
+    EXPECT_EQ(sums[1], 39);
+}
+
+TYPED_TEST(KernelsTest, CorrelateMatchesScalar)
+{
+    const auto& reference = kernels<TypeParam>(isa_t::scalar);
+    for (auto isa : supported_isas()) {
+        const auto& build = kernels<TypeParam>(isa);
+        for (std::size_t taps_size : {1, 3, 8, 71}) {
+            for (auto n : sizes) {
+                if (n < taps_size) {
+                    continue;
+                }
+                SCOPED_TRACE(std::string(isa_name(isa)) + " n=" +
+                             std::to_string(n) +
+                             " taps=" + std::to_string(taps_size));
+                auto signal = series<TypeParam>(n, 4);
+                std::vector<TypeParam> taps(taps_size, 1. / taps_size);
+                std::vector<TypeParam> expected(n - taps_size + 1),
+                    actual(n - taps_size + 1);
+                reference.correlate(signal.data(), n, taps.data(), taps_size,
+                                    expected.data());
+                build.correlate(signal.data(), n, taps.data(), taps_size,
+                                actual.data());
+                for (std::size_t i = 0; i < expected.size(); ++i) {
+                    expect_sum_near(expected[i], actual[i], 1001.);
+                }
+            }
+        }
+    }
+}
+
+TYPED_TEST(KernelsTest, ScalarCorrelateMatchesDefinition)
+{
+    std::vector<TypeParam> signal = {1, 2, 3, 4}, taps = {1, 0, -1};
+    std::vector<TypeParam> out(2);
+    kernels<TypeParam>(isa_t::scalar)
+        .correlate(signal.data(), signal.size(), taps.data(), taps.size(),
+                   out.data());
+    EXPECT_EQ(out[0], -2);
+    EXPECT_EQ(out[1], -2);
+}
@@ -0,0 +1,246 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <gtest/gtest.h>
+#include <atd/resample.hpp>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace atd;
+using namespace std::chrono_literals;
+
+namespace {
+
+// samples 0 to 3 minutes apart, duplicated timestamps included, with gaps
+// of up to an hour: many grid steps have no samples
+TimeSeries series(std::size_t n, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> step(0, 1);
+    std::uniform_int_distribution<std::time_t> gap(0, 180);
+    std::uniform_int_distribution<int> pause(0, 20);
+    std::uniform_real_distribution<double> volume(0, 1000);
+    TimeSeries ret({"price_usd", "day_volume_usd"});
+    std::time_t time = 1500000007;
+    double price = 100;
+    for (std::size_t i = 0; i < n; ++i) {
+        ret.append(time, {price += step(rng), i % 7 == 0 ? 0 : volume(rng)});
+        time += pause(rng) == 0 ? 3600 : gap(rng);
+    }
+    return ret;
+}
+
+// Brute force definitions, searching every sample for every grid time
+
+std::vector<std::time_t> grid(const TimeSeries& series, std::time_t step)
+{
+    std::vector<std::time_t> ret;
+    auto time = series.time();
+    if (time.empty()) {
+        return ret;
+    }
+    for (auto t = time.front() - step; t <= time.back() + step; ++t) {
+        if (t % step == 0 && t >= time.front() && t <= time.back()) {
+            ret.push_back(t);
+        }
+    }
+    return ret;
+}
+
+// the index of the last sample at or before t
+std::size_t at(const TimeSeries& series, std::time_t t)
+{
+    std::size_t ret = 0;
+    for (std::size_t i = 0; i < series.size(); ++i) {
+        if (series.time()[i] <= t) {
+            ret = i;
+        }
+    }
+    return ret;
+}
+
+double last(const TimeSeries& series, std::size_t column, std::time_t t)
+{
+    return series.column(column)[at(series, t)];
+}
+
+double linear(const TimeSeries& series, std::size_t column, std::time_t t)
+{
+    auto time = series.time();
+    auto x = series.column(column);
+    auto a = at(series, t);
+    if (a + 1 == series.size()) {
+        return x[a];
+    }
+    auto weight = static_cast<double>(t - time[a]) / (time[a + 1] - time[a]);
+    return x[a] + weight * (x[a + 1] - x[a]);
+}
+
+// the volume weighted mean of the samples in (t - step, t], the plain mean
+// if they have no volume, previous if there are none
+double vwap(const TimeSeries& series, std::size_t column, std::time_t t,
+            std::time_t step, double previous)
+{
+    auto time = series.time();
+    auto x = series.column(column);
+    auto v = series.column("day_volume_usd");
+    double traded = 0, volumes = 0, sum = 0;
+    std::size_t samples = 0;
+    for (std::size_t i = 0; i < series.size(); ++i) {
+        if (time[i] > t - step && time[i] <= t) {
+            traded += v[i] * x[i];
+            volumes += v[i];
+            sum += x[i];
+            ++samples;
+        }
+    }
+    if (samples == 0) {
+        return previous;
+    }
+    return volumes > 0 ? traded / volumes : sum / samples;
+}
+
+}  // namespace
+
+TEST(ResampleTest, LastMatchesBruteForce)
+{
+    auto samples = series(2000, 1);
+    auto resampled = resample(samples, 60s, interpolation_t::last);
+    auto expected = grid(samples, 60);
+    ASSERT_EQ(resampled.size(), expected.size());
+    ASSERT_EQ(resampled.columns(), samples.columns());
+    for (std::size_t k = 0; k < expected.size(); ++k) {
+        auto t = expected[k];
+        ASSERT_EQ(resampled.time()[k], t);
+        for (std::size_t c = 0; c < samples.columns().size(); ++c) {
+            EXPECT_EQ(resampled.column(c)[k], last(samples, c, t));
+        }
+    }
+}
+
+TEST(ResampleTest, LinearMatchesBruteForce)
+{
+    auto samples = series(2000, 2);
+    auto resampled = resample(samples, 60s, interpolation_t::linear);
+    auto expected = grid(samples, 60);
+    ASSERT_EQ(resampled.size(), expected.size());
+    for (std::size_t k = 0; k < expected.size(); ++k) {
+        auto t = expected[k];
+        ASSERT_EQ(resampled.time()[k], t);
+        for (std::size_t c = 0; c < samples.columns().size(); ++c) {
+            EXPECT_NEAR(resampled.column(c)[k], linear(samples, c, t), 1e-9);
+        }
+    }
+}
+
+TEST(ResampleTest, VwapMatchesBruteForce)
+{
+    auto samples = series(2000, 3);
+    auto resampled = resample(samples, 60s, interpolation_t::vwap);
+    auto expected = grid(samples, 60);
+    ASSERT_EQ(resampled.size(), expected.size());
+    // a step without samples carries the previous value over: the first
+    // grid time has at least the first sample, at or before it
+    double previous = 0;
+    std::size_t empty = 0;
+    for (std::size_t k = 0; k < expected.size(); ++k) {
+        auto t = expected[k];
+        ASSERT_EQ(resampled.time()[k], t);
+        auto price = vwap(samples, 0, t, 60, previous);
+        empty += price == previous;
+        EXPECT_NEAR(resampled.column("price_usd")[k], price, 1e-9);
+        previous = price;
+        // the volume is resampled taking the last value
+        EXPECT_EQ(resampled.column("day_volume_usd")[k], last(samples, 1, t));
+    }
+    EXPECT_GT(empty, 0u);
+}
+
+TEST(ResampleTest, EmptySeries)
+{
+    TimeSeries samples({"price_usd", "day_volume_usd"});
+    for (auto method : {interpolation_t::last, interpolation_t::linear,
+                        interpolation_t::vwap}) {
+        auto resampled = resample(samples, 60s, method);
+        EXPECT_TRUE(resampled.empty());
+        EXPECT_EQ(resampled.columns(), samples.columns());
+    }
+}
+
+TEST(ResampleTest, SingleSample)
+{
+    TimeSeries on_grid({"price_usd", "day_volume_usd"});
+    on_grid.append(1500000000 / 60 * 60, {42, 0});
+    TimeSeries off_grid({"price_usd", "day_volume_usd"});
+    off_grid.append(1500000000 / 60 * 60 + 1, {42, 0});
+    for (auto method : {interpolation_t::last, interpolation_t::linear,
+                        interpolation_t::vwap}) {
+        auto resampled = resample(on_grid, 60s, method);
+        ASSERT_EQ(resampled.size(), 1u);
+        EXPECT_EQ(resampled.time()[0], on_grid.time()[0]);
+        EXPECT_EQ(resampled.column("price_usd")[0], 42);
+        // no grid time within the samples
+        EXPECT_TRUE(resample(off_grid, 60s, method).empty());
+    }
+}
+
+TEST(ResampleTest, FirstSampleNotOnTheGrid)
+{
+    TimeSeries samples({"price_usd"});
+    samples.append(90, {1});
+    samples.append(150, {3});
+    samples.append(200, {5});
+    auto resampled = resample(samples, 60s, interpolation_t::linear);
+    ASSERT_EQ(resampled.size(), 2u);
+    EXPECT_EQ(resampled.time()[0], 120);
+    EXPECT_EQ(resampled.time()[1], 180);
+    EXPECT_DOUBLE_EQ(resampled.column(0)[0], 2);
+    EXPECT_DOUBLE_EQ(resampled.column(0)[1], 4.2);
+}
+
+TEST(ResampleTest, DuplicateTimestamps)
+{
+    TimeSeries samples({"price_usd", "day_volume_usd"});
+    samples.append(60, {1, 1});
+    samples.append(60, {2, 3});
+    samples.append(120, {4, 1});
+    samples.append(120, {6, 1});
+    // the last sample of a timestamp wins
+    auto last = resample(samples, 60s, interpolation_t::last);
+    ASSERT_EQ(last.size(), 2u);
+    EXPECT_EQ(last.column(0)[0], 2);
+    EXPECT_EQ(last.column(0)[1], 6);
+    // and the line starts from it
+    auto linear = resample(samples, 30s, interpolation_t::linear);
+    ASSERT_EQ(linear.size(), 3u);
+    EXPECT_DOUBLE_EQ(linear.column(0)[1], 3);
+    // every sample of the step is weighted
+    auto vwap = resample(samples, 60s, interpolation_t::vwap);
+    ASSERT_EQ(vwap.size(), 2u);
+    EXPECT_DOUBLE_EQ(vwap.column(0)[0], (1 * 1 + 2 * 3) / 4.);
+    EXPECT_DOUBLE_EQ(vwap.column(0)[1], 5);
+}
+
+TEST(ResampleTest, InvalidArguments)
+{
+    auto samples = series(10, 4);
+    EXPECT_THROW(resample(samples, 0s, interpolation_t::last),
+                 std::invalid_argument);
+    EXPECT_THROW(resample(samples, 60s, interpolation_t::vwap, "volume"),
+                 std::out_of_range);
+    // the volume column is needed only by vwap
+    EXPECT_NO_THROW(resample(samples, 60s, interpolation_t::last, "volume"));
+}
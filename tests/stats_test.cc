@@ -0,0 +1,353 @@
+/* Copyright 2017 Paolo Galeone <nessuno@nerdz.eu>. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.*/
+
+#include <gtest/gtest.h>
+#include <atd/stats/RollingCovariance.hpp>
+#include <atd/stats/RollingMoments.hpp>
+#include <atd/stats/RollingRegression.hpp>
+#include <atd/stats/Welford.hpp>
+#include <atd/stats/namespace.hpp>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace atd::stats;
+
+namespace {
+
+template <typename T>
+std::vector<T> series(std::size_t n, double mean, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> step(0, 1);
+    std::vector<T> ret(n);
+    for (auto& x : ret) {
+        x = static_cast<T>(mean + step(rng));
+    }
+    return ret;
+}
+
+// two pass definitions, in long double
+template <typename T>
+std::pair<long double, long double> reference_mean_stdev(
+    const std::vector<T>& x)
+{
+    long double mean = 0, variance = 0;
+    for (auto v : x) {
+        mean += v;
+    }
+    mean /= x.size();
+    for (auto v : x) {
+        variance += (v - mean) * (v - mean);
+    }
+    return std::pair(mean, std::sqrt(variance / x.size()));
+}
+
+template <typename T>
+long double reference_pearson(const std::vector<T>& x,
+                              const std::vector<T>& y)
+{
+    auto [x_mean, x_stdev] = reference_mean_stdev(x);
+    auto [y_mean, y_stdev] = reference_mean_stdev(y);
+    long double covariance = 0;
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        covariance += (x[i] - x_mean) * (y[i] - y_mean);
+    }
+    return covariance / x.size() / (x_stdev * y_stdev);
+}
+
+template <typename T>
+std::vector<long double> reference_conv(const std::vector<T>& signal,
+                                        const std::vector<T>& kernel)
+{
+    std::vector<long double> out(signal.size() - kernel.size() + 1);
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        for (std::size_t j = 0; j < kernel.size(); ++j) {
+            out[i] += static_cast<long double>(kernel[kernel.size() - 1 - j]) *
+                      signal[i + j];
+        }
+    }
+    return out;
+}
+
+// two pass moments of the pairs (x, y) in [first, last): means, population
+// variances and covariance
+typedef struct {
+    long double x_mean, y_mean, x_variance, y_variance, covariance;
+} reference_moments_t;
+
+template <typename T>
+reference_moments_t reference_moments(const std::vector<T>& x,
+                                      const std::vector<T>& y,
+                                      std::size_t first, std::size_t last)
+{
+    reference_moments_t ret = {};
+    long double n = last - first;
+    for (auto i = first; i < last; ++i) {
+        ret.x_mean += x[i];
+        ret.y_mean += y[i];
+    }
+    ret.x_mean /= n;
+    ret.y_mean /= n;
+    for (auto i = first; i < last; ++i) {
+        ret.x_variance += (x[i] - ret.x_mean) * (x[i] - ret.x_mean);
+        ret.y_variance += (y[i] - ret.y_mean) * (y[i] - ret.y_mean);
+        ret.covariance += (x[i] - ret.x_mean) * (y[i] - ret.y_mean);
+    }
+    ret.x_variance /= n;
+    ret.y_variance /= n;
+    ret.covariance /= n;
+    return ret;
+}
+
+}  // namespace
+
+template <typename T>
+class StatsTest : public ::testing::Test {
+};
+
+// float and double run on the kernels, long double on the generic code
+typedef ::testing::Types<float, double, long double> FloatingTypes;
+TYPED_TEST_SUITE(StatsTest, FloatingTypes);
+
+TYPED_TEST(StatsTest, MeanStdevLargeMean)
+{
+    double epsilon = std::is_same_v<TypeParam, float> ? 1e-3 : 1e-9;
+    for (auto mean : {0., 1e4, 1e6}) {
+        auto x = series<TypeParam>(10001, mean, 1);
+        auto [expected_mean, expected_stdev] = reference_mean_stdev(x);
+        auto [actual_mean, actual_stdev] = mean_stdev(x);
+        EXPECT_NEAR(actual_mean, expected_mean, epsilon * (1 + mean));
+        // the stddev is ~1: it must not be lost in the mean
+        EXPECT_NEAR(actual_stdev, expected_stdev, epsilon * 10);
+    }
+}
+
+TYPED_TEST(StatsTest, PearsonKnownValues)
+{
+    std::vector<TypeParam> x = {1, 2, 3}, y = {1, 3, 2};
+    EXPECT_NEAR(pearson(x, y), 0.5, 1e-6);
+    EXPECT_NEAR(pearson(y, x), 0.5, 1e-6);
+
+    std::vector<TypeParam> up = {1, 2, 3, 4, 5}, line = {3, 5, 7, 9, 11},
+                           down = {10, 8, 6, 4, 2};
+    EXPECT_NEAR(pearson(up, line), 1, 1e-6);
+    EXPECT_NEAR(pearson(up, down), -1, 1e-6);
+}
+
+// pearson summed X*X instead of X*Y in the product: x against any y with the
+// same sums and spread was perfectly correlated
+TYPED_TEST(StatsTest, PearsonUsesTheProductOfXAndY)
+{
+    std::vector<TypeParam> x = {1, 2, 3, 4}, y = {4, 3, 2, 1};
+    EXPECT_NEAR(pearson(x, y), -1, 1e-6);
+    y = {2, 4, 1, 3};
+    EXPECT_NEAR(pearson(x, y), 0, 1e-6);
+}
+
+TYPED_TEST(StatsTest, PearsonMatchesDefinition)
+{
+    double epsilon = std::is_same_v<TypeParam, float> ? 1e-3 : 1e-9;
+    auto x = series<TypeParam>(5000, 1e4, 2);
+    auto y = x;
+    auto noise = series<TypeParam>(5000, 0, 3);
+    for (std::size_t i = 0; i < y.size(); ++i) {
+        y[i] = 2 * (x[i] - 1e4) + noise[i] + 50;
+    }
+    EXPECT_NEAR(pearson(x, y), reference_pearson(x, y), epsilon);
+}
+
+TYPED_TEST(StatsTest, LeastSquaresLine)
+{
+    std::vector<TypeParam> x, y;
+    for (int i = 0; i < 100; ++i) {
+        x.push_back(1000 + i);
+        y.push_back(3 * (1000 + i) + 2);
+    }
+    // float can't tell 3002 from 3002.0002
+    double epsilon = std::is_same_v<TypeParam, float> ? 1 : 1e-6;
+    auto [slope, intercept] = least_squares(x, y);
+    EXPECT_NEAR(slope, 3, 1e-4);
+    EXPECT_NEAR(intercept, 2, epsilon);
+}
+
+TYPED_TEST(StatsTest, ConvMatchesDefinition)
+{
+    double epsilon = std::is_same_v<TypeParam, float> ? 1e-2 : 1e-9;
+    auto signal = series<TypeParam>(1000, 100, 4);
+    for (std::size_t length : {1, 5, 71}) {
+        auto kernel = series<TypeParam>(length, 0, 5);
+        auto expected = reference_conv(signal, kernel);
+        auto actual = conv(signal, kernel);
+        // conv is symmetric in its arguments
+        auto swapped = conv(kernel, signal);
+        ASSERT_EQ(actual.size(), expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            EXPECT_NEAR(actual[i], expected[i], epsilon);
+            EXPECT_EQ(actual[i], swapped[i]);
+        }
+    }
+}
+
+TEST(StatsTest, ConvIntegers)
+{
+    std::vector<int> signal = {1, 2, 3, 4}, kernel = {1, 0, -1};
+    auto out = conv(signal, kernel);
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[0], 2);
+    EXPECT_EQ(out[1], 2);
+}
+
+// Rolling statistics, over many windows: the downdates and the rebuilds of
+// every window
+
+TEST(RollingTest, MomentsMatchTwoPass)
+{
+    std::size_t window = 64;
+    // a large mean: the rounding of the downdates would accumulate
+    auto x = series<double>(100 * window + 5, 1e6, 6);
+    RollingMoments<double> moments(window);
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        moments.push(x[i]);
+        auto first = i + 1 > window ? i + 1 - window : 0;
+        auto expected = reference_moments(x, x, first, i + 1);
+        ASSERT_EQ(moments.count(), i + 1 - first);
+        EXPECT_NEAR(moments.mean(), expected.x_mean, 1e-8);
+        EXPECT_NEAR(moments.variance(), expected.x_variance, 1e-6);
+    }
+    EXPECT_TRUE(moments.full());
+}
+
+TEST(RollingTest, CovarianceMatchesTwoPass)
+{
+    std::size_t window = 64;
+    auto x = series<double>(100 * window + 5, 1e6, 7);
+    auto y = series<double>(x.size(), -3e5, 8);
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        y[i] += 0.5 * (x[i] - 1e6);
+    }
+    RollingCovariance<double> covariance(window);
+    RollingRegression<double> regression(window);
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        covariance.push(x[i], y[i]);
+        regression.push(x[i], y[i]);
+        if (i == 0) {
+            continue;
+        }
+        auto first = i + 1 > window ? i + 1 - window : 0;
+        auto expected = reference_moments(x, y, first, i + 1);
+        EXPECT_NEAR(covariance.x_mean(), expected.x_mean, 1e-8);
+        EXPECT_NEAR(covariance.y_mean(), expected.y_mean, 1e-8);
+        EXPECT_NEAR(covariance.x_variance(), expected.x_variance, 1e-6);
+        EXPECT_NEAR(covariance.y_variance(), expected.y_variance, 1e-6);
+        EXPECT_NEAR(covariance.covariance(), expected.covariance, 1e-6);
+        auto pearson = expected.covariance /
+                       std::sqrt(expected.x_variance * expected.y_variance);
+        EXPECT_NEAR(covariance.pearson(), pearson, 1e-9);
+        auto slope = expected.covariance / expected.x_variance;
+        EXPECT_NEAR(regression.slope(), slope, 1e-8);
+        EXPECT_NEAR(regression.intercept(),
+                    expected.y_mean - slope * expected.x_mean, 1e-2);
+        EXPECT_NEAR(regression.r(), pearson, 1e-9);
+    }
+}
+
+TEST(RollingTest, RegressionMatchesLeastSquares)
+{
+    std::size_t window = 30;
+    auto x = series<double>(10 * window, 0, 9);
+    auto y = series<double>(x.size(), 0, 10);
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        y[i] += 3 * x[i] + 2;
+    }
+    RollingRegression<double> regression(window);
+    for (auto i = 0u; i < x.size(); ++i) {
+        regression.push(x[i], y[i]);
+    }
+    std::vector<double> x_window(x.end() - window, x.end());
+    std::vector<double> y_window(y.end() - window, y.end());
+    auto [slope, intercept] = least_squares(x_window, y_window);
+    EXPECT_NEAR(regression.line().first, slope, 1e-9);
+    EXPECT_NEAR(regression.line().second, intercept, 1e-9);
+}
+
+TEST(RollingTest, ConstantInput)
+{
+    std::size_t window = 16;
+    auto y = series<double>(20 * window, 0, 11);
+    RollingMoments<double> moments(window);
+    RollingCovariance<double> covariance(window);
+    RollingRegression<double> regression(window);
+    for (auto v : y) {
+        moments.push(0.1);
+        covariance.push(0.1, v);
+        regression.push(0.1, v);
+    }
+    EXPECT_EQ(moments.mean(), 0.1);
+    EXPECT_EQ(moments.variance(), 0);
+    EXPECT_EQ(covariance.x_variance(), 0);
+    EXPECT_TRUE(std::isnan(covariance.pearson()));
+    EXPECT_TRUE(std::isnan(regression.slope()));
+    EXPECT_TRUE(std::isnan(regression.r()));
+}
+
+TEST(RollingTest, PopEmptiesTheWindow)
+{
+    RollingCovariance<double> covariance(8);
+    RollingMoments<double> moments(8);
+    for (int i = 0; i < 5; ++i) {
+        covariance.push(i, 2 * i);
+        moments.push(i);
+    }
+    for (int i = 0; i < 6; ++i) {
+        covariance.pop();
+        moments.pop();
+    }
+    EXPECT_EQ(covariance.count(), 0u);
+    EXPECT_EQ(covariance.covariance(), 0);
+    EXPECT_EQ(moments.count(), 0u);
+    EXPECT_EQ(moments.mean(), 0);
+    EXPECT_EQ(moments.variance(), 0);
+}
+
+TEST(WelfordTest, MergeMatchesSingleStream)
+{
+    auto x = series<double>(1000, 1e6, 12);
+    Welford<double> stream;
+    for (auto v : x) {
+        stream.push(v);
+    }
+    // chunks of different sizes, an empty one included
+    Welford<double> merged;
+    std::size_t first = 0;
+    for (std::size_t size : {0, 1, 7, 100, 392, 500}) {
+        Welford<double> chunk;
+        for (auto i = first; i < first + size; ++i) {
+            chunk.push(x[i]);
+        }
+        merged.merge(chunk);
+        first += size;
+    }
+    ASSERT_EQ(first, x.size());
+    auto expected = reference_moments(x, x, 0, x.size());
+    EXPECT_EQ(merged.count(), stream.count());
+    EXPECT_NEAR(merged.mean(), stream.mean(), 1e-8);
+    EXPECT_NEAR(merged.variance(), stream.variance(), 1e-8);
+    EXPECT_NEAR(merged.variance(), expected.x_variance, 1e-8);
+    EXPECT_NEAR(merged.sample_variance(),
+                expected.x_variance * x.size() / (x.size() - 1), 1e-8);
+    merged.reset();
+    EXPECT_EQ(merged.count(), 0u);
+    EXPECT_EQ(merged.variance(), 0);
+}